@@ -0,0 +1,23 @@
+#!/bin/sh
+# Allocation check: write the benchmark recording, replay it without a
+# window (frames are still drawn, to an offscreen terminal) and fail if
+# any steady-state frame touched the heap.
+#
+# Usage: ./alloc_check.sh [game binary, default ./BoneBound]
+
+game=${1:-./BoneBound}
+bench=${TMPDIR:-/tmp}/bonebound_alloc_check_$$.rec
+trap 'rm -f "$bench"' EXIT
+
+if ! "$game" --write-bench "$bench"; then
+    echo "alloc_check: can't write the benchmark recording" >&2
+    exit 1
+fi
+
+"$game" --replay "$bench" --headless --alloc-check
+status=$?
+if [ $status -ne 0 ]; then
+    echo "alloc_check: FAILED (exit code $status)" >&2
+    exit $status
+fi
+echo "alloc_check: passed"
@@ -0,0 +1,32 @@
+#include "project.h"
+
+// Allocate a cleared bit grid (false if over the memory budget)
+bool bitgrid_init(BitGrid* grid, int width, int height, MemTag tag)
+{
+    grid->width = width;
+    grid->height = height;
+    grid->stride = (width + 63) / 64;
+    grid->words = (uint64_t*)mem_calloc(tag, (size_t)grid->stride * height, sizeof(uint64_t));
+    if (grid->words == NULL) {
+        grid->width = grid->height = grid->stride = 0;
+        return false;
+    }
+    return true;
+}
+
+// Release a bit grid
+void bitgrid_free(BitGrid* grid)
+{
+    mem_free(grid->words);
+    grid->words = NULL;
+    grid->width = 0;
+    grid->height = 0;
+    grid->stride = 0;
+}
+
+// Clear every bit
+void bitgrid_clear(BitGrid* grid)
+{
+    if (grid->words == NULL) return;
+    memset(grid->words, 0, (size_t)grid->stride * grid->height * sizeof(uint64_t));
+}
@@ -0,0 +1,144 @@
+#include "project.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <nmmintrin.h>
+#define CRC32C_HAVE_SSE42 1
+#endif
+
+// Castagnoli polynomial, reflected
+#define CRC32C_POLY 0x82F63B78u
+
+// Slicing-by-8 tables for the portable path
+typedef struct {
+    uint32_t table[8][256];
+} Crc32cTables;
+
+static Crc32cTables crc32c_build_tables()
+{
+    Crc32cTables t;
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for (int k = 0; k < 8; k++)
+        {
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0u - (crc & 1)));
+        }
+        t.table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        for (int s = 1; s < 8; s++)
+        {
+            uint32_t prev = t.table[s - 1][i];
+            t.table[s][i] = (prev >> 8) ^ t.table[0][prev & 0xFF];
+        }
+    }
+    return t;
+}
+
+// Table-driven CRC32C, eight bytes per step
+static uint32_t crc32c_sw(uint32_t crc, const uint8_t* p, size_t length)
+{
+    static const Crc32cTables tables = crc32c_build_tables();
+    const uint32_t (*t)[256] = tables.table;
+    
+    while (length && ((uintptr_t)p & 7))
+    {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+        length--;
+    }
+    
+    while (length >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        uint32_t lo = (uint32_t)word ^ crc;
+        uint32_t hi = (uint32_t)(word >> 32);
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        p += 8;
+        length -= 8;
+    }
+    
+    while (length--)
+    {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+    }
+    return crc;
+}
+
+#ifdef CRC32C_HAVE_SSE42
+// SSE4.2 crc32 instruction, 32 bytes per loop
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t* p, size_t length)
+{
+    while (length && ((uintptr_t)p & 7))
+    {
+        crc = _mm_crc32_u8(crc, *p++);
+        length--;
+    }
+    
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+    while (length >= 32)
+    {
+        uint64_t a, b, c, d;
+        memcpy(&a, p, 8);
+        memcpy(&b, p + 8, 8);
+        memcpy(&c, p + 16, 8);
+        memcpy(&d, p + 24, 8);
+        crc64 = _mm_crc32_u64(crc64, a);
+        crc64 = _mm_crc32_u64(crc64, b);
+        crc64 = _mm_crc32_u64(crc64, c);
+        crc64 = _mm_crc32_u64(crc64, d);
+        p += 32;
+        length -= 32;
+    }
+    while (length >= 8)
+    {
+        uint64_t a;
+        memcpy(&a, p, 8);
+        crc64 = _mm_crc32_u64(crc64, a);
+        p += 8;
+        length -= 8;
+    }
+    crc = (uint32_t)crc64;
+#endif
+    
+    while (length >= 4)
+    {
+        uint32_t a;
+        memcpy(&a, p, 4);
+        crc = _mm_crc32_u32(crc, a);
+        p += 4;
+        length -= 4;
+    }
+    while (length--)
+    {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+// True when the hardware path is in use
+bool crc32c_hardware()
+{
+#ifdef CRC32C_HAVE_SSE42
+    static const bool supported = __builtin_cpu_supports("sse4.2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+// Continue a CRC32C over more bytes (start with crc = 0)
+uint32_t crc32c_update(uint32_t crc, const void* data, size_t length)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    crc = ~crc;
+#ifdef CRC32C_HAVE_SSE42
+    if (crc32c_hardware()) return ~crc32c_hw(crc, p, length);
+#endif
+    return ~crc32c_sw(crc, p, length);
+}
@@ -0,0 +1,510 @@
+#include "project.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FIELD_HAVE_SSE2 1
+#endif
+
+// Distance fields. For every tile and every terrain feature a map stores
+// the nearest tile of that feature, packed as (y << 16) | x, so "where is
+// the nearest water" and "is there forest within R" are one load and an
+// abs. Distances are 4-connected (Manhattan), like paths. Fields are built
+// by a two-pass raster sweep whose row-to-row step runs four tiles at a
+// time, and edits repair only the tiles whose nearest tile changed.
+
+#define FIELD_NONE 0xFFFFFFFFu
+#define FIELD_FAR (1 << 24)         // Distance while building, no tile of the feature yet
+
+// Fields of the world map
+FeatureFields worldFields;
+
+// Breadth-first scratch for edits (main thread only)
+typedef struct {
+    int* queue;
+    uint32_t* stamp;
+    uint32_t mark;
+    int capacity;
+} FieldScratch;
+
+static FieldScratch fieldScratch;
+
+// Tile a feature is made of
+static const char featureTiles[NUM_FEATURES] = { '~', 'T', '^', '>' };
+
+// Feature of every tile character, NUM_FEATURES for none
+typedef struct {
+    uint8_t feature[256];
+} FeatureTable;
+
+static FeatureTable feature_build_table()
+{
+    FeatureTable t;
+    memset(t.feature, NUM_FEATURES, sizeof(t.feature));
+    for (int f = 0; f < NUM_FEATURES; f++) t.feature[(uint8_t)featureTiles[f]] = (uint8_t)f;
+    return t;
+}
+
+static const FeatureTable featureTable = feature_build_table();
+
+// Feature a tile belongs to, NUM_FEATURES for none
+static inline Feature tile_feature(char tile)
+{
+    return (Feature)featureTable.feature[(uint8_t)tile];
+}
+
+static inline uint32_t field_pack(int x, int y)
+{
+    return ((uint32_t)y << 16) | (uint32_t)x;
+}
+
+// Manhattan distance from (x, y) to a packed tile; FIELD_NONE is further
+// than any real one
+static inline int field_distance(uint32_t site, int x, int y)
+{
+    return abs((int)(site & 0xFFFF) - x) + abs((int)(site >> 16) - y);
+}
+
+// Take the nearest tile of the row above (or below) wherever it is closer
+static void field_step_rows(uint32_t* row, const uint32_t* from, int x0, int x1, int y)
+{
+    int x = x0;
+#ifdef FIELD_HAVE_SSE2
+    const __m128i low = _mm_set1_epi32(0xFFFF);
+    const __m128i vy = _mm_set1_epi32(y);
+    __m128i vx = _mm_setr_epi32(x0, x0 + 1, x0 + 2, x0 + 3);
+    for (; x + 4 <= x1; x += 4)
+    {
+        __m128i mine = _mm_loadu_si128((const __m128i*)(row + x));
+        __m128i theirs = _mm_loadu_si128((const __m128i*)(from + x));
+        
+        // |dx| + |dy| for both candidates, four tiles at once
+        __m128i d[2];
+        __m128i sites[2] = { mine, theirs };
+        for (int i = 0; i < 2; i++)
+        {
+            __m128i dx = _mm_sub_epi32(_mm_and_si128(sites[i], low), vx);
+            __m128i dy = _mm_sub_epi32(_mm_srli_epi32(sites[i], 16), vy);
+            __m128i sx = _mm_srai_epi32(dx, 31);
+            __m128i sy = _mm_srai_epi32(dy, 31);
+            d[i] = _mm_add_epi32(_mm_sub_epi32(_mm_xor_si128(dx, sx), sx),
+                                 _mm_sub_epi32(_mm_xor_si128(dy, sy), sy));
+        }
+        
+        __m128i take = _mm_cmplt_epi32(d[1], d[0]);
+        _mm_storeu_si128((__m128i*)(row + x),
+                         _mm_or_si128(_mm_and_si128(take, theirs), _mm_andnot_si128(take, mine)));
+        vx = _mm_add_epi32(vx, _mm_set1_epi32(4));
+    }
+#endif
+    for (; x < x1; x++)
+    {
+        if (field_distance(from[x], x, y) < field_distance(row[x], x, y)) row[x] = from[x];
+    }
+}
+
+// Distances of a row's nearest tiles, four at a time
+static void field_row_distances(const uint32_t* row, int* dist, int width, int y)
+{
+    int x = 0;
+#ifdef FIELD_HAVE_SSE2
+    const __m128i low = _mm_set1_epi32(0xFFFF);
+    const __m128i vy = _mm_set1_epi32(y);
+    __m128i vx = _mm_setr_epi32(0, 1, 2, 3);
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i sites = _mm_loadu_si128((const __m128i*)(row + x));
+        __m128i dx = _mm_sub_epi32(_mm_and_si128(sites, low), vx);
+        __m128i dy = _mm_sub_epi32(_mm_srli_epi32(sites, 16), vy);
+        __m128i sx = _mm_srai_epi32(dx, 31);
+        __m128i sy = _mm_srai_epi32(dy, 31);
+        _mm_storeu_si128((__m128i*)(dist + x), 
+                         _mm_add_epi32(_mm_sub_epi32(_mm_xor_si128(dx, sx), sx),
+                                       _mm_sub_epi32(_mm_xor_si128(dy, sy), sy)));
+        vx = _mm_add_epi32(vx, _mm_set1_epi32(4));
+    }
+#endif
+    for (; x < width; x++) dist[x] = field_distance(row[x], x, y);
+}
+
+// Take the neighbouring row's nearest tiles wherever they are closer, given
+// both rows' distances; four at a time
+static void field_merge_row(uint32_t* row, int* dist, const uint32_t* from, const int* fromDist, int width)
+{
+    int x = 0;
+#ifdef FIELD_HAVE_SSE2
+    const __m128i one = _mm_set1_epi32(1);
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i mine = _mm_loadu_si128((const __m128i*)(dist + x));
+        __m128i theirs = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(fromDist + x)), one);
+        __m128i take = _mm_cmplt_epi32(theirs, mine);
+        __m128i sites = _mm_loadu_si128((const __m128i*)(row + x));
+        __m128i fromSites = _mm_loadu_si128((const __m128i*)(from + x));
+        _mm_storeu_si128((__m128i*)(row + x), 
+                         _mm_or_si128(_mm_and_si128(take, fromSites), _mm_andnot_si128(take, sites)));
+        _mm_storeu_si128((__m128i*)(dist + x), 
+                         _mm_or_si128(_mm_and_si128(take, theirs), _mm_andnot_si128(take, mine)));
+    }
+#endif
+    for (; x < width; x++)
+    {
+        if (fromDist[x] + 1 < dist[x]) {
+            row[x] = from[x];
+            dist[x] = fromDist[x] + 1;
+        }
+    }
+}
+
+// Carry nearest tiles along a row, left to right or right to left
+static void field_step_across(uint32_t* row, int x0, int x1, int y, bool forward)
+{
+    if (forward)
+    {
+        for (int x = x0 + 1; x < x1; x++)
+        {
+            if (field_distance(row[x - 1], x, y) < field_distance(row[x], x, y)) row[x] = row[x - 1];
+        }
+    }
+    else
+    {
+        for (int x = x1 - 2; x >= x0; x--)
+        {
+            if (field_distance(row[x + 1], x, y) < field_distance(row[x], x, y)) row[x] = row[x + 1];
+        }
+    }
+}
+
+// Two-pass sweep over a window: down and right, then up and left. Tiles
+// outside the window are left alone and tiles inside only ever get closer,
+// so it settles a region whose border already holds the right answers.
+static void field_sweep(uint32_t* nearest, int width, TileRect r)
+{
+    for (int y = r.y0; y < r.y1; y++)
+    {
+        uint32_t* row = nearest + (size_t)y * width;
+        if (y > r.y0) field_step_rows(row, row - width, r.x0, r.x1, y);
+        field_step_across(row, r.x0, r.x1, y, true);
+    }
+    for (int y = r.y1 - 1; y >= r.y0; y--)
+    {
+        uint32_t* row = nearest + (size_t)y * width;
+        if (y < r.y1 - 1) field_step_rows(row, row + width, r.x0, r.x1, y);
+        field_step_across(row, r.x0, r.x1, y, false);
+    }
+}
+
+// Nearest feature tile within one row, by a scan each way; branch-free,
+// since forests and lakes are mostly feature tiles
+template <typename TileAt>
+static void field_scan_row(uint32_t* row, int* dist, int width, int y, char tile, TileAt tileAt)
+{
+    int lastX = -FIELD_FAR;
+    for (int x = 0; x < width; x++)
+    {
+        lastX = tileAt(x) == tile ? x : lastX;
+        dist[x] = x - lastX;
+    }
+    
+    int nextX = 2 * FIELD_FAR;
+    for (int x = width - 1; x >= 0; x--)
+    {
+        nextX = dist[x] == 0 ? x : nextX;
+        int ahead = nextX - x;
+        int siteX = ahead < dist[x] ? nextX : x - dist[x];
+        dist[x] = ahead < dist[x] ? ahead : dist[x];
+        row[x] = dist[x] < FIELD_FAR ? field_pack(siteX, y) : FIELD_NONE;
+    }
+}
+
+// Build every feature's field of a map from its tiles. Arrays are kept
+// between builds of the same size (pooled maps reuse them); a feature the
+// map lacks gets none until an edit adds it.
+template <typename TileAt>
+static void feature_fields_build(FeatureFields* fields, int width, int height, TileAt tileAt)
+{
+    if (fields->width != width || fields->height != height)
+    {
+        feature_fields_free(fields);
+        fields->width = width;
+        fields->height = height;
+    }
+    
+    size_t tiles = (size_t)width * height;
+    int dist[2][SAVE_MAX_MAP_SIDE];
+    for (int f = 0; f < NUM_FEATURES; f++)
+    {
+        const char tile = featureTiles[f];
+        int count = 0;
+        for (size_t i = 0; i < tiles; i++) count += tileAt(i) == tile;
+        fields->count[f] = count;
+    }
+    
+    for (int f = 0; f < NUM_FEATURES; f++)
+    {
+        if (fields->count[f] == 0) continue;
+        if (fields->nearest[f] == NULL)
+        {
+            // Over budget: this feature answers "none" rather than lie
+            fields->nearest[f] = (uint32_t*)mem_alloc(MEM_FIELD, tiles * sizeof(uint32_t));
+            if (fields->nearest[f] == NULL) {
+                fields->count[f] = 0;
+                continue;
+            }
+        }
+        
+        uint32_t* nearest = fields->nearest[f];
+        if (width > SAVE_MAX_MAP_SIDE)
+        {
+            for (size_t i = 0; i < tiles; i++)
+            {
+                nearest[i] = tileAt(i) == featureTiles[f] ? field_pack((int)(i % width), (int)(i / width)) : FIELD_NONE;
+            }
+            field_sweep(nearest, width, (TileRect){ 0, 0, width, height });
+            continue;
+        }
+        
+        // Nearest in the same row by a scan each way, then down the columns
+        // and back up (Manhattan distance separates by axis). Row distances
+        // are carried along, so the downward pass never unpacks a tile.
+        int current = 0;
+        for (int y = 0; y < height; y++)
+        {
+            uint32_t* row = nearest + (size_t)y * width;
+            int* rowDist = dist[current];
+            field_scan_row(row, rowDist, width, y, featureTiles[f], [&](int x) { return tileAt((size_t)y * width + x); });
+            
+            if (y > 0) field_merge_row(row, rowDist, row - width, dist[current ^ 1], width);
+            current ^= 1;
+        }
+        for (int y = height - 2; y >= 0; y--)
+        {
+            uint32_t* row = nearest + (size_t)y * width;
+            field_row_distances(row, dist[current], width, y);
+            field_merge_row(row, dist[current], row + width, dist[current ^ 1], width);
+            current ^= 1;
+        }
+    }
+}
+
+// Rebuild a local map's distance fields from its tiles (any thread)
+void local_map_build_fields(LocalMap* local)
+{
+    const char* tiles = local->tiles[0];
+    feature_fields_build(&local->fields, local->width, local->height,
+                         [&](size_t i) { return tiles[i]; });
+    local->fields.stale = false;
+}
+
+// Rebuild the distance fields of the world's view
+void world_build_fields()
+{
+    const char* tiles = worldMap->tiles;
+    const TileRect* view = &worldMap->view;
+    feature_fields_build(&worldFields, view->x1 - view->x0, view->y1 - view->y0,
+                         [&](size_t i) { return tiles[i]; });
+}
+
+// Allocate every feature's array up front, so pooled maps can be built
+// (on workers) without allocating whatever terrain they turn out to have
+void feature_fields_reserve(FeatureFields* fields, int width, int height)
+{
+    if (fields->width != width || fields->height != height)
+    {
+        feature_fields_free(fields);
+        fields->width = width;
+        fields->height = height;
+    }
+    
+    for (int f = 0; f < NUM_FEATURES; f++)
+    {
+        if (fields->nearest[f] == NULL) {
+            fields->nearest[f] = (uint32_t*)mem_alloc(MEM_FIELD, (size_t)width * height * sizeof(uint32_t));
+        }
+    }
+}
+
+void feature_fields_free(FeatureFields* fields)
+{
+    for (int f = 0; f < NUM_FEATURES; f++) mem_free(fields->nearest[f]);
+    memset(fields, 0, sizeof(FeatureFields));
+}
+
+// Make sure edit repairs can handle a map of this many tiles
+void feature_reserve(int tiles)
+{
+    if (tiles <= fieldScratch.capacity) return;
+    
+    feature_shutdown();
+    fieldScratch.queue = (int*)mem_alloc(MEM_FIELD, (size_t)tiles * sizeof(int));
+    fieldScratch.stamp = (uint32_t*)mem_calloc(MEM_FIELD, (size_t)tiles, sizeof(uint32_t));
+    if (fieldScratch.queue == NULL || fieldScratch.stamp == NULL) {
+        // Edits fall back to whole-map sweeps
+        feature_shutdown();
+        return;
+    }
+    fieldScratch.capacity = tiles;
+}
+
+// Free the edit scratch
+void feature_shutdown()
+{
+    mem_free(fieldScratch.queue);
+    mem_free(fieldScratch.stamp);
+    memset(&fieldScratch, 0, sizeof(fieldScratch));
+}
+
+// A new feature tile: flood out from it over the tiles it is now nearest
+// to. Every such tile is reached through others that are, so nothing
+// beyond them is visited.
+static void field_add(FeatureFields* fields, uint32_t* nearest, int x, int y)
+{
+    int width = fields->width, height = fields->height;
+    uint32_t site = field_pack(x, y);
+    nearest[y * width + x] = site;
+    
+    if (fields->width * fields->height > fieldScratch.capacity) {
+        field_sweep(nearest, width, (TileRect){ 0, 0, width, height });
+        return;
+    }
+    
+    static const int dirX[4] = { 1, -1, 0, 0 };
+    static const int dirY[4] = { 0, 0, 1, -1 };
+    int* queue = fieldScratch.queue;
+    int head = 0, tail = 0;
+    queue[tail++] = y * width + x;
+    while (head < tail)
+    {
+        int node = queue[head++];
+        int ny = node / width, nx = node - ny * width;
+        for (int d = 0; d < 4; d++)
+        {
+            int qx = nx + dirX[d], qy = ny + dirY[d];
+            if (qx < 0 || qy < 0 || qx >= width || qy >= height) continue;
+            
+            int next = qy * width + qx;
+            if (field_distance(site, qx, qy) >= field_distance(nearest[next], qx, qy)) continue;
+            nearest[next] = site;
+            queue[tail++] = next;
+        }
+    }
+}
+
+// A feature tile went away: find the tiles that pointed at it (all reached
+// through tiles it is a nearest of), forget them, and re-sweep just the box
+// around them plus a one-tile border of correct answers
+static void field_remove(FeatureFields* fields, uint32_t* nearest, int x, int y)
+{
+    int width = fields->width, height = fields->height;
+    uint32_t site = field_pack(x, y);
+    
+    if (fields->width * fields->height > fieldScratch.capacity)
+    {
+        for (size_t i = 0; i < (size_t)width * height; i++)
+        {
+            if (nearest[i] == site) nearest[i] = FIELD_NONE;
+        }
+        field_sweep(nearest, width, (TileRect){ 0, 0, width, height });
+        return;
+    }
+    
+    // New mark; wrapping around clears the stamps once
+    if (++fieldScratch.mark == 0) {
+        memset(fieldScratch.stamp, 0, (size_t)fieldScratch.capacity * sizeof(uint32_t));
+        fieldScratch.mark = 1;
+    }
+    uint32_t mark = fieldScratch.mark;
+    
+    static const int dirX[4] = { 1, -1, 0, 0 };
+    static const int dirY[4] = { 0, 0, 1, -1 };
+    int* queue = fieldScratch.queue;
+    int head = 0, tail = 0;
+    queue[tail++] = y * width + x;
+    fieldScratch.stamp[y * width + x] = mark;
+    nearest[y * width + x] = FIELD_NONE;
+    TileRect box = { x, y, x + 1, y + 1 };
+    while (head < tail)
+    {
+        int node = queue[head++];
+        int ny = node / width, nx = node - ny * width;
+        for (int d = 0; d < 4; d++)
+        {
+            int qx = nx + dirX[d], qy = ny + dirY[d];
+            if (qx < 0 || qy < 0 || qx >= width || qy >= height) continue;
+            
+            int next = qy * width + qx;
+            if (fieldScratch.stamp[next] == mark) continue;
+            if (nearest[next] != site &&
+                field_distance(site, qx, qy) != field_distance(nearest[next], qx, qy)) continue;
+            
+            fieldScratch.stamp[next] = mark;
+            queue[tail++] = next;
+            if (nearest[next] != site) continue;
+            
+            nearest[next] = FIELD_NONE;
+            if (qx < box.x0) box.x0 = qx;
+            if (qy < box.y0) box.y0 = qy;
+            if (qx >= box.x1) box.x1 = qx + 1;
+            if (qy >= box.y1) box.y1 = qy + 1;
+        }
+    }
+    
+    TileRect window = {
+        box.x0 > 0 ? box.x0 - 1 : 0, box.y0 > 0 ? box.y0 - 1 : 0,
+        box.x1 < width ? box.x1 + 1 : width, box.y1 < height ? box.y1 + 1 : height
+    };
+    field_sweep(nearest, width, window);
+}
+
+// Keep the fields in step with one tile edit (main thread)
+void feature_fields_edit(FeatureFields* fields, int x, int y, char oldTile, char newTile)
+{
+    if (fields->width == 0) return;
+    
+    Feature gone = tile_feature(oldTile);
+    if (gone != NUM_FEATURES && fields->count[gone] > 0)
+    {
+        fields->count[gone]--;
+        field_remove(fields, fields->nearest[gone], x, y);
+    }
+    
+    Feature added = tile_feature(newTile);
+    if (added == NUM_FEATURES) return;
+    
+    size_t tiles = (size_t)fields->width * fields->height;
+    if (fields->nearest[added] == NULL)
+    {
+        fields->nearest[added] = (uint32_t*)mem_alloc(MEM_FIELD, tiles * sizeof(uint32_t));
+        if (fields->nearest[added] == NULL) return;
+    }
+    
+    // First of its kind: whatever the array held is stale
+    if (fields->count[added]++ == 0) memset(fields->nearest[added], 0xFF, tiles * sizeof(uint32_t));
+    field_add(fields, fields->nearest[added], x, y);
+}
+
+// Nearest tile of a feature to (x, y); false if the map has none
+bool feature_nearest(const FeatureFields* fields, Feature feature, int x, int y, int* outX, int* outY)
+{
+    if (x < 0 || y < 0 || x >= fields->width || y >= fields->height) return false;
+    if (fields->count[feature] == 0) return false;
+    
+    uint32_t site = fields->nearest[feature][(size_t)y * fields->width + x];
+    *outX = (int)(site & 0xFFFF);
+    *outY = (int)(site >> 16);
+    return true;
+}
+
+// Steps from (x, y) to the nearest tile of a feature, -1 if the map has none
+int feature_distance(const FeatureFields* fields, Feature feature, int x, int y)
+{
+    int fx, fy;
+    if (!feature_nearest(fields, feature, x, y, &fx, &fy)) return -1;
+    return abs(fx - x) + abs(fy - y);
+}
+
+// Is a tile of a feature at most radius steps from (x, y)?
+bool feature_within(const FeatureFields* fields, Feature feature, int x, int y, int radius)
+{
+    int distance = feature_distance(fields, feature, x, y);
+    return distance >= 0 && distance <= radius;
+}
@@ -0,0 +1,303 @@
+#include "project.h"
+
+// Creature templates per world tile type
+typedef struct {
+    char glyph;
+    int16_t hp;
+} CreatureKind;
+
+static const CreatureKind creatureKinds[] = {
+    {'s', 12},  // Skeleton
+    {'r', 4},   // Rat
+    {'b', 3},   // Bat
+    {'g', 20},  // Ghoul
+};
+
+// Cheap per-store random numbers (xorshift)
+static uint32_t entity_rand(EntityStore* store)
+{
+    uint32_t v = store->rng;
+    v ^= v << 13;
+    v ^= v >> 17;
+    v ^= v << 5;
+    store->rng = v;
+    return v;
+}
+
+// Move one component array into a bigger block
+static void* entity_grow(void* old, int count, int capacity, size_t size)
+{
+    void* grown = mem_alloc(MEM_ENTITY, capacity * size);
+    if (grown && old) memcpy(grown, old, count * size);
+    return grown;
+}
+
+// Grow component arrays together so indices stay aligned
+// Leaves the store untouched if the memory budget refuses
+bool entity_store_reserve(EntityStore* store, int capacity)
+{
+    if (capacity <= store->capacity) return true;
+    
+    int count = store->count;
+    int16_t* x = (int16_t*)entity_grow(store->x, count, capacity, sizeof(int16_t));
+    int16_t* y = (int16_t*)entity_grow(store->y, count, capacity, sizeof(int16_t));
+    char* glyph = (char*)entity_grow(store->glyph, count, capacity, sizeof(char));
+    uint8_t* aiState = (uint8_t*)entity_grow(store->aiState, count, capacity, sizeof(uint8_t));
+    int16_t* hp = (int16_t*)entity_grow(store->hp, count, capacity, sizeof(int16_t));
+    uint8_t* timer = (uint8_t*)entity_grow(store->timer, count, capacity, sizeof(uint8_t));
+    
+    if (!x || !y || !glyph || !aiState || !hp || !timer)
+    {
+        mem_free(x);
+        mem_free(y);
+        mem_free(glyph);
+        mem_free(aiState);
+        mem_free(hp);
+        mem_free(timer);
+        return false;
+    }
+    
+    mem_free(store->x);
+    mem_free(store->y);
+    mem_free(store->glyph);
+    mem_free(store->aiState);
+    mem_free(store->hp);
+    mem_free(store->timer);
+    
+    store->x = x;
+    store->y = y;
+    store->glyph = glyph;
+    store->aiState = aiState;
+    store->hp = hp;
+    store->timer = timer;
+    store->capacity = capacity;
+    return true;
+}
+
+// Empty store with no arrays yet
+void entity_store_init(EntityStore* store, uint32_t seed)
+{
+    memset(store, 0, sizeof(EntityStore));
+    store->rng = seed ? seed : 0x9E3779B9u;
+}
+
+// Empty a store for reuse, keeping its arrays
+void entity_store_reset(EntityStore* store, uint32_t seed)
+{
+    store->count = 0;
+    store->rng = seed ? seed : 0x9E3779B9u;
+}
+
+// Release all component arrays
+void entity_store_free(EntityStore* store)
+{
+    mem_free(store->x);
+    mem_free(store->y);
+    mem_free(store->glyph);
+    mem_free(store->aiState);
+    mem_free(store->hp);
+    mem_free(store->timer);
+    memset(store, 0, sizeof(EntityStore));
+}
+
+// Add a creature, returns its dense index
+int entity_spawn(EntityStore* store, int x, int y, char glyph, int hp)
+{
+    if (store->count >= MAX_ENTITIES_PER_MAP) return -1;
+    if (store->count == store->capacity &&
+        !entity_store_reserve(store, store->capacity ? store->capacity * 2 : 64)) return -1;
+    
+    int i = store->count++;
+    store->x[i] = (int16_t)x;
+    store->y[i] = (int16_t)y;
+    store->glyph[i] = glyph;
+    store->aiState[i] = AI_IDLE;
+    store->hp[i] = (int16_t)hp;
+    store->timer[i] = (uint8_t)(entity_rand(store) % ENTITY_THINK_INTERVAL);
+    return i;
+}
+
+// Remove a creature by moving the last one into its slot
+void entity_remove(EntityStore* store, int i)
+{
+    int last = --store->count;
+    store->x[i] = store->x[last];
+    store->y[i] = store->y[last];
+    store->glyph[i] = store->glyph[last];
+    store->aiState[i] = store->aiState[last];
+    store->hp[i] = store->hp[last];
+    store->timer[i] = store->timer[last];
+}
+
+// Write creatures as count followed by each component array
+void entity_store_write(const EntityStore* store, SaveBuffer* buf)
+{
+    int32_t count = store->count;
+    savebuf_put(buf, &count, sizeof(count));
+    savebuf_put(buf, &store->rng, sizeof(uint32_t));
+    savebuf_put(buf, store->x, count * sizeof(int16_t));
+    savebuf_put(buf, store->y, count * sizeof(int16_t));
+    savebuf_put(buf, store->glyph, count * sizeof(char));
+    savebuf_put(buf, store->aiState, count * sizeof(uint8_t));
+    savebuf_put(buf, store->hp, count * sizeof(int16_t));
+    savebuf_put(buf, store->timer, count * sizeof(uint8_t));
+}
+
+// Read creatures written by entity_store_write, rejecting bad positions
+bool entity_store_read(EntityStore* store, SaveReader* reader, int mapWidth, int mapHeight)
+{
+    int32_t count = 0;
+    entity_store_init(store, 0);
+    if (!savebuf_get(reader, &count, sizeof(count)) ||
+        !savebuf_get(reader, &store->rng, sizeof(uint32_t))) return false;
+    if (count < 0 || count > MAX_ENTITIES_PER_MAP) return false;
+    
+    // Over budget the creatures are skipped, the map itself still loads
+    if (!entity_store_reserve(store, count)) {
+        reader->pos += (size_t)count * ENTITY_RECORD_BYTES;
+        return reader->pos <= reader->size;
+    }
+    
+    if (!savebuf_get(reader, store->x, count * sizeof(int16_t)) ||
+        !savebuf_get(reader, store->y, count * sizeof(int16_t)) ||
+        !savebuf_get(reader, store->glyph, count * sizeof(char)) ||
+        !savebuf_get(reader, store->aiState, count * sizeof(uint8_t)) ||
+        !savebuf_get(reader, store->hp, count * sizeof(int16_t)) ||
+        !savebuf_get(reader, store->timer, count * sizeof(uint8_t))) return false;
+    
+    for (int i = 0; i < count; i++)
+    {
+        if (store->x[i] < 0 || store->y[i] < 0 || store->x[i] >= mapWidth || store->y[i] >= mapHeight) return false;
+    }
+    
+    store->count = count;
+    return true;
+}
+
+// Scatter creatures over a freshly generated local map
+void entity_populate(LocalMap* local, char worldTile)
+{
+    EntityStore* store = &local->entities;
+    
+    int count;
+    switch (worldTile)
+    {
+        case '.': count = 96; break;   // Open grassland
+        case 'T': count = ENTITY_POPULATE_MAX; break;  // Forests hide more
+        case '^': count = 64; break;
+        case '~': count = 24; break;
+        case '>': count = 48; break;   // Dungeon floors
+        default: count = 0;
+    }
+    
+    if (!entity_store_reserve(store, count)) return;
+    for (int n = 0; n < count; n++)
+    {
+        // A few attempts to land on a passable tile
+        for (int attempt = 0; attempt < 8; attempt++)
+        {
+            int x = 1 + (int)(entity_rand(store) % (local->width - 2));
+            int y = 1 + (int)(entity_rand(store) % (local->height - 2));
+            if (!bitgrid_get(&local->passable, x, y)) continue;
+            
+            const CreatureKind* kind = &creatureKinds[entity_rand(store) % 4];
+            entity_spawn(store, x, y, kind->glyph, kind->hp);
+            break;
+        }
+    }
+}
+
+// AI system: pick a state for every creature from its distance to the player
+void entity_update_ai(EntityStore* store, int playerX, int playerY)
+{
+    int count = store->count;
+    const int16_t* xs = store->x;
+    const int16_t* ys = store->y;
+    uint8_t* states = store->aiState;
+    
+    for (int i = 0; i < count; i++)
+    {
+        int dx = xs[i] - playerX;
+        int dy = ys[i] - playerY;
+        int dist = abs(dx) + abs(dy);
+        states[i] = (dist <= ENTITY_CHASE_RADIUS) ? AI_CHASE : 
+                    (dist <= ENTITY_WAKE_RADIUS) ? AI_WANDER : AI_IDLE;
+    }
+}
+
+// Movement system: creatures whose timer expired take one step
+// Returns true if a creature moved inside the rect
+bool entity_update_movement(EntityStore* store, const BitGrid* passable, int playerX, int playerY, TileRect watch)
+{
+    static const int dirX[4] = { 1, -1, 0, 0 };
+    static const int dirY[4] = { 0, 0, 1, -1 };
+    
+    bool movedInView = false;
+    int count = store->count;
+    
+    for (int i = 0; i < count; i++)
+    {
+        if (store->timer[i] > 0) {
+            store->timer[i]--;
+            continue;
+        }
+        store->timer[i] = ENTITY_THINK_INTERVAL;
+        
+        int state = store->aiState[i];
+        if (state == AI_IDLE) continue;
+        
+        int x = store->x[i];
+        int y = store->y[i];
+        int nx = x, ny = y;
+        
+        if (state == AI_CHASE)
+        {
+            // Close the longer axis first
+            int dx = playerX - x;
+            int dy = playerY - y;
+            if (abs(dx) >= abs(dy)) nx += (dx > 0) - (dx < 0);
+            else ny += (dy > 0) - (dy < 0);
+        }
+        else
+        {
+            int d = entity_rand(store) & 3;
+            nx += dirX[d];
+            ny += dirY[d];
+        }
+        
+        if (nx == playerX && ny == playerY) continue;
+        if (nx < 0 || ny < 0 || nx >= passable->width || ny >= passable->height) continue;
+        if (!bitgrid_get(passable, nx, ny)) continue;
+        
+        store->x[i] = (int16_t)nx;
+        store->y[i] = (int16_t)ny;
+        
+        if ((nx >= watch.x0 && nx < watch.x1 && ny >= watch.y0 && ny < watch.y1) ||
+            (x >= watch.x0 && x < watch.x1 && y >= watch.y0 && y < watch.y1)) movedInView = true;
+    }
+    
+    return movedInView;
+}
+
+// Draw creatures inside the visible tile rect that are in view
+void draw_entities(const EntityStore* store, TileRect visible, const BitGrid* inView)
+{
+    if (inView == NULL) return;
+    
+    int count = store->count;
+    for (int i = 0; i < count; i++)
+    {
+        int x = store->x[i];
+        int y = store->y[i];
+        if (x < visible.x0 || x >= visible.x1 || y < visible.y0 || y >= visible.y1) continue;
+        if (!bitgrid_get(inView, x, y)) continue;
+        
+        Vector2 pos = {
+            (float)(x * TILE_SIZE + 8),
+            (float)(y * TILE_SIZE + 6)
+        };
+        
+        Color color = (store->aiState[i] == AI_CHASE) ? RED : LIGHTGRAY;
+        DrawTextCodepoint(GetFontDefault(), store->glyph[i], pos, 24, color);
+    }
+}
@@ -0,0 +1,310 @@
+#include "project.h"
+
+// Deep Zoom (DZI) export of the whole world at one pixel per local tile.
+// The pyramid is a quadtree over world tiles: a full-resolution image tile
+// is exactly one local map, and each parent averages its four children.
+// Tiles are produced depth-first, so a job only ever holds one image per
+// quadtree level, and missing local maps are generated into scratch memory
+// and thrown away. Nothing the size of the world is ever allocated.
+
+#define EXPORT_TILE 256         // Pixels per image tile side (one local map)
+
+// Shared, read-only description of the pyramid being written
+typedef struct {
+    char filesDir[512];         // <dir>/world_files
+    int depth;                  // Quadtree levels below the root tile
+    int maxLevel;               // DZI level of the full-resolution tiles
+    int imageWidth;             // Full-resolution image size in pixels
+    int imageHeight;
+} ExportPyramid;
+
+// Per-job memory: one image per quadtree level plus a tile scratch
+typedef struct {
+    Color* levels;              // (depth + 1) images of EXPORT_TILE^2 pixels
+    char* tiles;                // Generated local map
+    Color* crop;                // Edge tiles cropped to the image size
+    bool failed;                // A tile could not be written
+} ExportScratch;
+
+// One quadtree tile at the split level and everything under it
+typedef struct {
+    const ExportPyramid* pyramid;
+    int z, tx, ty;
+    Color* result;              // Where its top tile is handed back
+    bool ok;
+} ExportJob;
+
+// Scratch for a job (levels images) or the levels above the split (none)
+static bool export_scratch_init(ExportScratch* scratch, int levels)
+{
+    const size_t pixels = (size_t)EXPORT_TILE * EXPORT_TILE;
+    scratch->levels = levels > 0 ? (Color*)mem_alloc(MEM_EXPORT, levels * pixels * sizeof(Color)) : NULL;
+    scratch->tiles = (char*)mem_alloc(MEM_EXPORT, pixels);
+    scratch->crop = (Color*)mem_alloc(MEM_EXPORT, pixels * sizeof(Color));
+    scratch->failed = false;
+    return (levels == 0 || scratch->levels != NULL) && scratch->tiles != NULL && scratch->crop != NULL;
+}
+
+static void export_scratch_free(ExportScratch* scratch)
+{
+    mem_free(scratch->levels);
+    mem_free(scratch->tiles);
+    mem_free(scratch->crop);
+}
+
+// Pixel size of a DZI level
+static int export_level_size(int fullSize, int maxLevel, int level)
+{
+    int shift = maxLevel - level;
+    return (int)(((int64_t)fullSize + ((int64_t)1 << shift) - 1) >> shift);
+}
+
+// Write one tile, cropped to the level's bounds (skipped if outside them);
+// a failed write marks the scratch
+static void export_write_tile(const ExportPyramid* pyramid, ExportScratch* scratch,
+                              const Color* pixels, int size, int level, int col, int row)
+{
+    int levelWidth = export_level_size(pyramid->imageWidth, pyramid->maxLevel, level);
+    int levelHeight = export_level_size(pyramid->imageHeight, pyramid->maxLevel, level);
+    int width = levelWidth - col * size;
+    int height = levelHeight - row * size;
+    if (width <= 0 || height <= 0) return;
+    if (width > size) width = size;
+    if (height > size) height = size;
+    
+    // Tightly packed copy when the tile hangs over the image edge
+    const Color* data = pixels;
+    if (width != size || height != size)
+    {
+        for (int y = 0; y < height; y++) {
+            memcpy(scratch->crop + (size_t)y * width, pixels + (size_t)y * size, width * sizeof(Color));
+        }
+        data = scratch->crop;
+    }
+    
+    char path[640];
+    snprintf(path, sizeof(path), "%s/%d/%d_%d.png", pyramid->filesDir, level, col, row);
+    Image image = { (void*)data, width, height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+    if (!ExportImage(image, path)) {
+        fprintf(stderr, "export: failed to write %s\n", path);
+        scratch->failed = true;
+    }
+}
+
+// Full-resolution pixels of one world tile
+static void export_render_world_tile(ExportScratch* scratch, int worldX, int worldY, Color* out)
+{
+    const int pixels = EXPORT_TILE * EXPORT_TILE;
+    
+    // Outside the world (non power-of-two sizes): transparent
+    if (worldX >= currentMapWidth || worldY >= currentMapHeight)
+    {
+        memset(out, 0, pixels * sizeof(Color));
+        return;
+    }
+    
+    WorldTile cell = world_cell(worldX, worldY);
+    if (!cell.hasLocalMap)
+    {
+        Color color = get_tile_color(cell.worldTile);
+        for (int i = 0; i < pixels; i++) out[i] = color;
+        return;
+    }
+    
+    // Visited maps are drawn as they are now, others as they would generate
+    const LocalMap* local = cell.localMap;
+    if (local != NULL && local->width == EXPORT_TILE && local->height == EXPORT_TILE)
+    {
+        const char* tiles = local->tiles[0];
+        for (int i = 0; i < pixels; i++) out[i] = get_tile_color(tiles[i]);
+        return;
+    }
+    
+    local_map_fill(scratch->tiles, EXPORT_TILE, EXPORT_TILE,
+                   cell.worldTile, local_map_seed(worldX, worldY));
+    for (int i = 0; i < pixels; i++) out[i] = get_tile_color(scratch->tiles[i]);
+}
+
+// Average a child tile into one quadrant of its parent
+static void export_downsample(const Color* child, Color* parent, int quadrantX, int quadrantY)
+{
+    const int half = EXPORT_TILE / 2;
+    for (int y = 0; y < half; y++)
+    {
+        const Color* row0 = child + (size_t)(y * 2) * EXPORT_TILE;
+        const Color* row1 = row0 + EXPORT_TILE;
+        Color* out = parent + (size_t)(quadrantY * half + y) * EXPORT_TILE + quadrantX * half;
+        for (int x = 0; x < half; x++)
+        {
+            const Color* a = row0 + x * 2;
+            const Color* b = row1 + x * 2;
+            out[x].r = (unsigned char)((a[0].r + a[1].r + b[0].r + b[1].r + 2) >> 2);
+            out[x].g = (unsigned char)((a[0].g + a[1].g + b[0].g + b[1].g + 2) >> 2);
+            out[x].b = (unsigned char)((a[0].b + a[1].b + b[0].b + b[1].b + 2) >> 2);
+            out[x].a = (unsigned char)((a[0].a + a[1].a + b[0].a + b[1].a + 2) >> 2);
+        }
+    }
+}
+
+// Produce quadtree tile (z, tx, ty) and everything under it, depth first;
+// the result is left in scratch->levels at slot z
+static Color* export_build(const ExportPyramid* pyramid, ExportScratch* scratch, int z, int tx, int ty)
+{
+    Color* image = scratch->levels + (size_t)z * EXPORT_TILE * EXPORT_TILE;
+    
+    if (z == pyramid->depth) {
+        export_render_world_tile(scratch, tx, ty, image);
+    }
+    else
+    {
+        for (int q = 0; q < 4; q++)
+        {
+            int cx = tx * 2 + (q & 1);
+            int cy = ty * 2 + (q >> 1);
+            const Color* child = export_build(pyramid, scratch, z + 1, cx, cy);
+            export_downsample(child, image, q & 1, q >> 1);
+        }
+    }
+    
+    int level = pyramid->maxLevel - (pyramid->depth - z);
+    export_write_tile(pyramid, scratch, image, EXPORT_TILE, level, tx, ty);
+    return image;
+}
+
+// Job: build one split-level tile, down to the local maps, in its own
+// scratch, and hand its top tile back
+static void export_job(void* data)
+{
+    ExportJob* job = (ExportJob*)data;
+    ExportScratch scratch;
+    job->ok = export_scratch_init(&scratch, job->pyramid->depth + 1);
+    if (job->ok)
+    {
+        const Color* top = export_build(job->pyramid, &scratch, job->z, job->tx, job->ty);
+        memcpy(job->result, top, (size_t)EXPORT_TILE * EXPORT_TILE * sizeof(Color));
+        job->ok = !scratch.failed;
+    }
+    export_scratch_free(&scratch);
+}
+
+// Levels above the split, from the split level's tiles up to the root,
+// and the DZI levels below the root tile down to a single pixel
+static bool export_top(const ExportPyramid* pyramid, ExportScratch* scratch, Color* results, int split)
+{
+    const size_t pixels = (size_t)EXPORT_TILE * EXPORT_TILE;
+    for (int z = split - 1; z >= 0; z--)
+    {
+        // Parents overwrite the front of the results once their children
+        // are averaged (row-major, a parent never comes after its children)
+        int levelSide = 1 << z;
+        for (int ty = 0; ty < levelSide; ty++)
+        {
+            for (int tx = 0; tx < levelSide; tx++)
+            {
+                Color* image = scratch->levels;
+                for (int q = 0; q < 4; q++)
+                {
+                    int child = (ty * 2 + (q >> 1)) * levelSide * 2 + tx * 2 + (q & 1);
+                    export_downsample(results + (size_t)child * pixels, image, q & 1, q >> 1);
+                }
+                int level = pyramid->maxLevel - (pyramid->depth - z);
+                export_write_tile(pyramid, scratch, image, EXPORT_TILE, level, tx, ty);
+                memcpy(results + (size_t)(ty * levelSide + tx) * pixels, image, pixels * sizeof(Color));
+            }
+        }
+    }
+    
+    // Below the root tile, DZI keeps halving down to a single pixel; each
+    // halving lands in the top-left quadrant of the scratch image
+    Color* root = results;
+    Color* half = scratch->levels;
+    int size = EXPORT_TILE;
+    for (int level = pyramid->maxLevel - pyramid->depth - 1; level >= 0; level--)
+    {
+        export_downsample(root, half, 0, 0);
+        memcpy(root, half, pixels * sizeof(Color));
+        size /= 2;
+        
+        // Only the top-left size x size pixels are meaningful now
+        for (int y = 0; y < size; y++) {
+            memcpy(half + (size_t)y * size, root + (size_t)y * EXPORT_TILE, size * sizeof(Color));
+        }
+        export_write_tile(pyramid, scratch, half, size, level, 0, 0);
+    }
+    return !scratch->failed;
+}
+
+// Export the current world as <directory>/world.dzi plus world_files/ on
+// the job system. Blocks until the pyramid is written; false if a tile
+// could not be written or memory was refused.
+bool export_world_pyramid(const char* directory)
+{
+    if (worldMap == NULL) return false;
+    
+    ExportPyramid pyramid;
+    snprintf(pyramid.filesDir, sizeof(pyramid.filesDir), "%s/world_files", directory);
+    
+    int side = currentMapWidth > currentMapHeight ? currentMapWidth : currentMapHeight;
+    pyramid.depth = 0;
+    while ((1 << pyramid.depth) < side) pyramid.depth++;
+    
+    pyramid.imageWidth = currentMapWidth * EXPORT_TILE;
+    pyramid.imageHeight = currentMapHeight * EXPORT_TILE;
+    int largest = pyramid.imageWidth > pyramid.imageHeight ? pyramid.imageWidth : pyramid.imageHeight;
+    pyramid.maxLevel = 0;
+    while ((1 << pyramid.maxLevel) < largest) pyramid.maxLevel++;
+    
+    // Level directories up front, so jobs only write files
+    MakeDirectory(directory);
+    MakeDirectory(pyramid.filesDir);
+    for (int level = 0; level <= pyramid.maxLevel; level++) {
+        MakeDirectory(TextFormat("%s/%d", pyramid.filesDir, level));
+    }
+    
+    // Split at the first quadtree level with a few jobs per thread (the
+    // main thread helps while it waits)
+    int threads = jobs_worker_count() + 1;
+    int split = 0;
+    while (split < pyramid.depth && (1 << (2 * split)) < threads * 4) split++;
+    int splitSide = 1 << split;
+    int jobCount = splitSide * splitSide;
+    
+    // Each job hands back its top tile for the levels above the split
+    const size_t pixels = (size_t)EXPORT_TILE * EXPORT_TILE;
+    Color* results = (Color*)mem_alloc(MEM_EXPORT, (size_t)jobCount * pixels * sizeof(Color));
+    ExportJob* jobs = (ExportJob*)mem_calloc(MEM_EXPORT, jobCount, sizeof(ExportJob));
+    JobId* ids = (JobId*)mem_calloc(MEM_EXPORT, jobCount, sizeof(JobId));
+    ExportScratch scratch;
+    bool ok = export_scratch_init(&scratch, 1) && results != NULL && jobs != NULL && ids != NULL;
+    
+    for (int i = 0; i < jobCount && ok; i++)
+    {
+        jobs[i] = (ExportJob){ &pyramid, split, i % splitSide, i / splitSide, results + (size_t)i * pixels, false };
+        ids[i] = job_run(export_job, &jobs[i], JOB_HIGH);
+    }
+    for (int i = 0; i < jobCount && ids != NULL; i++)
+    {
+        job_wait(ids[i]);
+        ok = ok && jobs[i].ok;
+    }
+    
+    ok = ok && export_top(&pyramid, &scratch, results, split);
+    export_scratch_free(&scratch);
+    mem_free(results);
+    mem_free(jobs);
+    mem_free(ids);
+    if (!ok) return false;
+    
+    // Descriptor read by Deep Zoom viewers (e.g. OpenSeadragon)
+    char dziPath[640];
+    snprintf(dziPath, sizeof(dziPath), "%s/world.dzi", directory);
+    FILE* dzi = fopen(dziPath, "w");
+    if (dzi == NULL) return false;
+    fprintf(dzi,
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" Format=\"png\" "
+        "Overlap=\"0\" TileSize=\"%d\">\n"
+        "  <Size Width=\"%d\" Height=\"%d\"/>\n"
+        "</Image>\n", EXPORT_TILE, pyramid.imageWidth, pyramid.imageHeight);
+    return fclose(dzi) == 0;
+}
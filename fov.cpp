@@ -0,0 +1,202 @@
+#include "project.h"
+
+// Tiles seen from the player's current position
+BitGrid fovVisible = { NULL, 0, 0, 0 };
+
+// What the current field of view was computed for
+static const void* fovMapKey = NULL;
+static int fovOriginX = -1;
+static int fovOriginY = -1;
+static bool fovStale = true;
+
+// Tiles that block sight
+bool tile_is_opaque(char tile)
+{
+    return tile == '#' || tile == '^';
+}
+
+// Rebuild a local map's opacity bits from its tiles
+void local_map_build_opaque(LocalMap* local)
+{
+    const char* tiles = local->tiles[0];
+    grid_dispatch(local->width, local->height, [&](auto shape) {
+        grid_pack_bits(shape, local->opaque.words, [&](size_t i) { return tile_is_opaque(tiles[i]); });
+    });
+}
+
+// Rebuild the opacity bits of the world's view
+void world_build_opaque()
+{
+    const char* tiles = worldMap->tiles;
+    grid_dispatch(worldOpaque.width, worldOpaque.height, [&](auto shape) {
+        grid_pack_bits(shape, worldOpaque.words, [&](size_t i) { return tile_is_opaque(tiles[i]); });
+    });
+}
+
+// Force a recompute on the next fov_update
+void fov_invalidate()
+{
+    fovStale = true;
+}
+
+// Shadowcasting state for one computation
+typedef struct {
+    const BitGrid* opaque;
+    BitGrid* visible;
+    int originX, originY;
+    int radius;
+} FovContext;
+
+// Opaque test treating everything off the map as a wall
+static inline bool fov_blocks(const FovContext* ctx, int x, int y)
+{
+    if (x < 0 || y < 0 || x >= ctx->opaque->width || y >= ctx->opaque->height) return true;
+    return bitgrid_get(ctx->opaque, x, y);
+}
+
+// Scan one octant row by row, recursing around blockers
+static void fov_cast(const FovContext* ctx, int row, float start, float end, 
+                     int xx, int xy, int yx, int yy)
+{
+    if (start < end) return;
+    
+    int radius = ctx->radius;
+    int radius2 = radius * radius + radius;
+    float newStart = 0.0f;
+    
+    for (int j = row; j <= radius; j++)
+    {
+        int dy = -j;
+        bool blocked = false;
+        
+        for (int dx = -j; dx <= 0; dx++)
+        {
+            float leftSlope = (dx - 0.5f) / (dy + 0.5f);
+            float rightSlope = (dx + 0.5f) / (dy - 0.5f);
+            if (start < rightSlope) continue;
+            if (end > leftSlope) break;
+            
+            int x = ctx->originX + dx * xx + dy * xy;
+            int y = ctx->originY + dx * yx + dy * yy;
+            bool inside = x >= 0 && y >= 0 && x < ctx->visible->width && y < ctx->visible->height;
+            
+            if (inside && dx * dx + dy * dy <= radius2) {
+                bitgrid_put(ctx->visible, x, y, true);
+            }
+            
+            bool wall = fov_blocks(ctx, x, y);
+            if (blocked)
+            {
+                if (wall) {
+                    newStart = rightSlope;
+                } else {
+                    blocked = false;
+                    start = newStart;
+                }
+            }
+            else if (wall && j < radius)
+            {
+                // Light the part past this blocker separately
+                blocked = true;
+                fov_cast(ctx, j + 1, start, leftSlope, xx, xy, yx, yy);
+                newStart = rightSlope;
+            }
+        }
+        
+        if (blocked) break;
+    }
+}
+
+// Recursive shadowcasting from an origin, then fold the result into explored
+// (if there is one)
+void fov_compute(const BitGrid* opaque, BitGrid* visible, BitGrid* explored, 
+                 int originX, int originY, int radius)
+{
+    static const int octants[8][4] = {
+        { 1, 0, 0, 1 }, { 0, 1, 1, 0 }, { 0, -1, 1, 0 }, { -1, 0, 0, 1 },
+        { -1, 0, 0, -1 }, { 0, -1, -1, 0 }, { 0, 1, -1, 0 }, { 1, 0, 0, -1 }
+    };
+    
+    bitgrid_clear(visible);
+    bitgrid_put(visible, originX, originY, true);
+    
+    FovContext ctx = { opaque, visible, originX, originY, radius };
+    for (int i = 0; i < 8; i++)
+    {
+        fov_cast(&ctx, 1, 1.0f, 0.0f, octants[i][0], octants[i][1], octants[i][2], octants[i][3]);
+    }
+    
+    if (explored == NULL) return;
+    
+    // Explored |= visible, a word at a time over the rows in range
+    int y0 = originY - radius < 0 ? 0 : originY - radius;
+    int y1 = originY + radius + 1 > visible->height ? visible->height : originY + radius + 1;
+    for (int y = y0; y < y1; y++)
+    {
+        const uint64_t* src = &visible->words[y * visible->stride];
+        uint64_t* dst = &explored->words[y * explored->stride];
+        for (int w = 0; w < visible->stride; w++)
+        {
+            dst[w] |= src[w];
+        }
+    }
+}
+
+// Recompute the field of view if the player or map changed
+// Returns true when it was recomputed
+bool fov_update()
+{
+    const BitGrid* opaque;
+    BitGrid* explored;
+    const void* key;
+    int x, y, radius;
+    
+    if (isInLocalMap)
+    {
+        LocalMap* local = current_local_map();
+        if (local == NULL) return false;
+        opaque = &local->opaque;
+        explored = &local->explored;
+        key = local;
+        x = localPlayer.x;
+        y = localPlayer.y;
+        radius = FOV_RADIUS;
+    }
+    else
+    {
+        // In view coordinates; the world keeps explored bits in its chunks
+        opaque = &worldOpaque;
+        explored = NULL;
+        key = worldMap;
+        x = player.x - worldMap->view.x0;
+        y = player.y - worldMap->view.y0;
+        radius = WORLD_FOV_RADIUS;
+    }
+    
+    if (!fovStale && key == fovMapKey && x == fovOriginX && y == fovOriginY) return false;
+    
+    // Resize the visible set when switching between map sizes
+    if (fovVisible.width != opaque->width || fovVisible.height != opaque->height) {
+        bitgrid_free(&fovVisible);
+        if (!bitgrid_init(&fovVisible, opaque->width, opaque->height, MEM_FOV)) return false;
+    }
+    
+    fov_compute(opaque, &fovVisible, explored, x, y, radius);
+    if (explored == NULL) world_explore(&fovVisible, y - radius, y + radius + 1);
+    else current_local_map()->stateVersion++;
+    tilemap_mark_fov(key, (TileRect){ x - radius, y - radius, x + radius + 1, y + radius + 1 });
+    
+    fovMapKey = key;
+    fovOriginX = x;
+    fovOriginY = y;
+    fovStale = false;
+    return true;
+}
+
+// Release the visible set
+void fov_shutdown()
+{
+    bitgrid_free(&fovVisible);
+    fovMapKey = NULL;
+    fovStale = true;
+}
@@ -1,7 +1,9 @@
 #include "project.h"
 
 // Global game variables
-WorldTile** worldMap = NULL;
+WorldMap* worldMap = NULL;
+BitGrid worldPassable = { NULL, 0, 0, 0 };
+BitGrid worldOpaque = { NULL, 0, 0, 0 };
 Player player;
 Player localPlayer;
 GameState currentState = STATE_TITLE;
@@ -9,11 +11,58 @@ GameCamera gameCamera;
 bool isInLocalMap = false;
 int saveSlotSelected = 0;
 bool shouldQuit = false;  // Quit flag
+bool frameDirty = true;   // Draw at least the first frame
+bool showDebugHud = false;
+bool headlessMode = false;  // No window or audio (headless replay, server, terminal)
+bool allocCheck = false;    // Report allocations made by steady-state frames
+uint32_t sessionSeed = 1;   // Seeds every world generated this session
+uint32_t worldSeed = 1;     // Seed of the current world, local maps derive from it
+
+// Worlds generated so far, so each new game gets its own seed
+static uint32_t worldsGenerated = 0;
+
+// Short message shown over any screen (e.g. memory budget refusals)
+static char statusMessage[128] = "";
+static int statusTicks = 0;
 
 // Menu variables
 int selectedOption = 0;
 bool hasSave = false;
 
+// What the last rendered frame showed, for idle detection
+static GameState lastDrawnState = STATE_TITLE;
+static Camera2D lastDrawnView;
+static bool lastFocused = true;
+
+// Auto-repeat counters for held movement keys (right, left, up, down)
+static int moveRepeat[4] = {0, 0, 0, 0};
+
+// A local map being generated ahead of time on a worker. Slots keep their
+// map between uses and rebuild it in place, so walking never allocates.
+typedef struct {
+    LocalMap* local;        // Pooled map, NULL if the budget refused one
+    bool used;              // Building or built for the world tile below
+    int x, y;               // World tile it belongs to
+    char worldTile;
+    uint32_t seed;
+    uint32_t creatureSeed;
+    JobId job;
+} LocalPrefetch;
+
+static LocalPrefetch localPrefetch[LOCAL_PREFETCH_SLOTS];
+static bool localPrefetchFilling = false;   // A slot's map is being set up
+
+static uint32_t local_map_creature_seed(int worldX, int worldY);
+static void local_map_build(LocalMap* local, int depth, char worldTile, uint32_t seed, uint32_t creatureSeed);
+static LocalMap* local_prefetch_take(int worldX, int worldY);
+static void local_prefetch_around(int worldX, int worldY);
+static void local_prefetch_reserve();
+static void local_prefetch_evict(size_t bytesNeeded);
+
+// Click-to-move progress along pathFinder.route
+static int routeStep = 0;
+static int routeTimer = 0;
+
 // Map data
 int currentMapWidth = DEFAULT_WORLD_WIDTH;
 int currentMapHeight = DEFAULT_WORLD_HEIGHT;
@@ -25,22 +74,12 @@ MapConfig mapSizes[NUM_SIZES] = {
     {32, 32, "MEDIUM", 1.5f},
     {64, 64, "LARGE", 0.8f},
     {128, 128, "HUGE", 0.4f},
-    {256, 256, "GIGANTIC", 0.2f}
+    {256, 256, "GIGANTIC", 0.2f},
+    {1024, 1024, "VAST", 0.2f},
+    {4096, 4096, "COLOSSAL", 0.2f},
+    {16384, 16384, "ENDLESS", 0.2f}
 };
 
-// Check if save file exists
-bool save_file_exists(int slot)
-{
-    char filename[50];
-    sprintf(filename, "save_%d.dat", slot);
-    FILE* test = fopen(filename, "rb");
-    if (test) {
-        fclose(test);
-        return true;
-    }
-    return false;
-}
-
 // Clamp a value between min and max
 float clamp_float(float value, float min, float max)
 {
@@ -87,6 +126,10 @@ void init_camera()
             (float)(currentMapHeight * TILE_SIZE) / 2.0f
         };
     }
+    
+    // Snap instead of interpolating from the old position
+    gameCamera.prevTarget = gameCamera.camera.target;
+    gameCamera.view = gameCamera.camera;
 }
 
 // Reset camera to defaults
@@ -95,12 +138,15 @@ void reset_camera_to_default()
     init_camera();
 }
 
-// Update camera to follow player
+// Update camera to follow player (once per simulation tick)
 void update_camera()
 {
     int screenWidth = GetScreenWidth();
     int screenHeight = GetScreenHeight();
     
+    // Remember where this tick started for render interpolation
+    gameCamera.prevTarget = gameCamera.camera.target;
+    
     // Update camera offset
     gameCamera.camera.offset = (Vector2){ 
         (float)screenWidth / 2.0f, 
@@ -127,8 +173,8 @@ void update_camera()
     gameCamera.camera.target.y += (targetPos.y - gameCamera.camera.target.y) * lerpSpeed;
     
     float mapWidthWorld, mapHeightWorld;
-    if (isInLocalMap && worldMap[player.y][player.x].localMap != NULL) {
-        LocalMap* local = worldMap[player.y][player.x].localMap;
+    LocalMap* local = current_local_map();
+    if (local != NULL) {
         mapWidthWorld = local->width * TILE_SIZE;
         mapHeightWorld = local->height * TILE_SIZE;
     } else {
@@ -137,7 +183,7 @@ void update_camera()
     }
     
     // Handle zoom with mouse wheel
-    float wheelMove = GetMouseWheelMove();
+    float wheelMove = input_wheel_move();
     if (wheelMove != 0) {
         float zoomChange = wheelMove * 0.1f * gameCamera.zoom;
         float newZoom = gameCamera.zoom + zoomChange;
@@ -157,6 +203,10 @@ void update_camera()
         } else if (currentMapWidth <= 32 && currentMapHeight <= 32) {
             minZoom = 0.3f;
             maxZoom = 4.0f;
+        } else if (worldMap->sparse) {
+            // The screen stays inside the view the tiles are cached for
+            minZoom = 0.2f;
+            maxZoom = 3.0f;
         } else {
             minZoom = 0.1f;
             maxZoom = 3.0f;
@@ -199,22 +249,119 @@ void update_camera()
     }
 }
 
+// Show a message for a few seconds
+void show_status(const char* message)
+{
+    snprintf(statusMessage, sizeof(statusMessage), "%s", message);
+    statusTicks = TICK_RATE * 3;
+    mark_frame_dirty();
+}
+
+// Message being shown, NULL once it expired
+const char* game_status_message()
+{
+    return statusTicks > 0 ? statusMessage : NULL;
+}
+
+// Interpolate the camera between simulation ticks
+void update_camera_view(float alpha)
+{
+    gameCamera.view = gameCamera.camera;
+    gameCamera.view.target.x = gameCamera.prevTarget.x + (gameCamera.camera.target.x - gameCamera.prevTarget.x) * alpha;
+    gameCamera.view.target.y = gameCamera.prevTarget.y + (gameCamera.camera.target.y - gameCamera.prevTarget.y) * alpha;
+}
+
+// Request a redraw on the next frame
+void mark_frame_dirty()
+{
+    frameDirty = true;
+}
+
+// Check whether anything visible changed since the last rendered frame
+bool game_needs_redraw(float alpha)
+{
+    // Without a window there is no focus to lose or size to change
+    bool focused = headlessMode || IsWindowFocused();
+    if (focused != lastFocused) {
+        lastFocused = focused;
+        frameDirty = true;
+    }
+    
+    if (frameDirty || (!headlessMode && IsWindowResized()) || currentState != lastDrawnState) return true;
+    
+    if (currentState == STATE_PLAYING)
+    {
+        // Camera still settling or zooming
+        update_camera_view(alpha);
+        if (fabsf(gameCamera.view.target.x - lastDrawnView.target.x) > 0.01f ||
+            fabsf(gameCamera.view.target.y - lastDrawnView.target.y) > 0.01f ||
+            gameCamera.view.zoom != lastDrawnView.zoom ||
+            gameCamera.view.offset.x != lastDrawnView.offset.x ||
+            gameCamera.view.offset.y != lastDrawnView.offset.y) return true;
+    }
+    
+    return false;
+}
+
+// Does the game change with nobody at the keys? Jobs in flight, living
+// terrain, a status message counting down or creatures awake near the
+// player all need ticks; without them idling can wait for input alone.
+bool game_has_background_work()
+{
+    if (jobs_busy() || sim_pending() || statusTicks > 0) return true;
+    if (currentState != STATE_PLAYING || !isInLocalMap) return false;
+    
+    const EntityStore* store = &current_local_map()->entities;
+    for (int i = 0; i < store->count; i++)
+    {
+        if (store->aiState[i] != AI_IDLE) return true;
+    }
+    return false;
+}
+
+// Map the current frame plays on (NULL away from the play screen)
+const void* game_frame_map()
+{
+    if (currentState != STATE_PLAYING || worldMap == NULL) return NULL;
+    if (isInLocalMap) return current_local_map();
+    return worldMap;
+}
+
+// After a frame that began on startMap: was it steady-state play? A frame
+// that arrives on a map or leaves one may allocate, and so may one that
+// stores a new world chunk or moves the world view; the frames between may not.
+bool game_frame_steady(const void* startMap)
+{
+    static uint32_t lastLayout = 0;
+    bool reshaped = worldMap != NULL && worldMap->layout != lastLayout;
+    if (worldMap != NULL) lastLayout = worldMap->layout;
+    return !reshaped && startMap != NULL && game_frame_map() == startMap;
+}
+
 // Initialize game
 void gamestartup()
 {
-    InitAudioDevice();
+    if (!headlessMode) InitAudioDevice();
     player = {2, 2};
     localPlayer = {2, 2};
     currentState = STATE_TITLE;
     selectedOption = 0;
     hasSave = false;
-    isInLocalMap = false;
+    player_stack_reset();
     shouldQuit = false;
+    refresh_save_slots();
+    
+    // Caches that can be rebuilt give their memory back before the budget
+    // refuses anything
+    mem_set_evictor(MEM_LOCAL, local_prefetch_evict);
+    mem_set_evictor(MEM_RENDER, tilemap_evict);
 }
 
 // Toggle fullscreen mode
 void togglefullscreen(int windowWidth, int windowHeight)
 {
+    if (headlessMode) return;
+    
     if(!IsWindowFullscreen())
     {
         int monitor = GetCurrentMonitor();
@@ -244,27 +391,54 @@ void togglefullscreen(int windowWidth, int windowHeight)
     }
 }
 
-// Create world map
-void generate_world_map(int width, int height)
+// Allocate a world and its view's derived grids (false if over budget);
+// small worlds get every chunk up front, sparse ones none
+bool world_alloc(int width, int height)
 {
-    cleanup_all_maps();
+    worldMap = (WorldMap*)mem_calloc(MEM_WORLD, 1, sizeof(WorldMap));
+    if (worldMap == NULL) return false;
     
     currentMapWidth = width;
     currentMapHeight = height;
+    worldMap->sparse = width > WORLD_VIEW_SIDE || height > WORLD_VIEW_SIDE;
+    int viewWidth = worldMap->sparse ? WORLD_VIEW_SIDE : width;
+    int viewHeight = worldMap->sparse ? WORLD_VIEW_SIDE : height;
+    worldMap->view = (TileRect){ 0, 0, viewWidth, viewHeight };
+    worldMap->tiles = (char*)mem_alloc(MEM_WORLD, (size_t)viewWidth * viewHeight);
+    
+    bool ok = worldMap->tiles != NULL &&
+              bitgrid_init(&worldPassable, viewWidth, viewHeight, MEM_WORLD) &&
+              bitgrid_init(&worldOpaque, viewWidth, viewHeight, MEM_WORLD);
+    for (int y = 0; y < height && ok && !worldMap->sparse; y += WORLD_CHUNK)
+    {
+        for (int x = 0; x < width && ok; x += WORLD_CHUNK) ok = world_chunk_store(x, y) != NULL;
+    }
+    if (!ok)
+    {
+        cleanup_all_maps();
+        return false;
+    }
     
-    // Allocate world map memory
-    worldMap = (WorldTile**)malloc(height * sizeof(WorldTile*));
+    // Spare local maps for the background generator
+    local_prefetch_reserve();
+    return true;
+}
+
+// Random terrain inside a wall border, in row order (rand() draws are what
+// make a world seed reproducible); sparse worlds generate theirs per chunk
+static void world_generate_terrain(int width, int height)
+{
     for (int y = 0; y < height; y++)
     {
-        worldMap[y] = (WorldTile*)malloc(width * sizeof(WorldTile));
-        
         for (int x = 0; x < width; x++)
         {
+            WorldTile* cell = &world_chunk(x, y)->cells[world_chunk_cell(x, y)];
+            
             // Border walls
             if (x == 0 || x == width - 1 || y == 0 || y == height - 1)
             {
-                worldMap[y][x].worldTile = '#';
-                worldMap[y][x].hasLocalMap = false;
+                cell->worldTile = '#';
+                cell->hasLocalMap = false;
             }
             else
             {
@@ -272,24 +446,24 @@ void generate_world_map(int width, int height)
                 float randVal = (float)rand() / RAND_MAX;
                 
                 if (randVal < 0.05) {
-                    worldMap[y][x].worldTile = '~';
-                    worldMap[y][x].hasLocalMap = true;  // Water can have local maps
+                    cell->worldTile = '~';
+                    cell->hasLocalMap = true;  // Water can have local maps
                 }
                 else if (randVal < 0.15) {
-                    worldMap[y][x].worldTile = '^';
-                    worldMap[y][x].hasLocalMap = true;  // Mountains can have local maps
+                    cell->worldTile = '^';
+                    cell->hasLocalMap = true;  // Mountains can have local maps
                 }
                 else if (randVal < 0.20) {
-                    worldMap[y][x].worldTile = 'T';
-                    worldMap[y][x].hasLocalMap = true;  // Forests can have local maps
+                    cell->worldTile = 'T';
+                    cell->hasLocalMap = true;  // Forests can have local maps
                 }
                 else {
-                    worldMap[y][x].worldTile = '.';
-                    worldMap[y][x].hasLocalMap = true;  // Grasslands can have local maps
+                    cell->worldTile = '.';
+                    cell->hasLocalMap = true;  // Grasslands can have local maps
                 }
             }
             
-            worldMap[y][x].localMap = NULL; // Not generated yet
+            cell->localMap = NULL; // Not generated yet
         }
     }
     
@@ -299,11 +473,30 @@ void generate_world_map(int width, int height)
         for (int x = 1; x <= 3; x++)
         {
             if (y < height && x < width) {
-                worldMap[y][x].worldTile = '.';
-                worldMap[y][x].hasLocalMap = true;
+                WorldTile* cell = &world_chunk(x, y)->cells[world_chunk_cell(x, y)];
+                cell->worldTile = '.';
+                cell->hasLocalMap = true;
             }
         }
     }
+}
+
+// Create world map (false if it doesn't fit the memory budget)
+bool generate_world_map(int width, int height)
+{
+    cleanup_all_maps();
+    
+    // Allocate world map memory
+    if (!world_alloc(width, height))
+    {
+        show_status("Not enough memory budget for this world size");
+        return false;
+    }
+    
+    // Same session seed, same sequence of worlds (replays depend on this)
+    worldSeed = sessionSeed + worldsGenerated++ * 2654435761u;
+    srand(worldSeed);
+    if (!worldMap->sparse) world_generate_terrain(width, height);
     
     // Set player start
     player.x = 2;
@@ -311,78 +504,178 @@ void generate_world_map(int width, int height)
     localPlayer.x = 2;
     localPlayer.y = 2;
     
+    // Passability, sight and distance fields around the start, and
+    // pathfinding scratch for the view
+    world_view_center(player.x, player.y);
+    world_reserve_scratch();
+    
     // Setup camera
     init_camera();
+    return true;
 }
 
-// Generate local map at specific world coordinates
-void generate_local_map_at(int worldX, int worldY)
+// Scratch sized for the world's view (paths, distance field edits, living
+// terrain's map list) or a local map, whichever is larger
+void world_reserve_scratch()
 {
-    if (!worldMap[worldY][worldX].hasLocalMap) return;
+    int tiles = (worldMap->view.x1 - worldMap->view.x0) * (worldMap->view.y1 - worldMap->view.y0);
+    if (tiles < LOCAL_MAP_WIDTH * LOCAL_MAP_HEIGHT) tiles = LOCAL_MAP_WIDTH * LOCAL_MAP_HEIGHT;
+    path_reserve(tiles);
+    feature_reserve(tiles);
+    stats_reserve(LOCAL_MAP_WIDTH * LOCAL_MAP_HEIGHT);
+    sim_reserve((worldMap->view.x1 - worldMap->view.x0) * (worldMap->view.y1 - worldMap->view.y0));
+}
+
+// Allocate an empty local map with contiguous tiles (NULL if over budget)
+LocalMap* local_map_alloc(int width, int height)
+{
+    LocalMap* local = (LocalMap*)mem_calloc(MEM_LOCAL, 1, sizeof(LocalMap));
+    if (local == NULL) return NULL;
+    
+    local->width = width;
+    local->height = height;
+    local->tiles = (char**)mem_alloc(MEM_LOCAL, height * sizeof(char*));
+    char* cells = (char*)mem_alloc(MEM_LOCAL, (size_t)width * height);
+    local->next.edits = (TileEdit*)mem_alloc(MEM_LOCAL, SIM_MAX_CHANGES * sizeof(TileEdit));
+    
+    if (local->tiles == NULL || cells == NULL || local->next.edits == NULL ||
+        !bitgrid_init(&local->passable, width, height, MEM_LOCAL) ||
+        !bitgrid_init(&local->opaque, width, height, MEM_LOCAL) ||
+        !bitgrid_init(&local->explored, width, height, MEM_LOCAL))
+    {
+        if (local->tiles) local->tiles[0] = cells;
+        else mem_free(cells);
+        local_map_free(local);
+        return NULL;
+    }
     
-    // Allocate local map
-    LocalMap* local = (LocalMap*)malloc(sizeof(LocalMap));
-    local->width = LOCAL_MAP_WIDTH;   // 256 as requested
-    local->height = LOCAL_MAP_HEIGHT; // 256 as requested
+    // Rows point into one contiguous block
+    for (int y = 0; y < height; y++)
+    {
+        local->tiles[y] = cells + (size_t)y * width;
+    }
     
-    // Allocate tiles
-    local->tiles = (char**)malloc(local->height * sizeof(char*));
-    for (int y = 0; y < local->height; y++)
+    return local;
+}
+
+// Drop the render caches of a map and of every map below it
+static void local_map_forget(LocalMap* local)
+{
+    tilemap_forget(local);
+    for (int i = 0; i < local->children.capacity; i++)
     {
-        local->tiles[y] = (char*)malloc((local->width + 1) * sizeof(char));
-        
-        for (int x = 0; x < local->width; x++)
+        if (local->children.slots[i].tile != 0) local_map_forget(local->children.slots[i].map);
+    }
+}
+
+// Free a local map, the maps below it and everything they own
+void local_map_free(LocalMap* local)
+{
+    if (local == NULL) return;
+    
+    local_map_forget(local);
+    local_map_destroy(local);
+}
+
+// Release a local map's memory (and its children's); touches no globals, so
+// any thread may call it
+void local_map_destroy(LocalMap* local)
+{
+    map_children_free(&local->children);
+    if (local->tiles) mem_free(local->tiles[0]);
+    mem_free(local->tiles);
+    bitgrid_free(&local->passable);
+    bitgrid_free(&local->opaque);
+    bitgrid_free(&local->explored);
+    entity_store_free(&local->entities);
+    tile_journal_free(&local->changes);
+    feature_fields_free(&local->fields);
+    mem_free(local->next.edits);
+    mem_free(local);
+}
+
+// Next pseudo-random value in [0, 1) from a local map's generator
+static float local_map_rand(uint32_t* state)
+{
+    uint32_t v = *state;
+    v ^= v << 13;
+    v ^= v >> 17;
+    v ^= v << 5;
+    *state = v;
+    return (float)(v >> 8) / 16777216.0f;
+}
+
+// Generator seed for the local map under one world tile
+uint32_t local_map_seed(int worldX, int worldY)
+{
+    uint32_t h = worldSeed ^ ((uint32_t)worldY * 65537u + (uint32_t)worldX) * 2654435761u;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h ? h : 1;
+}
+
+// Local map terrain for one grid shape (see local_map_fill)
+template <typename Shape>
+static void local_map_fill_shape(char* tiles, Shape shape, char worldTile, uint32_t seed)
+{
+    uint32_t rng = seed;
+    
+    for (int y = 0; y < shape.height(); y++)
+    {
+        for (int x = 0; x < shape.width(); x++)
         {
             // Border walls
-            if (x == 0 || x == local->width - 1 || y == 0 || y == local->height - 1)
+            if (x == 0 || x == shape.width() - 1 || y == 0 || y == shape.height() - 1)
             {
-                local->tiles[y][x] = '#';
+                tiles[shape.index(x, y)] = '#';
             }
             else
             {
                 // Generate based on world tile type with variety
-                switch (worldMap[worldY][worldX].worldTile)
+                switch (worldTile)
                 {
                     case '.':  // Grassland
                         {
-                            float randVal = (float)rand() / RAND_MAX;
-                            if (randVal < 0.02) local->tiles[y][x] = '~';      // Some water
-                            else if (randVal < 0.04) local->tiles[y][x] = '^'; // Some mountains
-                            else if (randVal < 0.10) local->tiles[y][x] = 'T'; // Some trees
-                            else local->tiles[y][x] = '.';
+                            float randVal = local_map_rand(&rng);
+                            if (randVal < 0.02) tiles[shape.index(x, y)] = '~';      // Some water
+                            else if (randVal < 0.04) tiles[shape.index(x, y)] = '^'; // Some mountains
+                            else if (randVal < 0.10) tiles[shape.index(x, y)] = 'T'; // Some trees
+                            else tiles[shape.index(x, y)] = '.';
                         }
                         break;
                     case 'T':  // Forest
                         {
-                            float randVal = (float)rand() / RAND_MAX;
-                            if (randVal < 0.01) local->tiles[y][x] = '~';      // Some water
-                            else if (randVal < 0.02) local->tiles[y][x] = '^'; // Some mountains
-                            else if (randVal < 0.70) local->tiles[y][x] = 'T'; // Mostly trees
-                            else local->tiles[y][x] = '.';
+                            float randVal = local_map_rand(&rng);
+                            if (randVal < 0.01) tiles[shape.index(x, y)] = '~';      // Some water
+                            else if (randVal < 0.02) tiles[shape.index(x, y)] = '^'; // Some mountains
+                            else if (randVal < 0.70) tiles[shape.index(x, y)] = 'T'; // Mostly trees
+                            else tiles[shape.index(x, y)] = '.';
                         }
                         break;
                     case '~':  // Water
                         {
-                            float randVal = (float)rand() / RAND_MAX;
-                            if (randVal < 0.90) local->tiles[y][x] = '~';      // Mostly water
-                            else if (randVal < 0.95) local->tiles[y][x] = '.'; // Some land
-                            else local->tiles[y][x] = '^';                     // Some mountains in water
+                            float randVal = local_map_rand(&rng);
+                            if (randVal < 0.90) tiles[shape.index(x, y)] = '~';      // Mostly water
+                            else if (randVal < 0.95) tiles[shape.index(x, y)] = '.'; // Some land
+                            else tiles[shape.index(x, y)] = '^';                     // Some mountains in water
                         }
                         break;
                     case '^':  // Mountains
                         {
-                            float randVal = (float)rand() / RAND_MAX;
-                            if (randVal < 0.85) local->tiles[y][x] = '^';      // Mostly mountains
-                            else if (randVal < 0.90) local->tiles[y][x] = '~'; // Some water
-                            else local->tiles[y][x] = '.';                     // Some clear areas
+                            float randVal = local_map_rand(&rng);
+                            if (randVal < 0.85) tiles[shape.index(x, y)] = '^';      // Mostly mountains
+                            else if (randVal < 0.90) tiles[shape.index(x, y)] = '~'; // Some water
+                            else tiles[shape.index(x, y)] = '.';                     // Some clear areas
                         }
                         break;
                     default:
-                        local->tiles[y][x] = '.';
+                        tiles[shape.index(x, y)] = '.';
                 }
             }
         }
-        local->tiles[y][local->width] = '\0';
     }
     
     // Clear starting area in local map
@@ -390,201 +683,524 @@ void generate_local_map_at(int worldX, int worldY)
     {
         for (int x = 1; x <= 3; x++)
         {
-            if (y < local->height && x < local->width)
-                local->tiles[y][x] = '.';
+            if (y < shape.height() && x < shape.width())
+                tiles[shape.index(x, y)] = '.';
+        }
+    }
+}
+
+// Dungeon floor: solid rock dug out by a random walk from the middle, so
+// every open tile can be reached from where the player arrives
+template <typename Shape>
+static void dungeon_fill_shape(char* tiles, Shape shape, uint32_t seed)
+{
+    uint32_t rng = seed;
+    memset(tiles, '#', (size_t)shape.width() * shape.height());
+    
+    int x = shape.width() / 2;
+    int y = shape.height() / 2;
+    int open = 0;
+    int target = (shape.width() - 2) * (shape.height() - 2) * 2 / 5;
+    while (open < target)
+    {
+        char* tile = &tiles[shape.index(x, y)];
+        if (*tile == '#') {
+            *tile = local_map_rand(&rng) < 0.03f ? '~' : '.';  // The odd pool
+            open++;
+        }
+        
+        // One step, never onto the border
+        float step = local_map_rand(&rng);
+        if (step < 0.25f) { if (x + 2 < shape.width()) x++; }
+        else if (step < 0.50f) { if (x > 1) x--; }
+        else if (step < 0.75f) { if (y + 2 < shape.height()) y++; }
+        else { if (y > 1) y--; }
+    }
+}
+
+// Fill a local map's tiles (row-major) from its world tile and seed ('>'
+// for a dungeon floor); touches no globals, so it can run on any thread
+void local_map_fill(char* tiles, int width, int height, char worldTile, uint32_t seed)
+{
+    if (worldTile == '>') {
+        grid_dispatch(width, height, [&](auto shape) { dungeon_fill_shape(tiles, shape, seed); });
+        return;
+    }
+    grid_dispatch(width, height, [&](auto shape) { local_map_fill_shape(tiles, shape, worldTile, seed); });
+}
+
+// Generate the map under a tile of parent (NULL = the world) and link it
+// in; NULL if the memory budget refused it
+LocalMap* generate_child_map(LocalMap* parent, int x, int y)
+{
+    // Built in the background while the player walked up to it?
+    LocalMap* local = parent == NULL ? local_prefetch_take(x, y) : NULL;
+    if (local == NULL)
+    {
+        // Local maps are 256x256, dungeon floors smaller
+        int width = parent == NULL ? LOCAL_MAP_WIDTH : DUNGEON_FLOOR_SIDE;
+        int height = parent == NULL ? LOCAL_MAP_HEIGHT : DUNGEON_FLOOR_SIDE;
+        local = local_map_alloc(width, height);
+        if (local == NULL)
+        {
+            show_status("Memory budget reached - cannot generate this area");
+            return NULL;
+        }
+        
+        uint32_t seed = map_child_seed(parent, x, y);
+        if (parent == NULL) {
+            local_map_build(local, 1, world_tile(x, y), seed, local_map_creature_seed(x, y));
+        } else {
+            local_map_build(local, parent->depth + 1, '>', seed, seed * 2654435761u);
         }
     }
     
-    // Set to world map
-    worldMap[worldY][worldX].localMap = local;
+    if (!map_set_child(parent, x, y, local))
+    {
+        local_map_free(local);
+        show_status("Memory budget reached - cannot generate this area");
+        return NULL;
+    }
+    
+    // Visited world tiles are drawn brighter
+    if (parent == NULL) world_tile_changed(x, y);
+    return local;
+}
+
+// Generate local map at specific world coordinates
+void generate_local_map_at(int worldX, int worldY)
+{
+    if (!world_cell(worldX, worldY).hasLocalMap) return;
+    generate_child_map(NULL, worldX, worldY);
+}
+
+// Creature seed for the local map under one world tile
+static uint32_t local_map_creature_seed(int worldX, int worldY)
+{
+    return ((uint32_t)worldY * (uint32_t)currentMapWidth + (uint32_t)worldX + 1) * 2654435761u;
+}
+
+// Stairs: mountain local maps lead down into dungeons; dungeon floors lead
+// back up from where the player arrives, and further down until the last
+static void local_map_place_stairs(LocalMap* local)
+{
+    bool dungeon = local->worldTile == '>';
+    int cx = local->width / 2;
+    int cy = local->height / 2;
+    if (dungeon) local->tiles[cy][cx] = '<';
+    if ((!dungeon && local->worldTile != '^') || local->depth + 1 >= MAP_MAX_DEPTH) return;
+    
+    // A few steps from the arrival point on mountains; anywhere dug out on
+    // a dungeon floor (all of it is reachable from the middle)
+    uint32_t rng = local->seed ^ 0x5DEECE66u;
+    for (int attempt = 0; attempt < 256; attempt++)
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        int rangeX = dungeon ? cx - 1 : 6;
+        int rangeY = dungeon ? cy - 1 : 6;
+        int x = cx + (int)(rng % (2 * rangeX + 1)) - rangeX;
+        int y = cy + (int)((rng >> 16) % (2 * rangeY + 1)) - rangeY;
+        if (x == cx && y == cy) continue;
+        if (x < 1 || y < 1 || x >= local->width - 1 || y >= local->height - 1) continue;
+        if (dungeon && local->tiles[y][x] != '.') continue;
+        local->tiles[y][x] = '>';
+        return;
+    }
+}
+
+// Generated tiles of a map, stairs included, from its terrain, seed and depth
+void local_map_generate_tiles(LocalMap* local)
+{
+    local_map_fill(local->tiles[0], local->width, local->height, local->worldTile, local->seed);
+    local_map_place_stairs(local);
+}
+
+// Fill tiles, derived bits and creatures of an allocated map at any depth
+// (fresh or pooled); only touches the map itself, so it also runs on workers
+static void local_map_build(LocalMap* local, int depth, char worldTile, uint32_t seed, uint32_t creatureSeed)
+{
+    // Same world, same maps (the world exporter and saves rely on this)
+    local->depth = depth;
+    local->worldTile = worldTile;
+    local->seed = seed;
+    local_map_generate_tiles(local);
+    
+    local_map_build_passable(local);
+    local_map_build_opaque(local);
+    local_map_build_fields(local);
+    local->stats.valid = false;
+    local->saved.valid = false;
+    bitgrid_clear(&local->explored);
+    tile_journal_reset(&local->changes, MEM_LOCAL, local->width, local->height);
+    
+    // Creatures, seeded from the world position
+    entity_store_reset(&local->entities, creatureSeed);
+    entity_populate(local, worldTile);
+}
+
+// Worker job: build one prefetched local map
+static void local_prefetch_job(void* data)
+{
+    LocalPrefetch* slot = (LocalPrefetch*)data;
+    local_map_build(slot->local, 1, slot->worldTile, slot->seed, slot->creatureSeed);
+}
+
+// Give a slot a pooled map with room for every creature it may get
+static bool local_prefetch_spare(LocalPrefetch* slot)
+{
+    if (slot->local != NULL) return true;
+    
+    // The evictor must leave a map alone while its parts are allocated
+    localPrefetchFilling = true;
+    slot->local = local_map_alloc(LOCAL_MAP_WIDTH, LOCAL_MAP_HEIGHT);
+    if (slot->local != NULL)
+    {
+        entity_store_reserve(&slot->local->entities, ENTITY_POPULATE_MAX);
+        feature_fields_reserve(&slot->local->fields, LOCAL_MAP_WIDTH, LOCAL_MAP_HEIGHT);
+        tile_journal_reset(&slot->local->changes, MEM_LOCAL, LOCAL_MAP_WIDTH, LOCAL_MAP_HEIGHT);
+    }
+    localPrefetchFilling = false;
+    return slot->local != NULL;
 }
 
-// Enter local map
-void enter_local_map(int worldX, int worldY)
+// Memory evictor for local maps: idle pooled maps are only a head start,
+// so they go until enough is free (walking refills the pool). Visited maps
+// hold state that only a save keeps, so they are never evicted.
+static void local_prefetch_evict(size_t bytesNeeded)
 {
-    if (!worldMap[worldY][worldX].hasLocalMap) return;
+    if (localPrefetchFilling) return;
     
-    // Generate if not exists
-    if (worldMap[worldY][worldX].localMap == NULL)
+    size_t before = memStats.totalLive;
+    for (int i = 0; i < LOCAL_PREFETCH_SLOTS && before - memStats.totalLive < bytesNeeded; i++)
+    {
+        LocalPrefetch* slot = &localPrefetch[i];
+        if (slot->used || slot->local == NULL) continue;
+        local_map_free(slot->local);
+        slot->local = NULL;
+    }
+}
+
+// Fill the pool up front (prefetching is optional, so refusals are fine)
+static void local_prefetch_reserve()
+{
+    for (int i = 0; i < LOCAL_PREFETCH_SLOTS; i++) local_prefetch_spare(&localPrefetch[i]);
+}
+
+// Stop using a slot once its job is done (cancelled or not); the map stays pooled
+static void local_prefetch_discard(LocalPrefetch* slot)
+{
+    job_cancel(slot->job);
+    job_wait(slot->job);
+    slot->used = false;
+    slot->job = 0;
+}
+
+// Hand over a prefetched map for a world tile (NULL if there is none)
+static LocalMap* local_prefetch_take(int worldX, int worldY)
+{
+    for (int i = 0; i < LOCAL_PREFETCH_SLOTS; i++)
+    {
+        LocalPrefetch* slot = &localPrefetch[i];
+        if (!slot->used || slot->x != worldX || slot->y != worldY) continue;
+        
+        job_wait(slot->job);
+        LocalMap* local = slot->local;
+        memset(slot, 0, sizeof(LocalPrefetch));
+        
+        // Entering a map is a transition frame: replace the pooled map now
+        local_prefetch_spare(slot);
+        return local;
+    }
+    return NULL;
+}
+
+// Generate the local maps next to the player in the background
+static void local_prefetch_around(int worldX, int worldY)
+{
+    // Drop maps the player walked away from
+    for (int i = 0; i < LOCAL_PREFETCH_SLOTS; i++)
     {
-        generate_local_map_at(worldX, worldY);
+        LocalPrefetch* slot = &localPrefetch[i];
+        if (!slot->used) continue;
+        if (abs(slot->x - worldX) + abs(slot->y - worldY) != 1) local_prefetch_discard(slot);
     }
     
-    // Switch to local map state
+    const int dx[4] = { 1, -1, 0, 0 };
+    const int dy[4] = { 0, 0, 1, -1 };
+    for (int d = 0; d < 4; d++)
+    {
+        int x = worldX + dx[d];
+        int y = worldY + dy[d];
+        if (x < 0 || y < 0 || x >= currentMapWidth || y >= currentMapHeight) continue;
+        WorldTile cell = world_cell(x, y);
+        if (!cell.hasLocalMap || cell.localMap != NULL) continue;
+        
+        LocalPrefetch* free = NULL;
+        bool queued = false;
+        for (int i = 0; i < LOCAL_PREFETCH_SLOTS; i++)
+        {
+            LocalPrefetch* slot = &localPrefetch[i];
+            if (slot->used && slot->x == x && slot->y == y) queued = true;
+            if (!slot->used && free == NULL) free = slot;
+        }
+        if (queued || free == NULL) continue;
+        
+        // Prefetching is optional, so a refusal just skips it
+        if (!local_prefetch_spare(free)) continue;
+        free->used = true;
+        free->x = x;
+        free->y = y;
+        free->worldTile = cell.worldTile;
+        free->seed = local_map_seed(x, y);
+        free->creatureSeed = local_map_creature_seed(x, y);
+        free->job = job_run(local_prefetch_job, free, JOB_LOW);
+    }
+}
+
+// Worker job: free a world that was detached by cleanup_all_maps
+static void map_release_job(void* data)
+{
+    WorldMap* world = (WorldMap*)data;
+    for (int i = 0; i < world->capacity; i++)
+    {
+        WorldChunk* chunk = world->slots[i];
+        if (chunk == NULL) continue;
+        for (int c = 0; c < WORLD_CHUNK * WORLD_CHUNK; c++)
+        {
+            if (chunk->cells[c].localMap != NULL) local_map_destroy(chunk->cells[c].localMap);
+        }
+    }
+    world_chunks_free(world);
+    mem_free(world->tiles);
+    mem_free(world);
+}
+
+// Go down into the map under (x, y) of the current map, generating it on
+// the first visit; where the player stood goes on the player stack
+void enter_local_map(int x, int y)
+{
+    LocalMap* parent = current_local_map();
+    if (playerStack.depth + 1 >= MAP_MAX_DEPTH || !map_tile_has_child(parent, x, y)) return;
+    
+    LocalMap* child = map_child(parent, x, y);
+    if (child == NULL) child = generate_child_map(parent, x, y);
+    
+    // Refused by the memory budget, stay where we are
+    if (child == NULL) return;
+    
+    // The world position stays in player, deeper ones go on the stack
+    if (playerStack.depth > 0) playerStack.levels[playerStack.depth].at = localPlayer;
+    playerStack.depth++;
+    playerStack.levels[playerStack.depth].map = child;
     isInLocalMap = true;
-    localPlayer.x = LOCAL_MAP_WIDTH / 2;
-    localPlayer.y = LOCAL_MAP_HEIGHT / 2;
+    if (child->fields.stale) local_map_build_fields(child);
+    fov_invalidate();
+    localPlayer.x = child->width / 2;
+    localPlayer.y = child->height / 2;
     
     // Adjust camera for local map
     reset_camera_to_default();
 }
 
-// Exit local map
+// Go back up one level, to where the player stood before going down
 void exit_local_map()
 {
-    isInLocalMap = false;
+    if (playerStack.depth == 0) return;
+    
+    playerStack.levels[playerStack.depth].map = NULL;
+    playerStack.depth--;
+    if (playerStack.depth > 0) localPlayer = playerStack.levels[playerStack.depth].at;
+    isInLocalMap = playerStack.depth > 0;
+    
+    // Terrain lived on while the player was below
+    LocalMap* back = current_local_map();
+    if (back != NULL && back->fields.stale) local_map_build_fields(back);
+    fov_invalidate();
     reset_camera_to_default();
 }
 
 // Free all map memory
 void cleanup_all_maps()
 {
-    if (worldMap != NULL)
+    // Living terrain reads every map
+    sim_cancel();
+    
+    for (int i = 0; i < LOCAL_PREFETCH_SLOTS; i++)
     {
-        for (int y = 0; y < currentMapHeight; y++)
-        {
-            for (int x = 0; x < currentMapWidth; x++)
-            {
-                if (worldMap[y][x].localMap != NULL)
-                {
-                    LocalMap* local = worldMap[y][x].localMap;
-                    for (int ly = 0; ly < local->height; ly++)
-                    {
-                        free(local->tiles[ly]);
-                    }
-                    free(local->tiles);
-                    free(local);
-                }
-            }
-            free(worldMap[y]);
-        }
-        free(worldMap);
-        worldMap = NULL;
+        local_prefetch_discard(&localPrefetch[i]);
+        local_map_free(localPrefetch[i].local);
+        localPrefetch[i].local = NULL;
     }
+    
+    WorldStash current;
+    world_stash(&current);
+    world_release(&current);
 }
 
-// Save game to slot
-void save_game_to_slot(int slot)
+// Detach the current world and the player's place in it, leaving no world
+void world_stash(WorldStash* stash)
 {
-    char filename[50];
-    sprintf(filename, "save_%d.dat", slot);
-    
-    FILE* file = fopen(filename, "wb");
-    if (!file) return;
-    
-    // Save world dimensions
-    fwrite(&currentMapWidth, sizeof(int), 1, file);
-    fwrite(&currentMapHeight, sizeof(int), 1, file);
-    
-    // Save player position
-    fwrite(&player.x, sizeof(int), 1, file);
-    fwrite(&player.y, sizeof(int), 1, file);
-    fwrite(&localPlayer.x, sizeof(int), 1, file);
-    fwrite(&localPlayer.y, sizeof(int), 1, file);
-    fwrite(&isInLocalMap, sizeof(bool), 1, file);
+    stash->world = worldMap;
+    stash->passable = worldPassable;
+    stash->opaque = worldOpaque;
+    stash->fields = worldFields;
+    stash->changes = worldChanges;
+    stash->width = currentMapWidth;
+    stash->height = currentMapHeight;
+    stash->seed = worldSeed;
+    stash->player = player;
+    stash->localPlayer = localPlayer;
+    stash->stack = playerStack;
+    
+    worldMap = NULL;
+    memset(&worldPassable, 0, sizeof(BitGrid));
+    memset(&worldOpaque, 0, sizeof(BitGrid));
+    memset(&worldFields, 0, sizeof(FeatureFields));
+    memset(&worldChanges, 0, sizeof(TileJournal));
+    player_stack_reset();
+}
+
+// Make a stashed world current again (there must be no world)
+void world_unstash(const WorldStash* stash)
+{
+    worldMap = stash->world;
+    worldPassable = stash->passable;
+    worldOpaque = stash->opaque;
+    worldFields = stash->fields;
+    worldChanges = stash->changes;
+    currentMapWidth = stash->width;
+    currentMapHeight = stash->height;
+    worldSeed = stash->seed;
+    player = stash->player;
+    localPlayer = stash->localPlayer;
+    playerStack = stash->stack;
+    isInLocalMap = playerStack.depth > 0;
+}
+
+// Free a stashed world; caches that may still name its maps forget them
+void world_release(WorldStash* stash)
+{
+    // Prefetched maps belong to whichever world was current; they stay pooled
+    for (int i = 0; i < LOCAL_PREFETCH_SLOTS; i++) local_prefetch_discard(&localPrefetch[i]);
     
-    // Save world map
-    for (int y = 0; y < currentMapHeight; y++)
+    if (stash->world != NULL)
     {
-        for (int x = 0; x < currentMapWidth; x++)
+        // Forget everything here, free it on a worker
+        WorldMap* release = stash->world;
+        for (int i = 0; i < release->capacity; i++)
         {
-            // Save world tile data
-            fwrite(&worldMap[y][x].worldTile, sizeof(char), 1, file);
-            fwrite(&worldMap[y][x].hasLocalMap, sizeof(bool), 1, file);
-            
-            // Save local map if exists
-            bool hasLocal = (worldMap[y][x].localMap != NULL);
-            fwrite(&hasLocal, sizeof(bool), 1, file);
-            
-            if (hasLocal)
+            const WorldChunk* chunk = release->slots[i];
+            if (chunk == NULL) continue;
+            for (int c = 0; c < WORLD_CHUNK * WORLD_CHUNK; c++)
             {
-                LocalMap* local = worldMap[y][x].localMap;
-                fwrite(&local->width, sizeof(int), 1, file);
-                fwrite(&local->height, sizeof(int), 1, file);
-                
-                for (int ly = 0; ly < local->height; ly++)
-                {
-                    fwrite(local->tiles[ly], sizeof(char), local->width, file);
-                }
+                if (chunk->cells[c].localMap != NULL) local_map_forget(chunk->cells[c].localMap);
             }
         }
+        tilemap_forget(release);
+        stash->world = NULL;
+        
+        JobId job = job_run(map_release_job, release, JOB_LOW);
+        
+        // Under a hard cap the next world needs that memory back first
+        if (memStats.budget != 0) job_wait(job);
     }
     
-    fclose(file);
+    tile_journal_free(&stash->changes);
+    bitgrid_free(&stash->passable);
+    bitgrid_free(&stash->opaque);
+    feature_fields_free(&stash->fields);
+    fov_invalidate();
+    routeStep = pathFinder.routeLength = 0;
 }
 
-// Load game from slot
-bool load_game_from_slot(int slot)
+// Step in one direction on press, then auto-repeat while held
+static bool move_key_step(int dir, int key, int altKey)
 {
-    char filename[50];
-    sprintf(filename, "save_%d.dat", slot);
-    
-    FILE* file = fopen(filename, "rb");
-    if (!file) return false;
+    if (input_key_pressed(key) || input_key_pressed(altKey)) {
+        moveRepeat[dir] = MOVE_REPEAT_DELAY;
+        return true;
+    }
     
-    // Clean up existing maps
-    cleanup_all_maps();
+    if (input_key_down(key) || input_key_down(altKey)) {
+        if (--moveRepeat[dir] <= 0) {
+            moveRepeat[dir] = MOVE_REPEAT_INTERVAL;
+            return true;
+        }
+    }
     
-    // Load world dimensions
-    fread(&currentMapWidth, sizeof(int), 1, file);
-    fread(&currentMapHeight, sizeof(int), 1, file);
+    return false;
+}
+
+// Stop following a click-to-move route
+static void cancel_route()
+{
+    routeStep = 0;
+    pathFinder.routeLength = 0;
+}
+
+// Plan a route from the player to the clicked tile over a grid whose
+// corner is at (originX, originY) of the map (the world's view, or 0, 0)
+static void click_to_move(const BitGrid* grid, int originX, int originY, int fromX, int fromY)
+{
+    Vector2 target;
+    if (!input_mouse_clicked(&target)) return;
     
-    // Load player position
-    fread(&player.x, sizeof(int), 1, file);
-    fread(&player.y, sizeof(int), 1, file);
-    fread(&localPlayer.x, sizeof(int), 1, file);
-    fread(&localPlayer.y, sizeof(int), 1, file);
-    fread(&isInLocalMap, sizeof(bool), 1, file);
+    int tileX = (int)floorf(target.x / TILE_SIZE);
+    int tileY = (int)floorf(target.y / TILE_SIZE);
     
-    // Allocate world map
-    worldMap = (WorldTile**)malloc(currentMapHeight * sizeof(WorldTile*));
-    for (int y = 0; y < currentMapHeight; y++)
-    {
-        worldMap[y] = (WorldTile*)malloc(currentMapWidth * sizeof(WorldTile));
-        
-        for (int x = 0; x < currentMapWidth; x++)
-        {
-            // Load world tile data
-            fread(&worldMap[y][x].worldTile, sizeof(char), 1, file);
-            fread(&worldMap[y][x].hasLocalMap, sizeof(bool), 1, file);
-            
-            // Load local map if exists
-            bool hasLocal;
-            fread(&hasLocal, sizeof(bool), 1, file);
-            
-            if (hasLocal)
-            {
-                LocalMap* local = (LocalMap*)malloc(sizeof(LocalMap));
-                fread(&local->width, sizeof(int), 1, file);
-                fread(&local->height, sizeof(int), 1, file);
-                
-                local->tiles = (char**)malloc(local->height * sizeof(char*));
-                for (int ly = 0; ly < local->height; ly++)
-                {
-                    local->tiles[ly] = (char*)malloc((local->width + 1) * sizeof(char));
-                    fread(local->tiles[ly], sizeof(char), local->width, file);
-                    local->tiles[ly][local->width] = '\0';
-                }
-                
-                worldMap[y][x].localMap = local;
-            }
-            else
-            {
-                worldMap[y][x].localMap = NULL;
-            }
-        }
+    cancel_route();
+    if (path_find(grid, fromX - originX, fromY - originY, tileX - originX, tileY - originY)) {
+        routeTimer = 0;
     }
+}
+
+// Take the next route step when its tick comes up
+static void follow_route(Player* walker, const BitGrid* grid, int originX, int originY)
+{
+    if (routeStep >= pathFinder.routeLength) return;
+    if (--routeTimer > 0) return;
     
-    fclose(file);
+    routeTimer = MOVE_REPEAT_INTERVAL;
+    int node = pathFinder.route[routeStep++];
+    walker->x = originX + node % grid->width;
+    walker->y = originY + node / grid->width;
+}
+
+// The world view moved from before: plan the rest of the route again in
+// the new one, so a long walk doesn't stop at the old view's edge
+static void world_route_replan(TileRect before)
+{
+    if (routeStep >= pathFinder.routeLength) return;
     
-    // Setup camera
-    init_camera();
-    currentState = STATE_PLAYING;
+    int goal = pathFinder.route[pathFinder.routeLength - 1];
+    int goalX = before.x0 + goal % (before.x1 - before.x0);
+    int goalY = before.y0 + goal / (before.x1 - before.x0);
+    const TileRect* view = &worldMap->view;
     
-    return true;
+    routeStep = 0;
+    path_find(&worldPassable, player.x - view->x0, player.y - view->y0, goalX - view->x0, goalY - view->y0);
 }
 
-// Update game logic
+// Update game logic (one fixed simulation tick)
 void gameupdate()
 {
-    if (shouldQuit) {
-        CloseWindow(); // This will break the main loop
-        return;
+    if (shouldQuit) return; // Main loop exits on this flag
+    
+    // Debug panel toggles on every screen
+    if (input_key_pressed(KEY_F3)) showDebugHud = !showDebugHud;
+    if (input_key_pressed(KEY_M)) {
+        showMinimap = !showMinimap;
+        mark_frame_dirty();
     }
     
+    // Expire the status message
+    if (statusTicks > 0 && --statusTicks == 0) mark_frame_dirty();
+    
     if (currentState == STATE_TITLE) 
     {
-        if(IsKeyPressed(KEY_F))
+        if(input_key_pressed(KEY_F))
         {
             togglefullscreen(SCREEN_WIDTH, SCREEN_HEIGHT);
         }
@@ -592,7 +1208,7 @@ void gameupdate()
     } 
     else if (currentState == STATE_MAPSIZE) 
     {
-        if(IsKeyPressed(KEY_F))
+        if(input_key_pressed(KEY_F))
         {
             togglefullscreen(SCREEN_WIDTH, SCREEN_HEIGHT);
         }
@@ -610,121 +1226,157 @@ void gameupdate()
     {
         if (isInLocalMap)
         {
-            // Inside local map
-            LocalMap* currentLocal = worldMap[player.y][player.x].localMap;
+            // Inside a local map or dungeon floor
+            LocalMap* currentLocal = current_local_map();
             
-            // Store old position
+            const BitGrid* passable = &currentLocal->passable;
             int oldX = localPlayer.x;
             int oldY = localPlayer.y;
             
             // Player movement within local map
-            if ((IsKeyPressed(KEY_RIGHT) || IsKeyPressed(KEY_D)) && 
+            if (move_key_step(0, KEY_RIGHT, KEY_D) && 
                 localPlayer.x + 1 < currentLocal->width && 
-                currentLocal->tiles[localPlayer.y][localPlayer.x + 1] != '#') localPlayer.x++;
+                bitgrid_get(passable, localPlayer.x + 1, localPlayer.y)) localPlayer.x++;
             
-            if ((IsKeyPressed(KEY_LEFT) || IsKeyPressed(KEY_A)) && 
+            if (move_key_step(1, KEY_LEFT, KEY_A) && 
                 localPlayer.x > 0 && 
-                currentLocal->tiles[localPlayer.y][localPlayer.x - 1] != '#') localPlayer.x--;
+                bitgrid_get(passable, localPlayer.x - 1, localPlayer.y)) localPlayer.x--;
             
-            if ((IsKeyPressed(KEY_UP) || IsKeyPressed(KEY_W)) && 
+            if (move_key_step(2, KEY_UP, KEY_W) && 
                 localPlayer.y > 0 && 
-                currentLocal->tiles[localPlayer.y - 1][localPlayer.x] != '#') localPlayer.y--;
+                bitgrid_get(passable, localPlayer.x, localPlayer.y - 1)) localPlayer.y--;
             
-            if ((IsKeyPressed(KEY_DOWN) || IsKeyPressed(KEY_S)) && 
+            if (move_key_step(3, KEY_DOWN, KEY_S) && 
                 localPlayer.y + 1 < currentLocal->height && 
-                currentLocal->tiles[localPlayer.y + 1][localPlayer.x] != '#') localPlayer.y++;
+                bitgrid_get(passable, localPlayer.x, localPlayer.y + 1)) localPlayer.y++;
+            
+            // Keyboard movement overrides click-to-move
+            if (oldX != localPlayer.x || oldY != localPlayer.y) cancel_route();
+            
+            click_to_move(passable, 0, 0, localPlayer.x, localPlayer.y);
+            follow_route(&localPlayer, passable, 0, 0);
+            
+            // Creatures think, then step; redraw only if one moved on screen
+            currentLocal->stateVersion++;
+            entity_update_ai(&currentLocal->entities, localPlayer.x, localPlayer.y);
+            if (entity_update_movement(&currentLocal->entities, passable, 
+                                       localPlayer.x, localPlayer.y, localVisible)) {
+                mark_frame_dirty();
+            }
             
-            // Exit local map with BACKSPACE only (not at edges)
-            if (IsKeyPressed(KEY_BACKSPACE))
+            // Down the stairs with ENTER
+            if (input_key_pressed(KEY_ENTER) && map_tile_has_child(currentLocal, localPlayer.x, localPlayer.y))
             {
-                exit_local_map();
+                cancel_route();
+                enter_local_map(localPlayer.x, localPlayer.y);
             }
             
-            // Update camera if player moved
-            if (oldX != localPlayer.x || oldY != localPlayer.y)
+            // Up one level with BACKSPACE only (not at edges)
+            else if (input_key_pressed(KEY_BACKSPACE))
             {
-                update_camera();
+                cancel_route();
+                exit_local_map();
             }
         }
         else
         {
-            // On world map
             int oldX = player.x;
             int oldY = player.y;
             
             // Player movement on world map
-            if ((IsKeyPressed(KEY_RIGHT) || IsKeyPressed(KEY_D)) && 
+            if (move_key_step(0, KEY_RIGHT, KEY_D) && 
                 player.x + 1 < currentMapWidth && 
-                worldMap[player.y][player.x + 1].worldTile != '#') player.x++;
+                world_passable(player.x + 1, player.y)) player.x++;
             
-            if ((IsKeyPressed(KEY_LEFT) || IsKeyPressed(KEY_A)) && 
+            if (move_key_step(1, KEY_LEFT, KEY_A) && 
                 player.x > 0 && 
-                worldMap[player.y][player.x - 1].worldTile != '#') player.x--;
+                world_passable(player.x - 1, player.y)) player.x--;
             
-            if ((IsKeyPressed(KEY_UP) || IsKeyPressed(KEY_W)) && 
+            if (move_key_step(2, KEY_UP, KEY_W) && 
                 player.y > 0 && 
-                worldMap[player.y - 1][player.x].worldTile != '#') player.y--;
+                world_passable(player.x, player.y - 1)) player.y--;
             
-            if ((IsKeyPressed(KEY_DOWN) || IsKeyPressed(KEY_S)) && 
+            if (move_key_step(3, KEY_DOWN, KEY_S) && 
                 player.y + 1 < currentMapHeight && 
-                worldMap[player.y + 1][player.x].worldTile != '#') player.y++;
+                world_passable(player.x, player.y + 1)) player.y++;
             
-            // Enter local map
-            if (IsKeyPressed(KEY_ENTER) && worldMap[player.y][player.x].hasLocalMap)
+            // Keyboard movement overrides click-to-move
+            if (oldX != player.x || oldY != player.y) cancel_route();
+            
+            const TileRect* view = &worldMap->view;
+            click_to_move(&worldPassable, view->x0, view->y0, player.x, player.y);
+            follow_route(&player, &worldPassable, view->x0, view->y0);
+            
+            if (oldX != player.x || oldY != player.y)
             {
-                enter_local_map(player.x, player.y);
+                // A sparse world's view follows the player, and the route with it
+                TileRect before = *view;
+                if (world_view_follow(player.x, player.y)) world_route_replan(before);
+                
+                // Have the neighbouring local maps ready before they are entered
+                local_prefetch_around(player.x, player.y);
             }
             
-            // Update camera if player moved
-            if (oldX != player.x || oldY != player.y)
+            // Enter local map
+            if (input_key_pressed(KEY_ENTER) && world_cell(player.x, player.y).hasLocalMap)
             {
-                update_camera();
+                cancel_route();
+                enter_local_map(player.x, player.y);
             }
             
             // Return to menu with BACKSPACE
-            if (IsKeyPressed(KEY_BACKSPACE))
+            if (input_key_pressed(KEY_BACKSPACE))
             {
                 currentState = STATE_TITLE;
                 selectedOption = 0;
             }
         }
         
-        // Always update camera
-        update_camera();
-        
         // Toggle fullscreen
-        if(IsKeyPressed(KEY_F))
+        if(input_key_pressed(KEY_F))
         {
             int currentWidth = GetScreenWidth();
             int currentHeight = GetScreenHeight();
             togglefullscreen(currentWidth, currentHeight);
-            update_camera();
         }
         
         // Reset camera
-        if (IsKeyPressed(KEY_R))
+        if (input_key_pressed(KEY_R))
         {
             reset_camera_to_default();
         }
-
+        
+        // Follow the player, exactly once per tick
+        update_camera();
+        
         // Save menu
-        if (IsKeyPressed(KEY_F5))
+        if (input_key_pressed(KEY_F5))
         {
             currentState = STATE_SAVE_MENU;
             saveSlotSelected = 0;
         }
         
         // Load menu
-        if (IsKeyPressed(KEY_F9))
+        if (input_key_pressed(KEY_F9))
         {
+            refresh_save_slots();
             currentState = STATE_LOAD_MENU;
             saveSlotSelected = 0;
         }
     }
+    
+    // The terrain lives on at its own pace
+    if (currentState == STATE_PLAYING) sim_update();
+    
+    // Field of view follows the player, recomputed only when they moved
+    if (currentState == STATE_PLAYING && worldMap != NULL && fov_update())
+    {
+        mark_frame_dirty();
+    }
 }
 
-// Draw game
-void gamedraw()
+// Draw game, alpha is how far we are between the last tick and the next
+void gamedraw(float alpha)
 {
     BeginDrawing();
     ClearBackground(BLACK);
@@ -747,7 +1399,8 @@ void gamedraw()
     }
     else if (currentState == STATE_PLAYING) 
     {
-        BeginMode2D(gameCamera.camera);
+        update_camera_view(alpha);
+        BeginMode2D(gameCamera.view);
         
         if (isInLocalMap)
         {
@@ -765,39 +1418,70 @@ void gamedraw()
         EndMode2D();
         
         // Draw HUD
+        minimap_draw();
         draw_hud();
     }
     
+    if (statusTicks > 0)
+    {
+        int textWidth = MeasureText(statusMessage, 20);
+        DrawText(statusMessage, GetScreenWidth() / 2 - textWidth / 2, 20, 20, ORANGE);
+    }
+    
+    if (showDebugHud) draw_memory_panel(10, 10);
+    
     EndDrawing();
+    game_frame_drawn();
+}
+
+// Remember what is on screen so idle frames can be skipped
+void game_frame_drawn()
+{
+    frameDirty = false;
+    lastDrawnState = currentState;
+    lastDrawnView = gameCamera.view;
 }
 
 // Clean up game
 void gameshutdown()
 {
     cleanup_all_maps();
-    CloseAudioDevice();
+    
+    // Pending saves and frees finish while the window is still open
+    jobs_wait_all();
+    path_shutdown();
+    feature_shutdown();
+    stats_shutdown();
+    store_shutdown();
+    sim_shutdown();
+    fov_shutdown();
+    tilemap_shutdown();
+    minimap_shutdown();
+    menu_shutdown();
+    if (!headlessMode) CloseAudioDevice();
 }
 
 // Update title screen
 void title_update()
 {
     // Menu navigation
-    if (IsKeyPressed(KEY_DOWN) || IsKeyPressed(KEY_S)) {
+    if (input_key_pressed(KEY_DOWN) || input_key_pressed(KEY_S)) {
         selectedOption = (selectedOption + 1) % 3;
     }
     
-    if (IsKeyPressed(KEY_UP) || IsKeyPressed(KEY_W)) {
+    if (input_key_pressed(KEY_UP) || input_key_pressed(KEY_W)) {
         selectedOption = (selectedOption - 1 + 3) % 3;
     }
     
     // Menu selection
-    if (IsKeyPressed(KEY_ENTER) || IsKeyPressed(KEY_SPACE)) {
+    if (input_key_pressed(KEY_ENTER) || input_key_pressed(KEY_SPACE)) {
         if (selectedOption == 0) {
             selectedOption = 0;
             currentState = STATE_MAPSIZE;
         } else if (selectedOption == 1) {
             // Only go to load menu if a save exists
-            if (save_file_exists(0) || save_file_exists(1) || save_file_exists(2)) {
+            refresh_save_slots();
+            if (any_save_loadable()) {
                 currentState = STATE_LOAD_MENU;
                 saveSlotSelected = 0;
             }
@@ -811,75 +1495,43 @@ void title_update()
 // Draw title screen
 void title_draw()
 {
-    const char* gameTitle = "BoneBound";
-    int screenWidth = GetScreenWidth();
-    int screenHeight = GetScreenHeight();
-    
-    // Draw title
-    Vector2 titleSize = MeasureTextEx(GetFontDefault(), gameTitle, 48, 2);
-    Vector2 titlePos = {
-        (float)screenWidth / 2.0f - titleSize.x / 2.0f,
-        (float)screenHeight / 4.0f
-    };
-    DrawTextEx(GetFontDefault(), gameTitle, titlePos, 48, 2, YELLOW);
-    
-    // Draw menu options
-    const char* options[] = {"NEW GAME", "LOAD GAME", "QUIT"};
-    
-    for (int i = 0; i < 3; i++) {
-        Color color = (i == selectedOption) ? YELLOW : WHITE;
-        
-        // Gray out LOAD GAME if no saves exist
-        if (i == 1 && !(save_file_exists(0) || save_file_exists(1) || save_file_exists(2))) {
-            color = GRAY;
-        }
-        
-        const char* optionText = options[i];
-        Vector2 textSize = MeasureTextEx(GetFontDefault(), optionText, 32, 1);
-        Vector2 textPos = {
-            (float)screenWidth / 2.0f - textSize.x / 2.0f,
-            (float)screenHeight / 2.0f + i * 50.0f
-        };
-        
-        // Selection arrows
-        if (i == selectedOption && !(i == 1 && color.r == GRAY.r && color.g == GRAY.g && color.b == GRAY.b)) {
-            DrawText(">", (int)textPos.x - 21, (int)textPos.y, 32, YELLOW);
-            DrawText("<", (int)(textPos.x + textSize.x + 10), (int)textPos.y, 32, YELLOW);
-        }
-        
-        DrawTextEx(GetFontDefault(), optionText, textPos, 32, 1, color);
+    // Layout only changes with the window size
+    if (menu_begin(STATE_TITLE, 0))
+    {
+        menu_title("BoneBound", 1.0f / 4.0f);
+        menu_option_style(32, 50.0f);
+        menu_option("NEW GAME");
+        menu_option("LOAD GAME");
+        menu_option("QUIT");
+        menu_instruction("Use UP/DOWN to navigate, ENTER to select");
+        menu_end();
     }
     
-    // Instructions
-    const char* instructions = "Use UP/DOWN to navigate, ENTER to select";
-    Vector2 instSize = MeasureTextEx(GetFontDefault(), instructions, 20, 1);
-    Vector2 instPos = {
-        (float)screenWidth / 2.0f - instSize.x / 2.0f,
-        (float)screenHeight - 50.0f
-    };
-    DrawTextEx(GetFontDefault(), instructions, instPos, 20, 1, LIGHTGRAY);
+    // Gray out LOAD GAME if no saves exist
+    menu_draw(selectedOption, any_save_loadable() ? 0 : 1u << 1);
 }
 
 // Update map size selection
 void mapsize_update()
 {
     // Navigation
-    if (IsKeyPressed(KEY_DOWN) || IsKeyPressed(KEY_S)) {
+    if (input_key_pressed(KEY_DOWN) || input_key_pressed(KEY_S)) {
         selectedOption = (selectedOption + 1) % NUM_SIZES;
     }
     
-    if (IsKeyPressed(KEY_UP) || IsKeyPressed(KEY_W)) {
+    if (input_key_pressed(KEY_UP) || input_key_pressed(KEY_W)) {
         selectedOption = (selectedOption - 1 + NUM_SIZES) % NUM_SIZES;
     }
     
     // Selection
-    if (IsKeyPressed(KEY_ENTER) || IsKeyPressed(KEY_SPACE)) {
-        generate_world_map(mapSizes[selectedOption].width, mapSizes[selectedOption].height);
-        currentState = STATE_PLAYING;
+    if (input_key_pressed(KEY_ENTER) || input_key_pressed(KEY_SPACE)) {
+        if (generate_world_map(mapSizes[selectedOption].width, mapSizes[selectedOption].height)) {
+            currentState = STATE_PLAYING;
+        }
     }
     
     // Back to menu
-    if (IsKeyPressed(KEY_BACKSPACE)) {
+    if (input_key_pressed(KEY_BACKSPACE)) {
         currentState = STATE_TITLE;
     }
 }
@@ -887,92 +1539,48 @@ void mapsize_update()
 // Draw map size selection
 void mapsize_draw()
 {
-    const char* Title = "Map Size";
-    int screenWidth = GetScreenWidth();
-    int screenHeight = GetScreenHeight();
-    
-    // Title
-    Vector2 titleSize = MeasureTextEx(GetFontDefault(), Title, 48, 2);
-    Vector2 titlePos = {
-        (float)screenWidth / 2.0f - titleSize.x / 2.0f,
-        (float)screenHeight / 6.0f
-    };
-    DrawTextEx(GetFontDefault(), Title, titlePos, 48, 2, YELLOW);
-    
-    // Selected map info
-    const char* infoText = TextFormat("Selected: %s (%dx%d)", 
-        mapSizes[selectedOption].name, 
-        mapSizes[selectedOption].width, 
-        mapSizes[selectedOption].height);
-    
-    Vector2 infoSize = MeasureTextEx(GetFontDefault(), infoText, 22, 1);
-    Vector2 infoPos = {
-        (float)screenWidth / 2.0f - infoSize.x / 2.0f,
-        (float)screenHeight / 3.0f
-    };
-    DrawTextEx(GetFontDefault(), infoText, infoPos, 22, 1, LIGHTGRAY);
-    
-    // Map size options
-    const char* options[] = {"TINY", "SMALL", "MEDIUM", "LARGE", "HUGE", "GIGANTIC"};
-    
-    for (int i = 0; i < NUM_SIZES; i++) {
-        Color color = (i == selectedOption) ? YELLOW : WHITE;
-        
-        char optionText[50];
-        sprintf(optionText, "%s (%dx%d)", options[i], mapSizes[i].width, mapSizes[i].height);
-        
-        Vector2 textSize = MeasureTextEx(GetFontDefault(), optionText, 28, 1);
-        Vector2 textPos = {
-            (float)screenWidth / 2.0f - textSize.x / 2.0f,
-            (float)screenHeight / 2.0f + i * 40.0f
-        };
+    // Labels are formatted once, not every frame
+    if (menu_begin(STATE_MAPSIZE, 0))
+    {
+        menu_title("Map Size", 1.0f / 6.0f);
         
-        // Selection arrows
-        if (i == selectedOption) {
-            DrawText(">", (int)textPos.x - 21, (int)textPos.y, 28, YELLOW);
-            DrawText("<", (int)(textPos.x + textSize.x + 10), (int)textPos.y, 28, YELLOW);
+        // Nine sizes only fit below the middle of the window packed tight
+        menu_option_style(22, 24.0f);
+        for (int i = 0; i < NUM_SIZES; i++)
+        {
+            int option = menu_option(TextFormat("%s (%dx%d)", 
+                mapSizes[i].name, mapSizes[i].width, mapSizes[i].height));
+            menu_detail(option, TextFormat("Selected: %s (%dx%d)", 
+                mapSizes[i].name, mapSizes[i].width, mapSizes[i].height), 1.0f / 3.0f);
         }
-        
-        DrawTextEx(GetFontDefault(), optionText, textPos, 28, 1, color);
+        menu_instruction("Use UP/DOWN to navigate, ENTER to select");
+        menu_instruction("BACKSPACE to return to menu");
+        menu_end();
     }
     
-    // Instructions
-    const char* instructions[] = {
-        "Use UP/DOWN to navigate",
-        "ENTER to select map size",
-        "BACKSPACE to return to menu"
-    };
-    
-    for (int i = 0; i < 3; i++) {
-        Vector2 instSize = MeasureTextEx(GetFontDefault(), instructions[i], 20, 1);
-        Vector2 instPos = {
-            (float)screenWidth / 2.0f - instSize.x / 2.0f,
-            (float)screenHeight - 100.0f + i * 25.0f
-        };
-        DrawTextEx(GetFontDefault(), instructions[i], instPos, 20, 1, LIGHTGRAY);
-    }
+    menu_draw(selectedOption, 0);
 }
 
 // Save menu update
 void save_menu_update()
 {
     // Navigation
-    if (IsKeyPressed(KEY_DOWN) || IsKeyPressed(KEY_S)) {
+    if (input_key_pressed(KEY_DOWN) || input_key_pressed(KEY_S)) {
         saveSlotSelected = (saveSlotSelected + 1) % 3;
     }
     
-    if (IsKeyPressed(KEY_UP) || IsKeyPressed(KEY_W)) {
+    if (input_key_pressed(KEY_UP) || input_key_pressed(KEY_W)) {
         saveSlotSelected = (saveSlotSelected - 1 + 3) % 3;
     }
     
     // Selection
-    if (IsKeyPressed(KEY_ENTER) || IsKeyPressed(KEY_SPACE)) {
+    if (input_key_pressed(KEY_ENTER) || input_key_pressed(KEY_SPACE)) {
         save_game_to_slot(saveSlotSelected);
         currentState = STATE_PLAYING;
     }
     
     // Back to game
-    if (IsKeyPressed(KEY_BACKSPACE) || IsKeyPressed(KEY_ESCAPE)) {
+    if (input_key_pressed(KEY_BACKSPACE) || input_key_pressed(KEY_ESCAPE)) {
         currentState = STATE_PLAYING;
     }
 }
@@ -980,149 +1588,80 @@ void save_menu_update()
 // Save menu draw
 void save_menu_draw()
 {
-    const char* Title = "Save Game";
-    int screenWidth = GetScreenWidth();
-    int screenHeight = GetScreenHeight();
-    
-    // Title
-    Vector2 titleSize = MeasureTextEx(GetFontDefault(), Title, 48, 2);
-    Vector2 titlePos = {
-        (float)screenWidth / 2.0f - titleSize.x / 2.0f,
-        (float)screenHeight / 6.0f
-    };
-    DrawTextEx(GetFontDefault(), Title, titlePos, 48, 2, YELLOW);
-    
-    // Save slots
-    const char* slotNames[] = {"Save Slot 1", "Save Slot 2", "Save Slot 3"};
-    
-    for (int i = 0; i < 3; i++) {
-        Color color = (i == saveSlotSelected) ? YELLOW : WHITE;
-        
-        Vector2 textSize = MeasureTextEx(GetFontDefault(), slotNames[i], 32, 1);
-        Vector2 textPos = {
-            (float)screenWidth / 2.0f - textSize.x / 2.0f,
-            (float)screenHeight / 2.0f + i * 50.0f
-        };
-        
-        // Selection arrows
-        if (i == saveSlotSelected) {
-            DrawText(">", (int)textPos.x - 21, (int)textPos.y, 32, YELLOW);
-            DrawText("<", (int)(textPos.x + textSize.x + 10), (int)textPos.y, 32, YELLOW);
-        }
-        
-        DrawTextEx(GetFontDefault(), slotNames[i], textPos, 32, 1, color);
+    if (menu_begin(STATE_SAVE_MENU, 0))
+    {
+        menu_title("Save Game", 1.0f / 6.0f);
+        menu_option_style(32, 50.0f);
+        menu_option("Save Slot 1");
+        menu_option("Save Slot 2");
+        menu_option("Save Slot 3");
+        menu_instruction("Use UP/DOWN to select save slot");
+        menu_instruction("ENTER to save");
+        menu_instruction("BACKSPACE to return to game");
+        menu_end();
     }
     
-    // Instructions
-    const char* instructions[] = {
-        "Use UP/DOWN to select save slot",
-        "ENTER to save",
-        "BACKSPACE to return to game"
-    };
-    
-    for (int i = 0; i < 3; i++) {
-        Vector2 instSize = MeasureTextEx(GetFontDefault(), instructions[i], 20, 1);
-        Vector2 instPos = {
-            (float)screenWidth / 2.0f - instSize.x / 2.0f,
-            (float)screenHeight - 100.0f + i * 25.0f
-        };
-        DrawTextEx(GetFontDefault(), instructions[i], instPos, 20, 1, LIGHTGRAY);
-    }
+    menu_draw(saveSlotSelected, 0);
 }
 
 // Load menu update
 void load_menu_update()
 {
     // Navigation
-    if (IsKeyPressed(KEY_DOWN) || IsKeyPressed(KEY_S)) {
+    if (input_key_pressed(KEY_DOWN) || input_key_pressed(KEY_S)) {
         saveSlotSelected = (saveSlotSelected + 1) % 3;
     }
     
-    if (IsKeyPressed(KEY_UP) || IsKeyPressed(KEY_W)) {
+    if (input_key_pressed(KEY_UP) || input_key_pressed(KEY_W)) {
         saveSlotSelected = (saveSlotSelected - 1 + 3) % 3;
     }
     
-    // Selection - only if save exists
-    if (IsKeyPressed(KEY_ENTER) || IsKeyPressed(KEY_SPACE)) {
-        if (save_file_exists(saveSlotSelected)) {
+    // Selection - only if save exists and passed its checksums
+    if (input_key_pressed(KEY_ENTER) || input_key_pressed(KEY_SPACE)) {
+        if (saveSlotStatus[saveSlotSelected] == SLOT_OK) {
             if (load_game_from_slot(saveSlotSelected)) {
                 currentState = STATE_PLAYING;
             }
         }
     }
     
-    // Back to game
-    if (IsKeyPressed(KEY_BACKSPACE) || IsKeyPressed(KEY_ESCAPE)) {
-        currentState = STATE_PLAYING;
+    // Back to game, or the title screen if there is no game yet
+    if (input_key_pressed(KEY_BACKSPACE) || input_key_pressed(KEY_ESCAPE)) {
+        currentState = (worldMap != NULL) ? STATE_PLAYING : STATE_TITLE;
     }
 }
 
 // Load menu draw
 void load_menu_draw()
 {
-    const char* Title = "Load Game";
-    int screenWidth = GetScreenWidth();
-    int screenHeight = GetScreenHeight();
-    
-    // Title
-    Vector2 titleSize = MeasureTextEx(GetFontDefault(), Title, 48, 2);
-    Vector2 titlePos = {
-        (float)screenWidth / 2.0f - titleSize.x / 2.0f,
-        (float)screenHeight / 6.0f
-    };
-    DrawTextEx(GetFontDefault(), Title, titlePos, 48, 2, YELLOW);
-    
-    // Load slots
-    const char* slotNames[] = {"Load Slot 1", "Load Slot 2", "Load Slot 3"};
+    // Slot status was checked when the menu opened; rebuild when it changes
+    uint32_t slotKey = 0;
+    unsigned int unusable = 0;
+    for (int i = 0; i < NUM_SAVE_SLOTS; i++)
+    {
+        slotKey |= (uint32_t)saveSlotStatus[i] << (i * 2);
+        if (saveSlotStatus[i] != SLOT_OK) unusable |= 1u << i;
+    }
     
-    for (int i = 0; i < 3; i++) {
-        Color color = (i == saveSlotSelected) ? YELLOW : WHITE;
-        
-        // Check if save file exists
-        bool exists = save_file_exists(i);
-        
-        if (!exists) color = GRAY;
-        
-        Vector2 textSize = MeasureTextEx(GetFontDefault(), slotNames[i], 32, 1);
-        Vector2 textPos = {
-            (float)screenWidth / 2.0f - textSize.x / 2.0f,
-            (float)screenHeight / 2.0f + i * 50.0f
-        };
-        
-        // Selection arrows - only if save exists
-        if (i == saveSlotSelected && exists) {
-            DrawText(">", (int)textPos.x - 21, (int)textPos.y, 32, YELLOW);
-            DrawText("<", (int)(textPos.x + textSize.x + 10), (int)textPos.y, 32, YELLOW);
-        }
-        
-        DrawTextEx(GetFontDefault(), slotNames[i], textPos, 32, 1, color);
-        
-        // Show if empty
-        if (!exists) {
-            Vector2 emptySize = MeasureTextEx(GetFontDefault(), "(Empty)", 20, 1);
-            Vector2 emptyPos = {
-                (float)screenWidth / 2.0f - emptySize.x / 2.0f,
-                textPos.y + 35.0f
-            };
-            DrawTextEx(GetFontDefault(), "(Empty)", emptyPos, 20, 1, GRAY);
+    if (menu_begin(STATE_LOAD_MENU, slotKey))
+    {
+        menu_title("Load Game", 1.0f / 6.0f);
+        menu_option_style(32, 50.0f);
+        for (int i = 0; i < NUM_SAVE_SLOTS; i++)
+        {
+            int option = menu_option(TextFormat("Load Slot %d", i + 1));
+            
+            // Show if empty or damaged
+            if (saveSlotStatus[i] == SLOT_CORRUPT) menu_note(option, "(Damaged)", RED);
+            else if (saveSlotStatus[i] == SLOT_EMPTY) menu_note(option, "(Empty)", GRAY);
         }
+        menu_instruction("Use UP/DOWN to select save slot");
+        menu_instruction("ENTER to load (if save exists)");
+        menu_instruction("BACKSPACE to return to game");
+        menu_end();
     }
     
-    // Instructions
-    const char* instructions[] = {
-        "Use UP/DOWN to select save slot",
-        "ENTER to load (if save exists)",
-        "BACKSPACE to return to game"
-    };
-    
-    for (int i = 0; i < 3; i++) {
-        Vector2 instSize = MeasureTextEx(GetFontDefault(), instructions[i], 20, 1);
-        Vector2 instPos = {
-            (float)screenWidth / 2.0f - instSize.x / 2.0f,
-            (float)screenHeight - 100.0f + i * 25.0f
-        };
-        DrawTextEx(GetFontDefault(), instructions[i], instPos, 20, 1, LIGHTGRAY);
-    }
+    menu_draw(saveSlotSelected, unusable);
 }
 
 // Draw player (on world map)
@@ -1161,25 +1700,64 @@ void draw_local_player()
         YELLOW);
 }
 
+// "12 NE" towards the nearest tile of a feature, "none" if the map has none
+const char* hud_feature_hint(const FeatureFields* fields, Feature feature, int x, int y)
+{
+    int fx, fy;
+    if (!feature_nearest(fields, feature, x, y, &fx, &fy)) return "none";
+    if (fx == x && fy == y) return "here";
+    
+    // Compass point only along axes at least half the longer offset
+    int dx = fx - x, dy = fy - y;
+    const char* ns = abs(dy) * 2 >= abs(dx) ? (dy < 0 ? "N" : "S") : "";
+    const char* ew = abs(dx) * 2 >= abs(dy) ? (dx < 0 ? "W" : "E") : "";
+    return TextFormat("%d %s%s", abs(dx) + abs(dy), ns, ew);
+}
+
 // Draw HUD
 void draw_hud()
 {
     int screenWidth = GetScreenWidth();
     int screenHeight = GetScreenHeight();
     
+    // Terrain hints from the current map's distance fields
+    const FeatureFields* fields = isInLocalMap ? &current_local_map()->fields : &worldFields;
+    int hereX = isInLocalMap ? localPlayer.x : player.x - worldMap->view.x0;
+    int hereY = isInLocalMap ? localPlayer.y : player.y - worldMap->view.y0;
+    DrawText(TextFormat("Nearest water: %s | forest: %s", 
+                        hud_feature_hint(fields, FEATURE_WATER, hereX, hereY),
+                        hud_feature_hint(fields, FEATURE_FOREST, hereX, hereY)),
+             10, screenHeight - 130, 18, LIGHTGRAY);
+    
     if (isInLocalMap)
     {
-        DrawText("Local Map - BACKSPACE: Exit to World | F5: Save | F9: Load", 10, screenHeight - 30, 18, LIGHTGRAY);
-        DrawText(TextFormat("Local Position: %d,%d | Map: %dx%d", localPlayer.x, localPlayer.y, LOCAL_MAP_WIDTH, LOCAL_MAP_HEIGHT), 
+        const LocalMap* local = current_local_map();
+        if (playerStack.depth > 1) {
+            DrawText("Dungeon - ENTER on >: Go Down | BACKSPACE: Go Up | F5: Save | F9: Load", 10, screenHeight - 30, 18, LIGHTGRAY);
+        } else {
+            DrawText("Local Map - ENTER on >: Dungeon | BACKSPACE: Exit to World | F5: Save | F9: Load", 10, screenHeight - 30, 18, LIGHTGRAY);
+        }
+        DrawText(TextFormat("Local Position: %d,%d | Map: %dx%d | Depth: %d", localPlayer.x, localPlayer.y, 
+                            local->width, local->height, playerStack.depth), 
                 10, screenHeight - 55, 18, LIGHTGRAY);
+        
+        const MapStats* stats = local_map_stats(current_local_map());
+        if (stats != NULL)
+        {
+            int tiles = local->width * local->height;
+            DrawText(TextFormat("Water %d%% | Forest %d%% | Largest lake: %d | All reachable: %s",
+                                map_stats_count(stats, '~') * 100 / tiles, map_stats_count(stats, 'T') * 100 / tiles,
+                                stats->largestLake, map_stats_connected(stats) ? "yes" : "no"),
+                     10, screenHeight - 155, 18, LIGHTGRAY);
+        }
     }
     else
     {
         DrawText("World Map - ENTER: Enter Local Area | F5: Save | F9: Load", 10, screenHeight - 30, 18, LIGHTGRAY);
-        DrawText(TextFormat("World Position: %d,%d | Tile Type: %c", player.x, player.y, worldMap[player.y][player.x].worldTile), 
+        DrawText(TextFormat("World Position: %d,%d | Tile Type: %c", player.x, player.y, world_tile(player.x, player.y)), 
                 10, screenHeight - 55, 18, LIGHTGRAY);
     }
     
-    DrawText("WASD/Arrows: Move | R: Reset Camera | Mouse Wheel: Zoom", 10, screenHeight - 80, 18, LIGHTGRAY);
-    DrawText("BACKSPACE: Menu/Exit | F: Toggle Fullscreen", 10, screenHeight - 105, 18, LIGHTGRAY);
+    DrawText("WASD/Arrows/Click: Move | R: Reset Camera | Mouse Wheel: Zoom", 10, screenHeight - 80, 18, LIGHTGRAY);
+    DrawText("BACKSPACE: Menu/Exit | F: Toggle Fullscreen | F3: Debug | M: Minimap", 10, screenHeight - 105, 18, LIGHTGRAY);
 }
\ No newline at end of file
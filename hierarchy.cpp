@@ -0,0 +1,104 @@
+#include "project.h"
+
+// Map hierarchy. The world is level 0 and any tile of any map can lead down
+// to a child map: world tiles to local maps, stairs ('>') to dungeon floors,
+// up to MAP_MAX_DEPTH levels. World cells point at their child directly
+// (storing its chunk first on a sparse world); other maps keep a small hash
+// of the tiles that have one. Finding a child,
+// going down and coming back up are constant time at any depth, and every
+// level shares the LocalMap storage, generator and save format.
+
+// Levels the player went down through
+PlayerStack playerStack;
+
+// Child table slots: keyed by tile index + 1, 0 when empty
+struct ChildKeys {
+    static bool empty(const MapChild& child) { return child.tile == 0; }
+    static uint64_t key(const MapChild& child) { return child.tile; }
+    static int home(uint64_t tile, int capacity) { return (int)(((uint32_t)tile * 2654435761u) >> 8) & (capacity - 1); }
+};
+
+// Map under tile (x, y) of parent (NULL parent = the world), if generated
+LocalMap* map_child(const LocalMap* parent, int x, int y)
+{
+    if (parent == NULL)
+    {
+        const WorldChunk* chunk = world_chunk(x, y);
+        return chunk ? chunk->cells[world_chunk_cell(x, y)].localMap : NULL;
+    }
+    
+    const MapChildren* children = &parent->children;
+    uint32_t tile = (uint32_t)(y * parent->width + x) + 1;
+    const MapChild* slot = hash_find<ChildKeys>(children->slots, children->count, children->capacity, tile);
+    return slot ? slot->map : NULL;
+}
+
+// Link a generated map under a tile (false if the table can't grow)
+bool map_set_child(LocalMap* parent, int x, int y, LocalMap* child)
+{
+    child->parent = parent;
+    child->parentX = x;
+    child->parentY = y;
+    
+    if (parent == NULL)
+    {
+        WorldChunk* chunk = world_chunk_store(x, y);
+        if (chunk == NULL) return false;
+        chunk->cells[world_chunk_cell(x, y)].localMap = child;
+        return true;
+    }
+    
+    MapChildren* children = &parent->children;
+    if (!hash_reserve<ChildKeys>(&children->slots, children->count, &children->capacity, 8, MEM_LOCAL)) return false;
+    
+    MapChild slot = { (uint32_t)(y * parent->width + x) + 1, child };
+    hash_insert<ChildKeys>(children->slots, children->capacity, slot);
+    children->count++;
+    return true;
+}
+
+// Can the player go down from this tile?
+bool map_tile_has_child(const LocalMap* parent, int x, int y)
+{
+    if (parent == NULL) return world_cell(x, y).hasLocalMap;
+    return parent->tiles[y][x] == '>' && parent->depth + 1 < MAP_MAX_DEPTH;
+}
+
+// Generator seed of the map under a tile; local maps keep the seeds they
+// always had, deeper maps derive theirs from their parent's
+uint32_t map_child_seed(const LocalMap* parent, int x, int y)
+{
+    if (parent == NULL) return local_map_seed(x, y);
+    
+    uint32_t h = parent->seed ^ ((uint32_t)y * 65537u + (uint32_t)x + 1) * 0x9E3779B9u;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h ? h : 1;
+}
+
+// Destroy every map in a table (and theirs); touches no globals
+void map_children_free(MapChildren* children)
+{
+    for (int i = 0; i < children->capacity; i++)
+    {
+        if (children->slots[i].tile != 0) local_map_destroy(children->slots[i].map);
+    }
+    mem_free(children->slots);
+    memset(children, 0, sizeof(MapChildren));
+}
+
+// Map the player is on, NULL on the world map
+LocalMap* current_local_map()
+{
+    return playerStack.levels[playerStack.depth].map;
+}
+
+// Back on the world map with nothing below it (the maps went away)
+void player_stack_reset()
+{
+    memset(&playerStack, 0, sizeof(PlayerStack));
+    isInLocalMap = false;
+}
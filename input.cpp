@@ -0,0 +1,91 @@
+#include "project.h"
+
+// Keys the game reads, one bit each in InputState
+static const int trackedKeys[] = {
+    KEY_RIGHT, KEY_LEFT, KEY_UP, KEY_DOWN,
+    KEY_D, KEY_A, KEY_W, KEY_S,
+    KEY_ENTER, KEY_SPACE, KEY_BACKSPACE, KEY_ESCAPE,
+    KEY_F, KEY_R, KEY_F5, KEY_F9,
+    KEY_F3, KEY_M
+};
+#define NUM_TRACKED_KEYS (int)(sizeof(trackedKeys) / sizeof(trackedKeys[0]))
+
+// Input latched since the last simulation tick
+InputState input;
+
+// Find bit for a tracked key (-1 if the game never reads it)
+static int input_key_bit(int key)
+{
+    for (int i = 0; i < NUM_TRACKED_KEYS; i++) {
+        if (trackedKeys[i] == key) return i;
+    }
+    return -1;
+}
+
+// Latch this frame's input so no press is lost between ticks
+void input_poll()
+{
+    unsigned int down = 0;
+    for (int i = 0; i < NUM_TRACKED_KEYS; i++)
+    {
+        if (IsKeyPressed(trackedKeys[i])) input.pressed |= 1u << i;
+        if (IsKeyDown(trackedKeys[i])) down |= 1u << i;
+    }
+    input.down = down;
+    
+    float wheel = GetMouseWheelMove();
+    input.wheel += wheel;
+    
+    if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
+        // Resolve against the view the player clicked on, so ticks never
+        // depend on render interpolation
+        input.clicked = true;
+        input.clickPos = GetScreenToWorld2D(GetMousePosition(), gameCamera.view);
+    }
+    
+    // Any input wakes the renderer from idle
+    if (input.pressed || down || wheel != 0.0f || input.clicked) mark_frame_dirty();
+}
+
+// Clear one-shot input once a tick has seen it
+void input_consume()
+{
+    input.pressed = 0;
+    input.wheel = 0.0f;
+    input.clicked = false;
+}
+
+// InputState bit for a tracked key (0 if the game never reads it)
+unsigned int input_key_mask(int key)
+{
+    int bit = input_key_bit(key);
+    return bit >= 0 ? 1u << bit : 0;
+}
+
+// Key went down since the last tick
+bool input_key_pressed(int key)
+{
+    int bit = input_key_bit(key);
+    return bit >= 0 && (input.pressed & (1u << bit));
+}
+
+// Key is currently held
+bool input_key_down(int key)
+{
+    int bit = input_key_bit(key);
+    return bit >= 0 && (input.down & (1u << bit));
+}
+
+// Mouse wheel movement since the last tick
+float input_wheel_move()
+{
+    return input.wheel;
+}
+
+// Left click since the last tick, with its world position
+bool input_mouse_clicked(Vector2* position)
+{
+    if (!input.clicked) return false;
+    if (position) *position = input.clickPos;
+    return true;
+}
@@ -0,0 +1,382 @@
+#include "project.h"
+
+#if defined(_WIN32)
+    #include <io.h>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <errno.h>
+#endif
+
+#if defined(__linux__) && !defined(IO_NO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+    #include <linux/io_uring.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <sys/uio.h>
+    #define IO_HAVE_URING 1
+#endif
+#endif
+
+// Batched file I/O for the save store. A batch is many whole reads or
+// writes whose bytes all live in one buffer; on Linux they go to the kernel
+// through an io_uring, IO_BATCH at a time. A session (io_begin to io_end)
+// sets the ring up and registers the buffer once for all its batches, so
+// the kernel doesn't map the buffer again for every request. Elsewhere, or
+// when the kernel refuses a ring, each request is a plain pread/pwrite.
+// Build with IO_NO_URING to force the plain path.
+
+// Most bytes handed to the kernel in one request
+#define IO_MAX_REQUEST (1u << 30)
+
+// Open a file for one batch, -1 on failure; writing truncates it
+int io_open(const char* path, bool write)
+{
+#if defined(_WIN32)
+    int flags = _O_BINARY | (write ? _O_WRONLY | _O_CREAT | _O_TRUNC : _O_RDONLY);
+    return _open(path, flags, _S_IREAD | _S_IWRITE);
+#else
+    int flags = O_CLOEXEC | (write ? O_WRONLY | O_CREAT | O_TRUNC : O_RDONLY);
+    int fd;
+    do fd = open(path, flags, 0644); while (fd < 0 && errno == EINTR);
+    return fd;
+#endif
+}
+
+// Close a file from io_open; false if buffered writes failed
+bool io_close(int fd)
+{
+#if defined(_WIN32)
+    return _close(fd) == 0;
+#else
+    return close(fd) == 0;
+#endif
+}
+
+// Finish a request with blocking calls, from however far it already got
+static void io_sync(IoRequest* request, size_t done)
+{
+    while (done < request->length)
+    {
+        size_t want = request->length - done;
+        if (want > IO_MAX_REQUEST) want = IO_MAX_REQUEST;
+        uint64_t offset = request->offset + done;
+#if defined(_WIN32)
+        if (_lseeki64(request->fd, (__int64)offset, SEEK_SET) < 0) break;
+        int moved = request->write ? _write(request->fd, request->data + done, (unsigned)want)
+                                   : _read(request->fd, request->data + done, (unsigned)want);
+#else
+        ssize_t moved = request->write ? pwrite(request->fd, request->data + done, want, (off_t)offset)
+                                       : pread(request->fd, request->data + done, want, (off_t)offset);
+        if (moved < 0 && errno == EINTR) continue;
+#endif
+        // Errors and end of file both leave the request short
+        if (moved <= 0) break;
+        done += (size_t)moved;
+    }
+    request->ok = done == request->length;
+}
+
+#ifdef IO_HAVE_URING
+
+// A ring mapped for one session
+typedef struct {
+    int fd;
+    unsigned entries;
+    uint8_t* sqRing;
+    uint8_t* cqRing;
+    size_t sqRingSize;
+    size_t cqRingSize;
+    struct io_uring_sqe* sqes;
+    size_t sqesSize;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    struct io_uring_cqe* cqes;
+    bool fixed;             // The session's buffer is registered
+} IoRing;
+
+static int io_uring_setup_call(unsigned entries, struct io_uring_params* params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter_call(int fd, unsigned submit, unsigned wait, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, submit, wait, flags, NULL, 0);
+}
+
+static int io_uring_register_call(int fd, unsigned opcode, const void* arg, unsigned count)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+static void io_ring_close(IoRing* ring)
+{
+    if (ring->sqes != NULL) munmap(ring->sqes, ring->sqesSize);
+    if (ring->cqRing != NULL && ring->cqRing != ring->sqRing) munmap(ring->cqRing, ring->cqRingSize);
+    if (ring->sqRing != NULL) munmap(ring->sqRing, ring->sqRingSize);
+    if (ring->fd >= 0) close(ring->fd);
+    memset(ring, 0, sizeof(IoRing));
+    ring->fd = -1;
+}
+
+// Set up a ring and map its queues; false if the kernel won't give one
+static bool io_ring_open(IoRing* ring, unsigned entries)
+{
+    memset(ring, 0, sizeof(IoRing));
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = io_uring_setup_call(entries, &params);
+    if (ring->fd < 0) return false;
+    
+    // Newer kernels map both queues' rings in one go
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && ring->cqRingSize > ring->sqRingSize) ring->sqRingSize = ring->cqRingSize;
+    
+    void* sq = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) {
+        io_ring_close(ring);
+        return false;
+    }
+    ring->sqRing = (uint8_t*)sq;
+    if (single) ring->cqRing = ring->sqRing;
+    else {
+        void* cq = mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) {
+            io_ring_close(ring);
+            return false;
+        }
+        ring->cqRing = (uint8_t*)cq;
+    }
+    
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        io_ring_close(ring);
+        return false;
+    }
+    ring->sqes = (struct io_uring_sqe*)sqes;
+    
+    ring->entries = params.sq_entries;
+    ring->sqTail = (unsigned*)(ring->sqRing + params.sq_off.tail);
+    ring->sqMask = (unsigned*)(ring->sqRing + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned*)(ring->sqRing + params.sq_off.array);
+    ring->cqHead = (unsigned*)(ring->cqRing + params.cq_off.head);
+    ring->cqTail = (unsigned*)(ring->cqRing + params.cq_off.tail);
+    ring->cqMask = (unsigned*)(ring->cqRing + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(ring->cqRing + params.cq_off.cqes);
+    return true;
+}
+
+// Does this kernel hand out rings at all? (probed once)
+static bool io_uring_supported()
+{
+    static const bool supported = [] {
+        IoRing ring;
+        if (!io_ring_open(&ring, 2)) return false;
+        io_ring_close(&ring);
+        return true;
+    }();
+    return supported;
+}
+
+// Do a request's bytes lie in the batch buffer?
+static bool io_inside(const IoRequest* request, const uint8_t* buffer, size_t size)
+{
+    return buffer != NULL && request->data >= buffer && request->data + request->length <= buffer + size;
+}
+
+// Queue the next piece of a request; fixed when the buffer is registered
+static void io_ring_queue(IoRing* ring, const IoRequest* request, int index, size_t done, bool fixed)
+{
+    unsigned tail = *ring->sqTail;
+    unsigned slot = tail & *ring->sqMask;
+    struct io_uring_sqe* sqe = &ring->sqes[slot];
+    memset(sqe, 0, sizeof(*sqe));
+    
+    size_t want = request->length - done;
+    if (want > IO_MAX_REQUEST) want = IO_MAX_REQUEST;
+    if (fixed) sqe->opcode = request->write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+    else sqe->opcode = request->write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = request->fd;
+    sqe->off = request->offset + done;
+    sqe->addr = (uint64_t)(uintptr_t)(request->data + done);
+    sqe->len = (uint32_t)want;
+    sqe->buf_index = 0;
+    sqe->user_data = (uint64_t)index;
+    
+    ring->sqArray[slot] = slot;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+}
+
+// Ring for a session: up to IO_BATCH requests in flight, and the buffer
+// pinned once, which spares the kernel mapping it per request. A refused
+// registration (memlock limit, old kernel) only costs that; NULL if no
+// ring could be had at all.
+static IoRing* io_ring_begin(uint8_t* buffer, size_t size)
+{
+    if (!io_uring_supported()) return NULL;
+    IoRing* ring = (IoRing*)mem_alloc(MEM_SAVE, sizeof(IoRing));
+    if (ring == NULL) return NULL;
+    if (!io_ring_open(ring, IO_BATCH)) {
+        mem_free(ring);
+        return NULL;
+    }
+    
+    struct iovec iov = { buffer, size };
+    ring->fixed = buffer != NULL && size > 0 && size <= IO_MAX_REQUEST &&
+                  io_uring_register_call(ring->fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0;
+    return ring;
+}
+
+static void io_ring_end(IoRing* ring)
+{
+    if (ring->fixed) io_uring_register_call(ring->fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+    io_ring_close(ring);
+    mem_free(ring);
+}
+
+// Run up to IO_BATCH requests through a session's ring. False if the
+// kernel stopped taking entries: what it had is waited for, the batch is
+// finished with plain calls and the ring must not be used again.
+static bool io_run_uring(IoRing* ring, IoRequest* requests, int count, uint8_t* buffer, size_t size)
+{
+    size_t done[IO_BATCH];
+    int retry[IO_BATCH];
+    int retries = 0;
+    int next = 0;
+    unsigned pending = 0;       // Queued in the ring, not yet taken by the kernel
+    unsigned inFlight = 0;
+    while (next < count || retries > 0 || pending > 0 || inFlight > 0)
+    {
+        // Short transfers go back in for the rest, then new requests
+        for (int i = 0; i < retries; i++, pending++)
+        {
+            IoRequest* request = &requests[retry[i]];
+            io_ring_queue(ring, request, retry[i], done[retry[i]], ring->fixed && io_inside(request, buffer, size));
+        }
+        retries = 0;
+        for (; next < count && inFlight + pending < ring->entries; next++)
+        {
+            IoRequest* request = &requests[next];
+            done[next] = 0;
+            if (request->length == 0) {
+                request->ok = true;
+                continue;
+            }
+            io_ring_queue(ring, request, next, 0, ring->fixed && io_inside(request, buffer, size));
+            pending++;
+        }
+        if (pending + inFlight == 0) continue;
+        
+        // The kernel may take only some of the queued entries; the rest
+        // stay in the ring and are offered again on the next pass. With a
+        // full completion queue it takes none until some are reaped.
+        int entered;
+        do entered = io_uring_enter_call(ring->fd, pending, 1, IORING_ENTER_GETEVENTS);
+        while (entered < 0 && errno == EINTR);
+        if (entered < 0 && (errno == EAGAIN || errno == EBUSY) && inFlight > 0)
+        {
+            do entered = io_uring_enter_call(ring->fd, 0, 1, IORING_ENTER_GETEVENTS);
+            while (entered < 0 && errno == EINTR);
+        }
+        if (entered < 0 || (entered == 0 && inFlight == 0)) break;
+        pending -= (unsigned)entered;
+        inFlight += (unsigned)entered;
+        
+        unsigned head = *ring->cqHead;
+        unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+        {
+            struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cqMask];
+            int index = (int)cqe->user_data;
+            inFlight--;
+            
+            // Errors, end of file or an opcode this kernel lacks
+            if (cqe->res <= 0) io_sync(&requests[index], done[index]);
+            else if ((done[index] += (size_t)cqe->res) >= requests[index].length) requests[index].ok = true;
+            else retry[retries++] = index;
+        }
+        __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+    }
+    if (next == count && retries == 0 && pending == 0 && inFlight == 0) return true;
+    
+    // A ring the kernel stopped taking leaves the rest to the plain path
+    if (inFlight > 0) io_uring_enter_call(ring->fd, 0, inFlight, IORING_ENTER_GETEVENTS);
+    for (int i = 0; i < count; i++)
+    {
+        if (!requests[i].ok) io_sync(&requests[i], 0);
+    }
+    return false;
+}
+
+#endif
+
+// Which path batches take
+const char* io_backend()
+{
+#ifdef IO_HAVE_URING
+    if (io_uring_supported()) return "io_uring";
+#endif
+#if defined(_WIN32)
+    return "read/write";
+#else
+    return "pread/pwrite";
+#endif
+}
+
+// Start batched I/O over one buffer (size bytes). On Linux this sets up
+// the ring and registers the buffer, once for every io_run until io_end.
+void io_begin(IoSession* session, uint8_t* buffer, size_t size)
+{
+    session->buffer = buffer;
+    session->size = size;
+    session->ring = NULL;
+#ifdef IO_HAVE_URING
+    session->ring = io_ring_begin(buffer, size);
+#endif
+}
+
+// Release the session's ring and buffer registration
+void io_end(IoSession* session)
+{
+#ifdef IO_HAVE_URING
+    if (session->ring != NULL) io_ring_end((IoRing*)session->ring);
+#endif
+    session->ring = NULL;
+}
+
+// Read or write every request, all of whose bytes sit in the session's
+// buffer; each request's ok says whether all its bytes moved, the result
+// whether all of them did
+bool io_run(IoSession* session, IoRequest* requests, int count)
+{
+    for (int i = 0; i < count; i++) requests[i].ok = false;
+    
+    int first = 0;
+#ifdef IO_HAVE_URING
+    for (; first < count && session->ring != NULL; first += IO_BATCH)
+    {
+        int n = count - first < IO_BATCH ? count - first : IO_BATCH;
+        IoRing* ring = (IoRing*)session->ring;
+        if (!io_run_uring(ring, requests + first, n, session->buffer, session->size))
+        {
+            io_ring_end(ring);
+            session->ring = NULL;
+        }
+    }
+#endif
+    for (int i = first; i < count; i++) io_sync(&requests[i], 0);
+    
+    bool ok = true;
+    for (int i = 0; i < count; i++) ok = ok && requests[i].ok;
+    return ok;
+}
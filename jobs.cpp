@@ -0,0 +1,395 @@
+#include "project.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing job system. Each worker owns one deque per priority: it
+// pushes and pops at the back, idle workers steal from the front of the
+// others. Deques are fixed rings of JOB_CAPACITY entries (no job can be
+// queued twice), so queueing never allocates. Jobs flagged for the main
+// thread go to a separate queue that the frame loop drains under a time
+// budget (anything touching raylib).
+
+#define JOB_INDEX_BITS 12
+#define JOB_INDEX_MASK ((1u << JOB_INDEX_BITS) - 1)
+
+typedef struct {
+    JobFn fn;
+    void* data;
+    JobPriority priority;
+    bool mainThread;
+    std::atomic<uint32_t> id;           // Current handle, 0 while the slot is free
+    std::atomic<int> pending;           // Unfinished dependencies, +1 until submitted
+    std::atomic<bool> cancelled;
+    std::mutex lock;                    // Guards finished and dependents
+    bool finished;
+    std::vector<JobId> dependents;      // Released when this job completes
+} Job;
+
+// Ring of job indices; head and tail only grow, wrapping by the mask
+typedef struct {
+    uint32_t slots[JOB_CAPACITY];
+    uint32_t head;          // Front (stolen from)
+    uint32_t tail;          // Back (pushed and popped by the owner)
+} JobRing;
+
+typedef struct {
+    std::mutex lock;
+    JobRing queue[NUM_JOB_PRIORITIES];
+} JobQueue;
+
+static Job jobs[JOB_CAPACITY];
+static uint32_t jobGeneration[JOB_CAPACITY];
+static std::mutex freeLock;
+static std::vector<uint32_t> freeSlots;
+
+static std::vector<std::thread> workers;
+static JobQueue* workerQueues = NULL;
+static int workerCount = 0;
+static JobQueue mainQueue;
+static std::thread::id mainThreadId;
+
+// Sleeping workers wake when something is queued
+static std::mutex wakeLock;
+static std::condition_variable wakeSignal;
+static std::atomic<int> queuedJobs(0);
+static std::atomic<int> activeJobs(0);
+static std::atomic<bool> workersQuit(false);
+static std::atomic<uint32_t> nextQueue(0);
+
+static thread_local int workerIndex = -1;
+static thread_local JobId currentJob = 0;
+
+static bool job_ring_empty(const JobRing* ring)
+{
+    return ring->head == ring->tail;
+}
+
+static void job_ring_push_back(JobRing* ring, uint32_t index)
+{
+    ring->slots[ring->tail++ & (JOB_CAPACITY - 1)] = index;
+}
+
+static uint32_t job_ring_pop_back(JobRing* ring)
+{
+    return ring->slots[--ring->tail & (JOB_CAPACITY - 1)];
+}
+
+static uint32_t job_ring_pop_front(JobRing* ring)
+{
+    return ring->slots[ring->head++ & (JOB_CAPACITY - 1)];
+}
+
+// Slot for a live handle, NULL once the job has finished
+static Job* job_slot(JobId id)
+{
+    if (id == 0) return NULL;
+    Job* job = &jobs[id & JOB_INDEX_MASK];
+    return job->id.load() == id ? job : NULL;
+}
+
+// Is the caller the thread that started the pool?
+bool job_is_main_thread()
+{
+    return std::this_thread::get_id() == mainThreadId;
+}
+
+// Queue a job whose dependencies are all done
+static void job_enqueue(Job* job)
+{
+    uint32_t index = (uint32_t)(job - jobs);
+    JobQueue* queue;
+    if (job->mainThread) queue = &mainQueue;
+    else if (workerIndex >= 0) queue = &workerQueues[workerIndex];
+    else queue = &workerQueues[nextQueue++ % workerCount];
+    
+    {
+        std::lock_guard<std::mutex> guard(queue->lock);
+        job_ring_push_back(&queue->queue[job->priority], index);
+    }
+    
+    if (!job->mainThread)
+    {
+        queuedJobs++;
+        std::lock_guard<std::mutex> guard(wakeLock);
+        wakeSignal.notify_one();
+    }
+}
+
+// Drop one hold on a job, queueing it when none are left
+static void job_release(Job* job)
+{
+    if (--job->pending == 0) job_enqueue(job);
+}
+
+// Take the most urgent job a thread may run: own work first, then steal
+static int job_take(bool includeMain)
+{
+    for (int p = 0; p < NUM_JOB_PRIORITIES; p++)
+    {
+        if (includeMain)
+        {
+            std::lock_guard<std::mutex> guard(mainQueue.lock);
+            if (!job_ring_empty(&mainQueue.queue[p])) return (int)job_ring_pop_front(&mainQueue.queue[p]);
+        }
+        
+        if (workerIndex >= 0)
+        {
+            JobQueue* own = &workerQueues[workerIndex];
+            std::lock_guard<std::mutex> guard(own->lock);
+            if (!job_ring_empty(&own->queue[p])) {
+                queuedJobs--;
+                return (int)job_ring_pop_back(&own->queue[p]);
+            }
+        }
+        
+        for (int i = 0; i < workerCount; i++)
+        {
+            if (i == workerIndex) continue;
+            JobQueue* victim = &workerQueues[i];
+            std::lock_guard<std::mutex> guard(victim->lock);
+            if (!job_ring_empty(&victim->queue[p])) {
+                queuedJobs--;
+                return (int)job_ring_pop_front(&victim->queue[p]);
+            }
+        }
+    }
+    return -1;
+}
+
+// Run a job (skipped if cancelled), then release whatever waits on it
+static void job_execute(int index)
+{
+    Job* job = &jobs[index];
+    JobId id = job->id.load();
+    
+    JobId outer = currentJob;
+    currentJob = id;
+    if (!job->cancelled.load()) job->fn(job->data);
+    currentJob = outer;
+    
+    std::vector<JobId> dependents;
+    {
+        std::lock_guard<std::mutex> guard(job->lock);
+        job->finished = true;
+        dependents.swap(job->dependents);
+    }
+    
+    // Cancelling a job cancels everything built on top of it
+    bool cancelled = job->cancelled.load();
+    for (JobId dependentId : dependents)
+    {
+        Job* dependent = job_slot(dependentId);
+        if (dependent == NULL) continue;
+        if (cancelled) dependent->cancelled = true;
+        job_release(dependent);
+    }
+    
+    // Retire the handle before the slot can be reused
+    job->id = 0;
+    {
+        std::lock_guard<std::mutex> guard(freeLock);
+        freeSlots.push_back((uint32_t)index);
+    }
+    activeJobs--;
+}
+
+static void job_worker(int index)
+{
+    workerIndex = index;
+    while (!workersQuit.load())
+    {
+        int job = job_take(false);
+        if (job >= 0) {
+            job_execute(job);
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> guard(wakeLock);
+        wakeSignal.wait(guard, [] { return queuedJobs.load() > 0 || workersQuit.load(); });
+    }
+}
+
+// Start the pool (threads <= 0: one worker per core, minus the main thread)
+void jobs_init(int threads)
+{
+    if (workerCount > 0) return;
+    
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency() - 1;
+    if (threads < 1) threads = 1;
+    
+    mainThreadId = std::this_thread::get_id();
+    freeSlots.clear();
+    for (int i = JOB_CAPACITY - 1; i >= 0; i--) freeSlots.push_back((uint32_t)i);
+    
+    workersQuit = false;
+    workerCount = threads;
+    workerQueues = new JobQueue[threads];
+    for (int i = 0; i < threads; i++) workers.emplace_back(job_worker, i);
+}
+
+// Finish outstanding work and stop the workers
+void jobs_shutdown()
+{
+    if (workerCount == 0) return;
+    
+    jobs_wait_all();
+    workersQuit = true;
+    {
+        std::lock_guard<std::mutex> guard(wakeLock);
+        wakeSignal.notify_all();
+    }
+    for (std::thread& worker : workers) worker.join();
+    workers.clear();
+    
+    delete[] workerQueues;
+    workerQueues = NULL;
+    workerCount = 0;
+}
+
+int jobs_worker_count()
+{
+    return workerCount;
+}
+
+// Make a job; it runs once submitted and its dependencies are done
+JobId job_create(JobFn fn, void* data, JobPriority priority, bool mainThread)
+{
+    uint32_t index = 0;
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> guard(freeLock);
+            if (!freeSlots.empty()) {
+                index = freeSlots.back();
+                freeSlots.pop_back();
+                break;
+            }
+        }
+        
+        // Every slot is busy: help until one frees up
+        int other = job_take(job_is_main_thread());
+        if (other >= 0) job_execute(other);
+        else std::this_thread::yield();
+    }
+    
+    Job* job = &jobs[index];
+    job->fn = fn;
+    job->data = data;
+    job->priority = priority;
+    job->mainThread = mainThread;
+    job->pending = 1;
+    job->cancelled = false;
+    job->finished = false;
+    job->dependents.clear();
+    
+    // Generation in the high bits keeps stale handles from matching
+    if (++jobGeneration[index] == (1u << (32 - JOB_INDEX_BITS))) jobGeneration[index] = 1;
+    JobId id = (jobGeneration[index] << JOB_INDEX_BITS) | index;
+    job->id = id;
+    activeJobs++;
+    return id;
+}
+
+// Hold back a created (not yet submitted) job until another finishes
+void job_depends_on(JobId job, JobId dependency)
+{
+    Job* waiting = job_slot(job);
+    Job* before = job_slot(dependency);
+    if (waiting == NULL || before == NULL) return;
+    
+    std::lock_guard<std::mutex> guard(before->lock);
+    if (before->id.load() != dependency || before->finished) return;
+    before->dependents.push_back(job);
+    waiting->pending++;
+}
+
+void job_submit(JobId job)
+{
+    Job* slot = job_slot(job);
+    if (slot) job_release(slot);
+}
+
+// Create and submit a worker job with no dependencies
+JobId job_run(JobFn fn, void* data, JobPriority priority)
+{
+    JobId job = job_create(fn, data, priority, false);
+    job_submit(job);
+    return job;
+}
+
+// Skip a job that hasn't started; running jobs can poll job_cancelled()
+void job_cancel(JobId job)
+{
+    Job* slot = job_slot(job);
+    if (slot) slot->cancelled = true;
+}
+
+// Inside a job: has it been cancelled?
+bool job_cancelled()
+{
+    Job* slot = job_slot(currentJob);
+    return slot != NULL && slot->cancelled.load();
+}
+
+bool job_finished(JobId job)
+{
+    return job_slot(job) == NULL;
+}
+
+// Block until a job finishes, running other work meanwhile. Only the main
+// thread may wait on main-thread jobs.
+void job_wait(JobId job)
+{
+    bool onMain = job_is_main_thread();
+    while (!job_finished(job))
+    {
+        int other = job_take(onMain);
+        if (other >= 0) job_execute(other);
+        else std::this_thread::yield();
+    }
+}
+
+// Block until no job is left (main thread)
+void jobs_wait_all()
+{
+    while (activeJobs.load() > 0)
+    {
+        int other = job_take(true);
+        if (other >= 0) job_execute(other);
+        else std::this_thread::yield();
+    }
+}
+
+// Any job created and not yet finished, main-thread ones included
+bool jobs_busy()
+{
+    return activeJobs.load() > 0;
+}
+
+// Run main-thread jobs until the queue is empty or the budget is spent
+void jobs_run_main(double budgetSeconds)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (;;)
+    {
+        int index = -1;
+        {
+            std::lock_guard<std::mutex> guard(mainQueue.lock);
+            for (int p = 0; p < NUM_JOB_PRIORITIES && index < 0; p++)
+            {
+                if (job_ring_empty(&mainQueue.queue[p])) continue;
+                index = (int)job_ring_pop_front(&mainQueue.queue[p]);
+            }
+        }
+        if (index < 0) return;
+        
+        job_execute(index);
+        
+        std::chrono::duration<double> spent = std::chrono::steady_clock::now() - start;
+        if (spent.count() >= budgetSeconds) return;
+    }
+}
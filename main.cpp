@@ -1,24 +1,243 @@
 #include "project.h"
 
-int main()
+// Window front end: rendering runs uncapped or at vsync
+static bool window_open()
 {
-    // Initialize window
+    if (RENDER_VSYNC) SetConfigFlags(FLAG_VSYNC_HINT);
     InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "BoneBound");
-    SetTargetFPS(60);
+    SetTargetFPS(RENDER_FPS_CAP);
+    return IsWindowReady();
+}
+
+// EndDrawing normally polls input, so idle frames do it themselves. With
+// no time limit the poll blocks until an event arrives (event waiting),
+// then goes back to polling for the frames that follow.
+static void window_idle(double seconds)
+{
+    if (seconds >= 0.0) {
+        WaitTime(seconds);
+        PollInputEvents();
+        return;
+    }
+    
+    EnableEventWaiting();
+    PollInputEvents();
+    DisableEventWaiting();
+}
+
+static const Frontend windowFrontend = {
+    "window",
+    window_open,
+    CloseWindow,
+    GetTime,
+    window_idle,
+    WindowShouldClose,
+    input_poll,
+    game_needs_redraw,
+    gamedraw
+};
+
+int main(int argc, char** argv)
+{
+    const char* recordPath = NULL;
+    const char* replayPath = NULL;
+    const char* timingsPath = NULL;
+    const char* benchPath = NULL;
+    const char* exportPath = NULL;
+    const char* serverAddress = NULL;
+    const char* connectAddress = NULL;
+    int worldSize = SIZE_GIGANTIC;
+    int workerThreads = 0;
+    int runTicks = 0;
+    const Frontend* frontend = &windowFrontend;
+    sessionSeed = (uint32_t)time(NULL);
+    
+    // Command line options
+    for (int i = 1; i < argc; i++)
+    {
+        // Hard memory cap in megabytes
+        if (strcmp(argv[i], "--mem-cap") == 0 && i + 1 < argc) {
+            mem_set_budget((size_t)atol(argv[++i]) * 1024 * 1024);
+        }
+        // Fixed world seed
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            sessionSeed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        // Record every tick's input to a file
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        }
+        // Play a recording back instead of reading the keyboard
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        }
+        // Play in this terminal instead of a window
+        else if (strcmp(argv[i], "--terminal") == 0) {
+            frontend = &terminalFrontend;
+        }
+        // Replay without a window (simulation only)
+        else if (strcmp(argv[i], "--headless") == 0) {
+            headlessMode = true;
+        }
+        // Report heap allocations made by steady-state frames
+        else if (strcmp(argv[i], "--alloc-check") == 0) {
+            allocCheck = true;
+        }
+        // Draw maps tile by tile instead of with the tilemap shader
+        else if (strcmp(argv[i], "--cpu-tiles") == 0) {
+            gpuTilemapEnabled = false;
+        }
+        // Per-frame replay timings as CSV
+        else if (strcmp(argv[i], "--timings") == 0 && i + 1 < argc) {
+            timingsPath = argv[++i];
+        }
+        // Write the standard benchmark recording and exit
+        else if (strcmp(argv[i], "--write-bench") == 0 && i + 1 < argc) {
+            benchPath = argv[++i];
+        }
+        // Export a freshly generated world as a Deep Zoom pyramid and exit
+        else if (strcmp(argv[i], "--export-world") == 0 && i + 1 < argc) {
+            exportPath = argv[++i];
+        }
+        // World size for --export-world and --server (TINY ... ENDLESS)
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            i++;
+            for (int s = 0; s < NUM_SIZES; s++) {
+                if (strcmp(argv[i], mapSizes[s].name) == 0) worldSize = s;
+            }
+        }
+        // Worker threads for --export-world and background jobs (default:
+        // one per core besides the main thread)
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            workerThreads = atoi(argv[++i]);
+        }
+        // Serve a world to clients on a TCP port ("7777", "host:7777") or Unix socket path
+        else if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+            serverAddress = argv[++i];
+        }
+        // Join a server as a test bot and check the streamed world
+        else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) {
+            connectAddress = argv[++i];
+        }
+        // Ticks --server (0 = until interrupted) or --connect runs for
+        else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+            runTicks = atoi(argv[++i]);
+        }
+    }
+    
+    // Worker pool for background generation, saves and frees
+    jobs_init(workerThreads);
+    
+    if (exportPath) {
+        headlessMode = true;
+        if (!generate_world_map(mapSizes[worldSize].width, mapSizes[worldSize].height)) {
+            fprintf(stderr, "Can't generate a %s world\n", mapSizes[worldSize].name);
+            jobs_shutdown();
+            return 1;
+        }
+        bool exported = export_world_pyramid(exportPath);
+        if (!exported) fprintf(stderr, "Can't export the world to %s\n", exportPath);
+        cleanup_all_maps();
+        jobs_shutdown();
+        return exported ? 0 : 1;
+    }
+    
+    if (benchPath) {
+        bool written = replay_write_benchmark(benchPath, sessionSeed);
+        jobs_shutdown();
+        if (!written) {
+            fprintf(stderr, "Can't write %s\n", benchPath);
+            return 1;
+        }
+        return 0;
+    }
+    
+    if (serverAddress || connectAddress) {
+        int status = serverAddress ? run_server(serverAddress, worldSize, runTicks)
+                                   : run_bot_client(connectAddress, runTicks > 0 ? runTicks : TICK_RATE * 10);
+        jobs_shutdown();
+        return status;
+    }
+    
+    if (replayPath) {
+        int status = run_replay(replayPath, timingsPath);
+        jobs_shutdown();
+        return status;
+    }
+    
+    if (recordPath && !replay_record_open(recordPath, sessionSeed)) {
+        fprintf(stderr, "Can't record to %s\n", recordPath);
+        jobs_shutdown();
+        return 1;
+    }
+    
+    if (!frontend->open()) {
+        fprintf(stderr, "Can't open the %s\n", frontend->name);
+        replay_record_close();
+        jobs_shutdown();
+        return 1;
+    }
     
     // Initialize game
     gamestartup();
     
+    // Fixed-timestep clock
+    double previousTime = frontend->now();
+    double accumulator = 0.0;
+    int frameCount = 0;
+    
     // Main game loop
-    while (!WindowShouldClose())
+    while (!frontend->shouldClose() && !shouldQuit)
     {
-        gameupdate();
-        gamedraw();
+        const void* frameMap = game_frame_map();
+        if (allocCheck) mem_watch_begin();
+        
+        double now = frontend->now();
+        double frameTime = now - previousTime;
+        previousTime = now;
+        if (frameTime > MAX_FRAME_TIME) frameTime = MAX_FRAME_TIME;
+        accumulator += frameTime;
+        
+        // Latch input, then run as many simulation ticks as time allows
+        frontend->poll();
+        while (accumulator >= TICK_DT)
+        {
+            replay_record_tick(&input);
+            gameupdate();
+            input_consume();
+            accumulator -= TICK_DT;
+        }
+        
+        // Finish background work that has to run here (a slice per frame)
+        jobs_run_main(JOB_MAIN_BUDGET);
+        
+        // Render between the last two ticks, or idle when nothing changed
+        float alpha = (float)(accumulator / TICK_DT);
+        if (frontend->needsRedraw(alpha))
+        {
+            frontend->draw(alpha);
+        }
+        else
+        {
+            // Nothing to draw: sleep until input, waking at a low rate only
+            // while something runs on its own
+            frontend->idle(game_has_background_work() ? 1.0 / IDLE_POLL_RATE : -1.0);
+        }
+        
+        // Steady-state frames should not touch the heap
+        if (allocCheck)
+        {
+            int seen = mem_watch_end();
+            if (game_frame_steady(frameMap) && seen > 0) mem_watch_report(stderr, frameCount);
+        }
+        frameCount++;
     }
     
     // Cleanup
+    replay_record_close();
     gameshutdown();
-    CloseWindow();
+    frontend->close();
+    jobs_shutdown();
     
     return 0;
-}
\ No newline at end of file
+}
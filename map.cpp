@@ -1,5 +1,8 @@
 #include "project.h"
 
+// Local map tiles drawn last frame, used to cull creatures
+TileRect localVisible = { 0, 0, 0, 0 };
+
 // Get color for each tile type
 Color get_tile_color(char tile)
 {
@@ -10,10 +13,32 @@ Color get_tile_color(char tile)
     case '~': return BLUE;      // Water
     case '^': return BROWN;     // Mountain
     case 'T': return GREEN;     // Tree
+    case '>': return GOLD;      // Stairs down
+    case '<': return GOLD;      // Stairs up
     default: return RAYWHITE;   // Unknown
     }
 }
 
+// Colour of a world tile, with tiles that have local maps highlighted
+Color world_tile_color(int x, int y)
+{
+    WorldTile cell = world_cell(x, y);
+    Color tile_color = get_tile_color(cell.worldTile);
+    if (!cell.hasLocalMap) return tile_color;
+    
+    if (cell.localMap != NULL) {
+        // Brighten visited tiles
+        tile_color.r = (tile_color.r + 30 > 255) ? 255 : tile_color.r + 30;
+        tile_color.g = (tile_color.g + 30 > 255) ? 255 : tile_color.g + 30;
+    } else {
+        // Darken unvisited tiles
+        tile_color.r = (tile_color.r - 20 < 0) ? 0 : tile_color.r - 20;
+        tile_color.g = (tile_color.g - 20 < 0) ? 0 : tile_color.g - 20;
+        tile_color.b = (tile_color.b - 20 < 0) ? 0 : tile_color.b - 20;
+    }
+    return tile_color;
+}
+
 // Draw the world map
 void draw_world_map()
 {
@@ -23,12 +48,12 @@ void draw_world_map()
     int screenHeight = GetScreenHeight();
     
     // Calculate visible area
-    float visibleWidth = screenWidth / gameCamera.camera.zoom;
-    float visibleHeight = screenHeight / gameCamera.camera.zoom;
+    float visibleWidth = screenWidth / gameCamera.view.zoom;
+    float visibleHeight = screenHeight / gameCamera.view.zoom;
     
     Vector2 cameraWorldTopLeft = {
-        gameCamera.camera.target.x - visibleWidth / 2.0f,
-        gameCamera.camera.target.y - visibleHeight / 2.0f
+        gameCamera.view.target.x - visibleWidth / 2.0f,
+        gameCamera.view.target.y - visibleHeight / 2.0f
     };
     
     float mapWidthWorld = currentMapWidth * TILE_SIZE;
@@ -50,35 +75,40 @@ void draw_world_map()
     if (endX > currentMapWidth) endX = currentMapWidth;
     if (endY > currentMapHeight) endY = currentMapHeight;
     
-    // Draw visible tiles
+    // Larger text for small maps
+    int fontSize = (currentMapWidth <= 8 && currentMapHeight <= 8) ? 28 : 24;
+    
+    // One shaded quad when the GPU path is available and the view (what
+    // its texture holds) covers the screen
+    const TileRect* view = &worldMap->view;
+    bool inView = startX >= view->x0 && startY >= view->y0 && endX <= view->x1 && endY <= view->y1;
+    if (inView && tilemap_draw_world((TileRect){ startX - view->x0, startY - view->y0,
+                                                 endX - view->x0, endY - view->y0 }, fontSize)) return;
+    
+    // Field of view only applies when it was computed for this map (it
+    // covers the view)
+    bool haveFov = fovVisible.width == view->x1 - view->x0 && fovVisible.height == view->y1 - view->y0;
+    
+    // Draw visible tiles one by one
     for(int y = startY; y < endY; y++)
     {
         for(int x = startX; x < endX; x++)
         {
-            char tile = worldMap[y][x].worldTile;
-            Color tile_color = get_tile_color(tile);
+            // Fog of war: never-seen tiles stay black
+            if (!world_explored(x, y)) continue;
             
-            // Highlight tiles that have local maps
-            if (worldMap[y][x].hasLocalMap) {
-                if (worldMap[y][x].localMap != NULL) {
-                    // Brighten visited tiles
-                    tile_color.r = (tile_color.r + 30 > 255) ? 255 : tile_color.r + 30;
-                    tile_color.g = (tile_color.g + 30 > 255) ? 255 : tile_color.g + 30;
-                } else {
-                    // Darken unvisited tiles
-                    tile_color.r = (tile_color.r - 20 < 0) ? 0 : tile_color.r - 20;
-                    tile_color.g = (tile_color.g - 20 < 0) ? 0 : tile_color.g - 20;
-                    tile_color.b = (tile_color.b - 20 < 0) ? 0 : tile_color.b - 20;
-                }
-            }
+            char tile = world_tile(x, y);
+            Color tile_color = world_tile_color(x, y);
             
             Vector2 pos = { 
                 (float)(x * TILE_SIZE + 8), 
                 (float)(y * TILE_SIZE + 6) 
             };
             
-            // Larger text for small maps
-            int fontSize = (currentMapWidth <= 8 && currentMapHeight <= 8) ? 28 : 24;
+            // Remembered but out of sight
+            if (!haveFov || !world_view_contains(x, y) || !bitgrid_get(&fovVisible, x - view->x0, y - view->y0)) {
+                tile_color = Fade(tile_color, 0.4f);
+            }
             
             DrawTextEx(
                 GetFontDefault(),
@@ -94,24 +124,21 @@ void draw_world_map()
 // Draw local map
 void draw_local_map()
 {
-    if (!worldMap || player.y < 0 || player.y >= currentMapHeight || 
-        player.x < 0 || player.x >= currentMapWidth) return;
-        
-    WorldTile* currentTile = &worldMap[player.y][player.x];
-    if (currentTile->localMap == NULL) return;
+    if (!worldMap) return;
     
-    LocalMap* local = currentTile->localMap;
+    LocalMap* local = current_local_map();
+    if (local == NULL) return;
     
     int screenWidth = GetScreenWidth();
     int screenHeight = GetScreenHeight();
     
     // Calculate visible area
-    float visibleWidth = screenWidth / gameCamera.camera.zoom;
-    float visibleHeight = screenHeight / gameCamera.camera.zoom;
+    float visibleWidth = screenWidth / gameCamera.view.zoom;
+    float visibleHeight = screenHeight / gameCamera.view.zoom;
     
     Vector2 cameraWorldTopLeft = {
-        gameCamera.camera.target.x - visibleWidth / 2.0f,
-        gameCamera.camera.target.y - visibleHeight / 2.0f
+        gameCamera.view.target.x - visibleWidth / 2.0f,
+        gameCamera.view.target.y - visibleHeight / 2.0f
     };
     
     // Draw black background for visible area
@@ -130,28 +157,48 @@ void draw_local_map()
     if (endX > local->width) endX = local->width;
     if (endY > local->height) endY = local->height;
     
-    // Draw visible tiles
-    for(int y = startY; y < endY; y++)
+    localVisible = (TileRect){ startX, startY, endX, endY };
+    
+    // Field of view only applies when it was computed for this map
+    bool haveFov = fovVisible.width == local->width && fovVisible.height == local->height;
+    
+    // One shaded quad when the GPU path is available, else tile by tile
+    if (!tilemap_draw_local(local, localVisible))
     {
-        for(int x = startX; x < endX; x++)
+        // Draw visible tiles one by one
+        for(int y = startY; y < endY; y++)
         {
-            char tile = local->tiles[y][x];
-            Color tile_color = get_tile_color(tile);
-            
-            Vector2 pos = { 
-                (float)(x * TILE_SIZE + 8), 
-                (float)(y * TILE_SIZE + 6) 
-            };
-            
-            int fontSize = 24;
-            
-            DrawTextEx(
-                GetFontDefault(),
-                TextFormat("%c", tile),
-                pos,
-                fontSize,
-                1,
-                tile_color);
+            for(int x = startX; x < endX; x++)
+            {
+                // Fog of war: never-seen tiles stay black
+                if (!bitgrid_get(&local->explored, x, y)) continue;
+                
+                char tile = local->tiles[y][x];
+                Color tile_color = get_tile_color(tile);
+                
+                // Remembered but out of sight
+                if (!haveFov || !bitgrid_get(&fovVisible, x, y)) {
+                    tile_color = Fade(tile_color, 0.4f);
+                }
+                
+                Vector2 pos = { 
+                    (float)(x * TILE_SIZE + 8), 
+                    (float)(y * TILE_SIZE + 6) 
+                };
+                
+                int fontSize = 24;
+                
+                DrawTextEx(
+                    GetFontDefault(),
+                    TextFormat("%c", tile),
+                    pos,
+                    fontSize,
+                    1,
+                    tile_color);
+            }
         }
     }
-}
\ No newline at end of file
+    
+    // Creatures on top of the visible tiles
+    draw_entities(&local->entities, localVisible, haveFov ? &fovVisible : NULL);
+}
@@ -0,0 +1,346 @@
+#include "project.h"
+#include <new>
+#if defined(__GLIBC__)
+#include <execinfo.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define MEM_CALLER() _ReturnAddress()
+#else
+#define MEM_CALLER() __builtin_return_address(0)
+#endif
+
+// Bookkeeping stored in front of every tracked block (keeps 16-byte alignment)
+typedef struct {
+    size_t size;
+    uint32_t tag;
+    uint32_t magic;
+} MemHeader;
+
+#define MEM_MAGIC 0xB0E5B0E5u
+
+// Per-subsystem accounting and the session budget
+MemStats memStats;
+
+static const char* memTagNames[NUM_MEM_TAGS] = {
+    "World grid",
+    "Local maps",
+    "Save buffers",
+    "Render caches",
+    "Pathfinding",
+    "Creatures",
+    "Field of view",
+    "Network",
+    "Distance fields",
+    "Map statistics",
+    "Living terrain",
+    "World export",
+    "Replay timings"
+};
+
+// Handlers that can free memory of their tag when the budget runs out; they
+// free main-thread state, so only main-thread allocations call them
+static MemEvictFn memEvictors[NUM_MEM_TAGS];
+
+// Allocation watch: while it is on, every tracked block and every operator
+// new is counted, and the first MEM_WATCH_LOG are kept with their caller.
+// Raw malloc is not seen (raylib's own buffers included), which is why game
+// code allocates through mem_*. Noting one must not allocate, so the log is
+// fixed.
+typedef struct {
+    size_t size;
+    const char* source;     // Tag name or "operator new"
+    void* caller;           // Return address into whoever allocated
+} MemWatchEntry;
+
+static int memWatching = 0;
+static int memWatchSeen = 0;
+static MemWatchEntry memWatchLog[MEM_WATCH_LOG];
+
+// Count one allocation if the watch is on (any thread)
+static void mem_watch_note(size_t size, const char* source, void* caller)
+{
+    if (!__atomic_load_n(&memWatching, __ATOMIC_RELAXED)) return;
+    
+    int index = __atomic_fetch_add(&memWatchSeen, 1, __ATOMIC_RELAXED);
+    if (index >= MEM_WATCH_LOG) return;
+    memWatchLog[index].size = size;
+    memWatchLog[index].source = source;
+    memWatchLog[index].caller = caller;
+}
+
+// Start counting allocations (a steady-state frame is about to run)
+void mem_watch_begin()
+{
+    __atomic_store_n(&memWatchSeen, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&memWatching, 1, __ATOMIC_RELEASE);
+}
+
+// Stop counting; returns how many allocations were made since the start
+int mem_watch_end()
+{
+    __atomic_store_n(&memWatching, 0, __ATOMIC_RELEASE);
+    return __atomic_load_n(&memWatchSeen, __ATOMIC_ACQUIRE);
+}
+
+// Print where the allocations of the last watch came from
+void mem_watch_report(FILE* out, int frame)
+{
+    int seen = __atomic_load_n(&memWatchSeen, __ATOMIC_ACQUIRE);
+    fprintf(out, "alloc-check: frame %d made %d allocation%s\n", frame, seen, seen == 1 ? "" : "s");
+    
+    int logged = seen < MEM_WATCH_LOG ? seen : MEM_WATCH_LOG;
+    for (int i = 0; i < logged; i++)
+    {
+        fprintf(out, "  %zu bytes (%s) from %p", memWatchLog[i].size, memWatchLog[i].source,
+                memWatchLog[i].caller);
+#if defined(__GLIBC__)
+        // Symbol (with -rdynamic) or module+offset for addr2line
+        fprintf(out, ": ");
+        fflush(out);
+        backtrace_symbols_fd(&memWatchLog[i].caller, 1, fileno(out));
+#else
+        fprintf(out, "\n");
+#endif
+    }
+}
+
+// Name shown in the debug panel
+const char* mem_tag_name(MemTag tag)
+{
+    return memTagNames[tag];
+}
+
+// Set the hard cap in bytes (0 = unlimited)
+void mem_set_budget(size_t bytes)
+{
+    memStats.budget = bytes;
+}
+
+// Register a handler that can release memory of one tag on demand
+void mem_set_evictor(MemTag tag, MemEvictFn evict)
+{
+    memEvictors[tag] = evict;
+}
+
+// Counters are shared with worker threads, so every update is atomic
+static void mem_raise_peak(size_t* peak, size_t value)
+{
+    size_t seen = __atomic_load_n(peak, __ATOMIC_RELAXED);
+    while (value > seen &&
+           !__atomic_compare_exchange_n(peak, &seen, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+// Claim bytes against the total, false if that would break the budget
+static bool mem_try_claim(size_t size)
+{
+    size_t total = __atomic_add_fetch(&memStats.totalLive, size, __ATOMIC_RELAXED);
+    if (memStats.budget == 0 || total <= memStats.budget) {
+        mem_raise_peak(&memStats.totalPeak, total);
+        return true;
+    }
+    __atomic_sub_fetch(&memStats.totalLive, size, __ATOMIC_RELAXED);
+    return false;
+}
+
+// Make room under the budget, evicting caches if needed
+static bool mem_reserve(MemTag tag, size_t size)
+{
+    if (mem_try_claim(size)) return true;
+    
+    for (int i = 0; i < NUM_MEM_TAGS && job_is_main_thread(); i++)
+    {
+        // Never evict the subsystem that is asking
+        if (i == (int)tag || memEvictors[i] == NULL) continue;
+        size_t live = __atomic_load_n(&memStats.totalLive, __ATOMIC_RELAXED);
+        if (live + size <= memStats.budget) break;
+        memEvictors[i](live + size - memStats.budget);
+    }
+    
+    if (mem_try_claim(size)) return true;
+    __atomic_add_fetch(&memStats.refused, 1, __ATOMIC_RELAXED);
+    return false;
+}
+
+// Give back bytes claimed by mem_reserve
+static void mem_release(size_t size)
+{
+    __atomic_sub_fetch(&memStats.totalLive, size, __ATOMIC_RELAXED);
+}
+
+static void mem_account(MemTag tag, size_t size)
+{
+    size_t live = __atomic_add_fetch(&memStats.live[tag], size, __ATOMIC_RELAXED);
+    mem_raise_peak(&memStats.peak[tag], live);
+}
+
+static void mem_unaccount(MemTag tag, size_t size)
+{
+    __atomic_sub_fetch(&memStats.live[tag], size, __ATOMIC_RELAXED);
+    mem_release(size);
+}
+
+// Allocate a tracked block, NULL if it would break the budget
+static void* mem_alloc_block(MemTag tag, size_t size)
+{
+    if (!mem_reserve(tag, size)) return NULL;
+    
+    MemHeader* header = (MemHeader*)malloc(sizeof(MemHeader) + size);
+    if (header == NULL) {
+        mem_release(size);
+        __atomic_add_fetch(&memStats.refused, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    
+    header->size = size;
+    header->tag = tag;
+    header->magic = MEM_MAGIC;
+    mem_account(tag, size);
+    return header + 1;
+}
+
+// Allocate a tracked block (counted by the allocation watch)
+void* mem_alloc(MemTag tag, size_t size)
+{
+    mem_watch_note(size, memTagNames[tag], MEM_CALLER());
+    return mem_alloc_block(tag, size);
+}
+
+// Allocate a zeroed tracked block
+void* mem_calloc(MemTag tag, size_t count, size_t size)
+{
+    mem_watch_note(count * size, memTagNames[tag], MEM_CALLER());
+    void* ptr = mem_alloc_block(tag, count * size);
+    if (ptr) memset(ptr, 0, count * size);
+    return ptr;
+}
+
+// Resize a tracked block, leaving it untouched on failure
+void* mem_realloc(MemTag tag, void* ptr, size_t size)
+{
+    if (ptr == NULL) {
+        mem_watch_note(size, memTagNames[tag], MEM_CALLER());
+        return mem_alloc_block(tag, size);
+    }
+    
+    MemHeader* header = (MemHeader*)ptr - 1;
+    size_t oldSize = header->size;
+    size_t growth = size > oldSize ? size - oldSize : 0;
+    if (growth > 0) mem_watch_note(size, memTagNames[tag], MEM_CALLER());
+    if (growth > 0 && !mem_reserve(tag, growth)) return NULL;
+    
+    MemHeader* resized = (MemHeader*)realloc(header, sizeof(MemHeader) + size);
+    if (resized == NULL) {
+        mem_release(growth);
+        __atomic_add_fetch(&memStats.refused, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    
+    // Growth was already claimed against the total
+    __atomic_sub_fetch(&memStats.live[resized->tag], oldSize, __ATOMIC_RELAXED);
+    if (growth == 0) mem_release(oldSize - size);
+    resized->size = size;
+    mem_account((MemTag)resized->tag, size);
+    return resized + 1;
+}
+
+// Free a tracked block (NULL is fine)
+void mem_free(void* ptr)
+{
+    if (ptr == NULL) return;
+    
+    MemHeader* header = (MemHeader*)ptr - 1;
+    if (header->magic != MEM_MAGIC) {
+        TraceLog(LOG_WARNING, "mem_free: block %p was not from mem_alloc", ptr);
+        return;
+    }
+    
+    header->magic = 0;
+    mem_unaccount((MemTag)header->tag, header->size);
+    free(header);
+}
+
+// Format a byte count for the HUD
+static const char* mem_format(size_t bytes)
+{
+    if (bytes >= 1024 * 1024) return TextFormat("%.1f MB", bytes / (1024.0 * 1024.0));
+    if (bytes >= 1024) return TextFormat("%.1f KB", bytes / 1024.0);
+    return TextFormat("%d B", (int)bytes);
+}
+
+// Debug panel with live and peak bytes per subsystem
+void draw_memory_panel(int x, int y)
+{
+    int lineHeight = 18;
+    int width = 330;
+    int height = (NUM_MEM_TAGS + 4) * lineHeight + 10;
+    
+    DrawRectangle(x, y, width, height, Fade(BLACK, 0.75f));
+    DrawRectangleLines(x, y, width, height, DARKGRAY);
+    
+    int textY = y + 5;
+    DrawText("Memory           live        peak", x + 8, textY, 16, YELLOW);
+    textY += lineHeight;
+    
+    for (int i = 0; i < NUM_MEM_TAGS; i++)
+    {
+        DrawText(memTagNames[i], x + 8, textY, 16, LIGHTGRAY);
+        DrawText(mem_format(memStats.live[i]), x + 140, textY, 16, LIGHTGRAY);
+        DrawText(mem_format(memStats.peak[i]), x + 240, textY, 16, LIGHTGRAY);
+        textY += lineHeight;
+    }
+    
+    DrawText("Total", x + 8, textY, 16, WHITE);
+    DrawText(mem_format(memStats.totalLive), x + 140, textY, 16, WHITE);
+    DrawText(mem_format(memStats.totalPeak), x + 240, textY, 16, WHITE);
+    textY += lineHeight;
+    
+    if (memStats.budget > 0) {
+        DrawText(TextFormat("Budget %s", mem_format(memStats.budget)), x + 8, textY, 16, 
+                 memStats.totalLive * 10 > memStats.budget * 9 ? ORANGE : LIGHTGRAY);
+    } else {
+        DrawText("Budget unlimited", x + 8, textY, 16, LIGHTGRAY);
+    }
+    textY += lineHeight;
+    
+    DrawText(TextFormat("Refused allocations: %d", memStats.refused), x + 8, textY, 16, 
+             memStats.refused ? RED : LIGHTGRAY);
+}
+
+// Untracked C++ allocations (std containers, threads) go through here so
+// the allocation watch sees them too
+void* operator new(size_t size)
+{
+    mem_watch_note(size, "operator new", MEM_CALLER());
+    void* ptr = malloc(size ? size : 1);
+    if (ptr == NULL) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    mem_watch_note(size, "operator new", MEM_CALLER());
+    void* ptr = malloc(size ? size : 1);
+    if (ptr == NULL) throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
@@ -0,0 +1,198 @@
+#include "project.h"
+
+// Corner minimap: one texel per tile, coloured like the tile itself. The
+// texture is built once per map; afterwards only the texels of changed or
+// newly explored tiles are re-uploaded, so a frame costs one textured quad.
+
+// One map's minimap texture
+typedef struct {
+    Texture2D texture;
+    const void* owner;      // worldMap or a LocalMap, NULL when empty
+    int width;              // Texels the layer was built for
+    int height;
+    TileRect dirty;         // Texels to rebuild before the next draw
+    uint64_t version;       // Map edits already uploaded
+} MinimapLayer;
+
+bool showMinimap = true;
+
+static MinimapLayer worldMinimap;
+static MinimapLayer localMinimap;
+
+// Upload staging, grown to the largest rect rebuilt
+static Color* minimapBuffer = NULL;
+static size_t minimapCapacity = 0;
+
+static TileRect minimap_union(TileRect a, TileRect b)
+{
+    if (a.x0 >= a.x1 || a.y0 >= a.y1) return b;
+    if (b.x0 >= b.x1 || b.y0 >= b.y1) return a;
+    TileRect r = {
+        a.x0 < b.x0 ? a.x0 : b.x0, a.y0 < b.y0 ? a.y0 : b.y0,
+        a.x1 > b.x1 ? a.x1 : b.x1, a.y1 > b.y1 ? a.y1 : b.y1
+    };
+    return r;
+}
+
+// Edited chunk since the last upload: rebuild its texels
+static void minimap_chunk_edited(TileRect rect, const uint64_t*, void* user)
+{
+    MinimapLayer* layer = (MinimapLayer*)user;
+    layer->dirty = minimap_union(layer->dirty, rect);
+}
+
+// Colour of one texel (the world's in view coordinates); unexplored tiles
+// stay dark
+static Color minimap_texel(const void* owner, int x, int y)
+{
+    const Color unexplored = { 20, 20, 20, 220 };
+    
+    if (owner == (const void*)worldMap)
+    {
+        x += worldMap->view.x0;
+        y += worldMap->view.y0;
+        if (!world_explored(x, y)) return unexplored;
+        return get_tile_color(world_tile(x, y));
+    }
+    
+    const LocalMap* local = (const LocalMap*)owner;
+    if (!bitgrid_get(&local->explored, x, y)) return unexplored;
+    return get_tile_color(local->tiles[y][x]);
+}
+
+// Bring a minimap up to date with its map (false if staging memory was refused).
+// Headless, the texels are built all the same but there is no texture.
+static bool minimap_sync(MinimapLayer* layer, const void* owner, int width, int height)
+{
+    // New map: build the whole texture once
+    if (layer->owner != owner || layer->width != width || layer->height != height)
+    {
+        if (layer->texture.id != 0 &&
+            (layer->texture.width != width || layer->texture.height != height)) {
+            UnloadTexture(layer->texture);
+            layer->texture.id = 0;
+        }
+        if (layer->texture.id == 0 && !headlessMode)
+        {
+            Image blank = GenImageColor(width, height, BLANK);
+            layer->texture = LoadTextureFromImage(blank);
+            UnloadImage(blank);
+        }
+        layer->owner = owner;
+        layer->width = width;
+        layer->height = height;
+        layer->dirty = (TileRect){ 0, 0, width, height };
+        layer->version = tile_journal(owner)->version;
+    }
+    
+    // Tiles edited since the last upload
+    layer->version = tile_changes_since(tile_journal(owner), layer->version, minimap_chunk_edited, layer);
+    
+    TileRect r = layer->dirty;
+    if (r.x0 < 0) r.x0 = 0;
+    if (r.y0 < 0) r.y0 = 0;
+    if (r.x1 > width) r.x1 = width;
+    if (r.y1 > height) r.y1 = height;
+    if (r.x0 >= r.x1 || r.y0 >= r.y1) return true;
+    
+    size_t texels = (size_t)(r.x1 - r.x0) * (r.y1 - r.y0);
+    if (texels > minimapCapacity)
+    {
+        Color* grown = (Color*)mem_realloc(MEM_RENDER, minimapBuffer, texels * sizeof(Color));
+        if (grown == NULL) return false;
+        minimapBuffer = grown;
+        minimapCapacity = texels;
+    }
+    
+    Color* out = minimapBuffer;
+    for (int y = r.y0; y < r.y1; y++)
+    {
+        for (int x = r.x0; x < r.x1; x++) *out++ = minimap_texel(owner, x, y);
+    }
+    
+    Rectangle rec = { (float)r.x0, (float)r.y0, (float)(r.x1 - r.x0), (float)(r.y1 - r.y0) };
+    if (layer->texture.id != 0) UpdateTextureRec(layer->texture, rec, minimapBuffer);
+    layer->dirty = (TileRect){ 0, 0, 0, 0 };
+    return true;
+}
+
+// Draw one minimap in the top-right corner with the player marked on it
+// (headless, only bring its texels up to date)
+static void minimap_draw_layer(MinimapLayer* layer, const void* owner, int width, int height,
+                               int playerX, int playerY)
+{
+    if (!minimap_sync(layer, owner, width, height) || headlessMode) return;
+    
+    // Longest side fills the box, the other keeps the map's aspect
+    float scale = (float)MINIMAP_SIZE / (float)(width > height ? width : height);
+    Rectangle dest = {
+        GetScreenWidth() - MINIMAP_MARGIN - width * scale, (float)MINIMAP_MARGIN,
+        width * scale, height * scale
+    };
+    Rectangle source = { 0, 0, (float)width, (float)height };
+    DrawTexturePro(layer->texture, source, dest, (Vector2){ 0, 0 }, 0.0f, WHITE);
+    
+    float marker = scale < 3.0f ? 3.0f : scale;
+    DrawRectangleV((Vector2){ dest.x + (playerX + 0.5f) * scale - marker / 2,
+                              dest.y + (playerY + 0.5f) * scale - marker / 2 },
+                   (Vector2){ marker, marker }, RED);
+}
+
+// Minimap of whichever map the player is on
+void minimap_draw()
+{
+    if (!showMinimap || worldMap == NULL) return;
+    
+    if (isInLocalMap)
+    {
+        const LocalMap* local = current_local_map();
+        if (local == NULL) return;
+        minimap_draw_layer(&localMinimap, local, local->width, local->height, localPlayer.x, localPlayer.y);
+    }
+    else
+    {
+        // The world's minimap covers the view
+        const TileRect* view = &worldMap->view;
+        minimap_draw_layer(&worldMinimap, worldMap, view->x1 - view->x0, view->y1 - view->y0,
+                           player.x - view->x0, player.y - view->y0);
+    }
+}
+
+// Tiles of a map changed (or were explored) and their texels need rebuilding
+void minimap_mark_dirty(const void* owner, TileRect rect)
+{
+    if (worldMinimap.owner == owner) worldMinimap.dirty = minimap_union(worldMinimap.dirty, rect);
+    if (localMinimap.owner == owner) localMinimap.dirty = minimap_union(localMinimap.dirty, rect);
+}
+
+// A map is going away; its pointer may be reused by the next one
+void minimap_forget(const void* owner)
+{
+    if (worldMinimap.owner == owner) worldMinimap.owner = NULL;
+    if (localMinimap.owner == owner) localMinimap.owner = NULL;
+}
+
+// Release the textures (before the window closes)
+void minimap_shutdown()
+{
+    MinimapLayer* layers[2] = { &worldMinimap, &localMinimap };
+    for (int i = 0; i < 2; i++)
+    {
+        if (layers[i]->texture.id != 0) UnloadTexture(layers[i]->texture);
+        layers[i]->texture.id = 0;
+        layers[i]->owner = NULL;
+    }
+    
+    mem_free(minimapBuffer);
+    minimapBuffer = NULL;
+    minimapCapacity = 0;
+}
+
+// Drop the staging buffer (the render caches' memory evictor); the next
+// rebuild grows it again
+void minimap_evict()
+{
+    mem_free(minimapBuffer);
+    minimapBuffer = NULL;
+    minimapCapacity = 0;
+}
@@ -0,0 +1,200 @@
+#include "project.h"
+
+// Shared pathfinder scratch space, reused by every query
+PathFinder pathFinder;
+
+// Tile passability (only walls block movement)
+bool tile_is_passable(char tile)
+{
+    return tile != '#';
+}
+
+// Rebuild a local map's passability bits from its tiles
+void local_map_build_passable(LocalMap* local)
+{
+    const char* tiles = local->tiles[0];
+    grid_dispatch(local->width, local->height, [&](auto shape) {
+        grid_pack_bits(shape, local->passable.words, [&](size_t i) { return tile_is_passable(tiles[i]); });
+    });
+}
+
+// Rebuild the passability bits of the world's view
+void world_build_passable()
+{
+    const char* tiles = worldMap->tiles;
+    grid_dispatch(worldPassable.width, worldPassable.height, [&](auto shape) {
+        grid_pack_bits(shape, worldPassable.words, [&](size_t i) { return tile_is_passable(tiles[i]); });
+    });
+}
+
+// Make sure the scratch buffers can hold a map of this many tiles
+void path_reserve(int nodes)
+{
+    if (nodes <= pathFinder.capacity) return;
+    
+    path_shutdown();
+    pathFinder.capacity = nodes;
+    // Lazy deletion can push a node once per neighbour
+    pathFinder.heapCapacity = nodes * 4;
+    pathFinder.heap = (uint64_t*)mem_alloc(MEM_PATH, pathFinder.heapCapacity * sizeof(uint64_t));
+    pathFinder.gScore = (int*)mem_alloc(MEM_PATH, nodes * sizeof(int));
+    pathFinder.parent = (int*)mem_alloc(MEM_PATH, nodes * sizeof(int));
+    pathFinder.openStamp = (unsigned int*)mem_alloc(MEM_PATH, nodes * sizeof(unsigned int));
+    pathFinder.closedStamp = (unsigned int*)mem_alloc(MEM_PATH, nodes * sizeof(unsigned int));
+    pathFinder.route = (int*)mem_alloc(MEM_PATH, nodes * sizeof(int));
+    pathFinder.stamp = 0;
+    pathFinder.routeLength = 0;
+    
+    // Over budget: leave click-to-move disabled rather than half set up
+    if (!pathFinder.heap || !pathFinder.gScore || !pathFinder.parent || 
+        !pathFinder.openStamp || !pathFinder.closedStamp || !pathFinder.route)
+    {
+        path_shutdown();
+        return;
+    }
+    
+    // Touch every page now so the first query doesn't pay for faults
+    memset(pathFinder.heap, 0, pathFinder.heapCapacity * sizeof(uint64_t));
+    memset(pathFinder.gScore, 0, nodes * sizeof(int));
+    memset(pathFinder.parent, 0, nodes * sizeof(int));
+    memset(pathFinder.route, 0, nodes * sizeof(int));
+    memset(pathFinder.openStamp, 0, nodes * sizeof(unsigned int));
+    memset(pathFinder.closedStamp, 0, nodes * sizeof(unsigned int));
+}
+
+// Free the scratch buffers
+void path_shutdown()
+{
+    mem_free(pathFinder.heap);
+    mem_free(pathFinder.gScore);
+    mem_free(pathFinder.parent);
+    mem_free(pathFinder.openStamp);
+    mem_free(pathFinder.closedStamp);
+    mem_free(pathFinder.route);
+    memset(&pathFinder, 0, sizeof(pathFinder));
+}
+
+// Open list: binary min-heap of packed (f, h, node) keys
+static void heap_push(uint64_t key)
+{
+    uint64_t* heap = pathFinder.heap;
+    int i = pathFinder.heapSize++;
+    while (i > 0)
+    {
+        int parent = (i - 1) >> 1;
+        if (heap[parent] <= key) break;
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = key;
+}
+
+static uint64_t heap_pop()
+{
+    uint64_t* heap = pathFinder.heap;
+    uint64_t top = heap[0];
+    uint64_t last = heap[--pathFinder.heapSize];
+    int size = pathFinder.heapSize;
+    int i = 0;
+    for (;;)
+    {
+        int child = i * 2 + 1;
+        if (child >= size) break;
+        if (child + 1 < size && heap[child + 1] < heap[child]) child++;
+        if (last <= heap[child]) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+    return top;
+}
+
+// Find a 4-connected route with A*; result goes to pathFinder.route
+bool path_find(const BitGrid* grid, int startX, int startY, int goalX, int goalY)
+{
+    pathFinder.routeLength = 0;
+    
+    int width = grid->width;
+    int height = grid->height;
+    if (width * height > pathFinder.capacity) return false;
+    if (goalX < 0 || goalY < 0 || goalX >= width || goalY >= height) return false;
+    if (!bitgrid_get(grid, goalX, goalY)) return false;
+    if (startX == goalX && startY == goalY) return false;
+    
+    // New query generation invalidates all previous scores without clearing
+    if (++pathFinder.stamp == 0) {
+        memset(pathFinder.openStamp, 0, pathFinder.capacity * sizeof(unsigned int));
+        memset(pathFinder.closedStamp, 0, pathFinder.capacity * sizeof(unsigned int));
+        pathFinder.stamp = 1;
+    }
+    unsigned int stamp = pathFinder.stamp;
+    
+    int start = startY * width + startX;
+    int goal = goalY * width + goalX;
+    
+    pathFinder.heapSize = 0;
+    pathFinder.gScore[start] = 0;
+    pathFinder.parent[start] = -1;
+    pathFinder.openStamp[start] = stamp;
+    int h0 = abs(goalX - startX) + abs(goalY - startY);
+    heap_push(((uint64_t)h0 << 44) | ((uint64_t)h0 << 24) | (uint64_t)start);
+    
+    static const int dirX[4] = { 1, -1, 0, 0 };
+    static const int dirY[4] = { 0, 0, 1, -1 };
+    
+    bool found = false;
+    while (pathFinder.heapSize > 0)
+    {
+        int node = (int)(heap_pop() & 0xFFFFFF);
+        if (pathFinder.closedStamp[node] == stamp) continue; // Stale entry
+        pathFinder.closedStamp[node] = stamp;
+        
+        if (node == goal) {
+            found = true;
+            break;
+        }
+        
+        int y = node / width;
+        int x = node - y * width;
+        int g = pathFinder.gScore[node] + 1;
+        
+        for (int d = 0; d < 4; d++)
+        {
+            int nx = x + dirX[d];
+            int ny = y + dirY[d];
+            if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+            if (!bitgrid_get(grid, nx, ny)) continue;
+            
+            int next = ny * width + nx;
+            if (pathFinder.closedStamp[next] == stamp) continue;
+            if (pathFinder.openStamp[next] == stamp && pathFinder.gScore[next] <= g) continue;
+            if (pathFinder.heapSize >= pathFinder.heapCapacity) continue;
+            
+            pathFinder.openStamp[next] = stamp;
+            pathFinder.gScore[next] = g;
+            pathFinder.parent[next] = node;
+            
+            // Ties on f prefer the node closest to the goal
+            int h = abs(goalX - nx) + abs(goalY - ny);
+            heap_push(((uint64_t)(g + h) << 44) | ((uint64_t)h << 24) | (uint64_t)next);
+        }
+    }
+    
+    if (!found) return false;
+    
+    // Walk parents back from the goal, then reverse in place
+    int length = 0;
+    for (int node = goal; node != start; node = pathFinder.parent[node])
+    {
+        pathFinder.route[length++] = node;
+    }
+    for (int i = 0; i < length / 2; i++)
+    {
+        int tmp = pathFinder.route[i];
+        pathFinder.route[i] = pathFinder.route[length - 1 - i];
+        pathFinder.route[length - 1 - i] = tmp;
+    }
+    pathFinder.routeLength = length;
+    
+    return true;
+}
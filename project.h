@@ -7,18 +7,92 @@
 #include <time.h>
 #include <math.h>
 #include <string.h>
+#include <stdint.h>
 
 // Game constants
 #define TILE_SIZE 32
 #define LOCAL_MAP_WIDTH 256  // Changed to 256x256 as requested
 #define LOCAL_MAP_HEIGHT 256
+#define DUNGEON_FLOOR_SIDE 128          // Dungeon floors are square
+#define MAP_MAX_DEPTH 8                 // World, local map, then up to six dungeon floors
 #define SCREEN_WIDTH 800
 #define SCREEN_HEIGHT 600
 
+// Simulation timing
+#define TICK_RATE 60                    // Fixed simulation ticks per second
+#define TICK_DT (1.0 / TICK_RATE)
+#define MAX_FRAME_TIME 0.25             // Clamp long frames so the sim never spirals
+#define RENDER_VSYNC true               // Pace rendering with vsync
+#define RENDER_FPS_CAP 0                // 0 = uncapped rendering
+#define IDLE_POLL_RATE 20               // Wakes per second while idle with background work
+#define TERMINAL_FPS 30                 // Frame cap of the terminal front end
+#define RENDER_GPU_TILEMAP true         // Draw maps as one shaded quad when the GPU allows
+#define MINIMAP_SIZE 192                // Pixels along the minimap's longest side
+#define MINIMAP_MARGIN 10               // Gap between the minimap and the screen edge
+#define MOVE_REPEAT_DELAY 12            // Ticks a move key is held before repeating
+#define MOVE_REPEAT_INTERVAL 4          // Ticks between repeated moves
+#define TILE_CHUNK 16                   // Tiles per side of an edit-tracking chunk
+#define STAT_TILE_KINDS 7               // Tile kinds counted by map statistics
+#define SIM_TICK_INTERVAL TICK_RATE     // Ticks between living-terrain generations
+#define SIM_SEASON_LENGTH 32            // Generations per wet or dry season
+#define SIM_MAX_CHANGES 1024            // Tiles one map may change per generation
+#define SIM_MAX_JOBS 64                 // Jobs sharing out a generation's maps
+
+// Creatures
+#define MAX_ENTITIES_PER_MAP 8192
+#define ENTITY_POPULATE_MAX 160         // Most creatures a fresh local map starts with
+#define ENTITY_THINK_INTERVAL 8         // Ticks between creature steps
+#define ENTITY_CHASE_RADIUS 8           // Manhattan distance that triggers a chase
+#define ENTITY_WAKE_RADIUS 48           // Creatures further away stay idle
+#define ENTITY_RECORD_BYTES 9           // Saved bytes per creature, all components
+
+// Field of view
+#define FOV_RADIUS 32                   // Sight radius inside local maps
+#define WORLD_FOV_RADIUS 8              // Sight radius on the world map
+
+// Save files
+#define NUM_SAVE_SLOTS 3
+#define SAVE_MAGIC 0x56534242u           // "BBSV"
+#define SAVE_VERSION 4
+#define SAVE_MAX_SECTION_BYTES (64u << 20)
+#define SAVE_STORE_DIR "save_store"     // Objects shared by every slot
+#define IO_BATCH 256                    // Requests (and open files) per I/O batch
+#define SAVE_MAX_MAP_SIDE 4096
+#define SAVE_MAX_WORLD_SIDE 65536       // Sparse worlds go far beyond any local map
+
+// Job system
+#define JOB_CAPACITY 4096               // Jobs alive at once (a power of two)
+#define JOB_MAIN_BUDGET 0.002           // Seconds of main-thread jobs run per frame
+#define LOCAL_PREFETCH_SLOTS 4          // Neighbouring local maps generated ahead of time
+
+// Allocation watch (--alloc-check)
+#define MEM_WATCH_LOG 32                // Allocations reported per frame
+
+// Input recordings
+#define REPLAY_MAGIC 0x50524242u         // "BBRP"
+#define REPLAY_VERSION 1
+#define REPLAY_BENCH_MAPS 200           // Local maps entered by the benchmark route
+#define REPLAY_TERM_COLUMNS 120         // Offscreen terminal a headless replay draws to
+#define REPLAY_TERM_ROWS 40
+
+// Headless server
+#define SERVER_MAX_CLIENTS 16
+#define SERVER_CHUNK 32                 // Local map tiles per streamed chunk side
+#define SERVER_VIEW_CHUNKS 2            // Chunks streamed on each side of a client
+#define SERVER_CHECK_INTERVAL 60        // Ticks between view checksums
+#define SERVER_MAX_BACKLOG (4u << 20)   // Unsent bytes before a client is dropped
+#define SERVER_MAX_INPUT (64u << 10)   // Unparsed bytes a client may send ahead
+#define NET_TIMING_WINDOW 4096          // Latest tick or ping timings kept for the report
+
 // Default world map size
 #define DEFAULT_WORLD_WIDTH 20
 #define DEFAULT_WORLD_HEIGHT 15
 
+// World chunks
+#define WORLD_CHUNK 64                  // Tiles per side of a world chunk (one bit grid word per row)
+#define WORLD_VIEW_SIDE 256             // Largest world kept whole; bigger ones are sparse
+#define WORLD_VIEW_MARGIN 64            // Tiles from a sparse world's view edge that move the view
+
 // Map size types
 typedef enum {
     SIZE_TINY,
@@ -27,23 +101,228 @@ typedef enum {
     SIZE_LARGE,
     SIZE_HUGE,
     SIZE_GIGANTIC,
+    SIZE_VAST,
+    SIZE_COLOSSAL,
+    SIZE_ENDLESS,
     NUM_SIZES
 } MapSize;
 
-// Local map structure
+// Job priorities, most urgent first
+typedef enum {
+    JOB_HIGH,
+    JOB_NORMAL,
+    JOB_LOW,
+    NUM_JOB_PRIORITIES
+} JobPriority;
+
+typedef uint32_t JobId;                 // 0 = no job
+typedef void (*JobFn)(void* data);
+
+// Memory accounting tags, one per subsystem
+typedef enum {
+    MEM_WORLD,
+    MEM_LOCAL,
+    MEM_SAVE,
+    MEM_RENDER,
+    MEM_PATH,
+    MEM_ENTITY,
+    MEM_FOV,
+    MEM_NET,
+    MEM_FIELD,
+    MEM_STATS,
+    MEM_SIM,
+    MEM_EXPORT,
+    MEM_REPLAY,
+    NUM_MEM_TAGS
+} MemTag;
+
+// Live and peak bytes per tag plus the session's hard cap
 typedef struct {
+    size_t live[NUM_MEM_TAGS];
+    size_t peak[NUM_MEM_TAGS];
+    size_t totalLive;
+    size_t totalPeak;
+    size_t budget;          // Hard cap in bytes, 0 = unlimited
+    int refused;            // Allocations turned down by the cap
+} MemStats;
+
+// Frees at least the requested bytes of one subsystem if it can
+typedef void (*MemEvictFn)(size_t bytesNeeded);
+
+// One bit per tile, rows padded to whole 64-bit words
+typedef struct {
+    uint64_t* words;
+    int width;
+    int height;
+    int stride;             // Words per row
+} BitGrid;
+
+// Half-open rectangle of tile coordinates
+typedef struct {
+    int x0, y0;
+    int x1, y1;
+} TileRect;
+
+// One tile write in a batched edit
+typedef struct {
+    int x, y;
+    char tile;
+} TileEdit;
+
+// Edit record of one TILE_CHUNK x TILE_CHUNK block of a map
+typedef struct {
+    uint64_t version;       // Map version of the latest edit, 0 = never edited
+    int newer, older;       // Recency list links (chunk index + 1, 0 = none)
+    uint64_t dirty[TILE_CHUNK * TILE_CHUNK / 64];   // Tiles edited since generation
+} TileChunk;
+
+// Tile edit history of one map; chunks are allocated on the first edit
+typedef struct {
+    uint64_t version;       // Bumped once per edit batch
+    int width, height;
+    int chunksX, chunksY;
+    TileChunk* chunks;
+    int newest;             // Most recently edited chunk (index + 1, 0 = none)
+} TileJournal;
+
+// Receives each chunk edited after a version
+typedef void (*TileChunkFn)(TileRect rect, const uint64_t* dirty, void* user);
+
+// Creature AI states
+typedef enum {
+    AI_IDLE,
+    AI_WANDER,
+    AI_CHASE
+} AIState;
+
+// Creatures on one local map, one dense array per component
+typedef struct {
+    int count;
+    int capacity;
+    int16_t* x;
+    int16_t* y;
+    char* glyph;
+    uint8_t* aiState;
+    int16_t* hp;
+    uint8_t* timer;         // Ticks until the next step
+    uint32_t rng;
+} EntityStore;
+
+// Terrain with a distance field on every map
+typedef enum {
+    FEATURE_WATER,          // '~'
+    FEATURE_FOREST,         // 'T'
+    FEATURE_MOUNTAIN,       // '^'
+    FEATURE_STAIRS,         // '>'
+    NUM_FEATURES
+} Feature;
+
+// Nearest tile of each feature, for every tile of one map
+typedef struct {
+    uint32_t* nearest[NUM_FEATURES];    // Packed (y << 16) | x per tile, NULL until needed
+    int count[NUM_FEATURES];            // Tiles of the feature, 0 = the map has none
+    int width, height;                  // 0 until built
+    bool stale;                         // Tiles changed while the map was off screen
+} FeatureFields;
+
+// Cached statistics of one map
+typedef struct {
+    bool valid;
+    uint64_t version;                   // Map edits they were taken at
+    int tileCount[STAT_TILE_KINDS];     // '.', 'T', '~', '^', '#', '>', '<'
+    int largestLake;                    // Tiles in the biggest 4-connected body of water
+    int lakeX, lakeY;                   // One tile of it (-1 without water)
+    int passable;                       // Walkable tiles
+    int reachable;                      // Walkable tiles connected to the start
+} MapStats;
+
+struct LocalMap;
+
+// A map under one tile of its parent
+typedef struct {
+    uint32_t tile;          // y * width + x + 1 of the parent, 0 for an empty slot
+    struct LocalMap* map;
+} MapChild;
+
+// Section a map was last saved as, listed again while the map is unchanged
+typedef struct {
+    bool valid;
+    uint64_t editVersion;               // changes.version it was written at
+    uint64_t stateVersion;              // stateVersion it was written at
+    int children;                       // children.count it was written at
+    uint32_t epoch;                     // Saves that failed before it
+    uint64_t hash;                      // Stored object and its framed length
+    uint64_t length;
+} MapSaveCache;
+
+// Maps under a map's tiles: open addressing keyed by tile
+typedef struct {
+    MapChild* slots;
+    int count;
+    int capacity;           // Power of two, 0 until the first child
+} MapChildren;
+
+// Tiles a map's next generation changes, filled by a simulation job
+typedef struct {
+    TileEdit* edits;        // SIM_MAX_CHANGES entries
+    int count;
+} SimChanges;
+
+// Local map structure: every map below the world (local maps, dungeon floors)
+typedef struct LocalMap {
     char** tiles;
     int width;
     int height;
+    BitGrid passable;       // Set where the player can walk
+    BitGrid opaque;         // Set where tiles block sight
+    BitGrid explored;       // Set once the player has seen a tile
+    EntityStore entities;
+    char worldTile;         // Terrain it was generated as ('>' for dungeon floors)
+    TileJournal changes;    // Edits made since generation
+    struct LocalMap* parent;    // NULL when it lies under the world
+    int parentX, parentY;   // Tile of the parent (or world) that leads here
+    int depth;              // 1 under the world, 2 and more for dungeon floors
+    uint32_t seed;          // Tile generator seed
+    MapChildren children;
+    FeatureFields fields;   // Nearest water, forest... from every tile
+    MapStats stats;         // Filled on demand by local_map_stats
+    uint64_t stateVersion;  // Bumped when explored bits or creatures change
+    MapSaveCache saved;     // Its section in the store, from the last save
+    SimChanges next;        // Living terrain's pending changes
 } LocalMap;
 
 // World map tile
 typedef struct {
-    char worldTile;
     LocalMap* localMap;
+    char worldTile;
     bool hasLocalMap;
 } WorldTile;
 
+// WORLD_CHUNK x WORLD_CHUNK tiles of the world and their explored bits
+typedef struct {
+    int cx, cy;                         // Chunk position (tile / WORLD_CHUNK)
+    bool edited;                        // Tiles differ from what the seed generates
+    uint64_t explored[WORLD_CHUNK];     // One word per row
+    WorldTile cells[WORLD_CHUNK * WORLD_CHUNK];
+} WorldChunk;
+
+// The world map: chunks in an open-addressed table keyed by position.
+// Worlds up to WORLD_VIEW_SIDE are generated whole. Larger (sparse) ones
+// store a chunk only once something lives in it (explored tiles, edits, a
+// local map) and generate any other tile from the seed when it is read.
+// Passability, sight, distance fields, routes, field of view and the render
+// caches cover the view, in coordinates relative to its corner: all of a
+// small world, or a chunk-aligned window that follows the player.
+typedef struct {
+    WorldChunk** slots;     // NULL for an empty slot
+    int count;
+    int capacity;           // Power of two
+    bool sparse;
+    TileRect view;
+    char* tiles;            // Tile chars of the view, row-major
+    uint32_t layout;        // Bumped when a chunk is added or the view moves
+} WorldMap;
+
 // Map configuration
 typedef struct {
     int width;
@@ -57,14 +336,139 @@ typedef struct {
     int x, y;
 } Player;
 
+// One level the player went down through
+typedef struct {
+    LocalMap* map;          // NULL for the world
+    Player at;              // Where the player stands there while deeper down
+} MapLevel;
+
+// Levels from the world down to the current map; the current position
+// itself is live in player (world) or localPlayer (any other map)
+typedef struct {
+    MapLevel levels[MAP_MAX_DEPTH];
+    int depth;              // 0 on the world map
+} PlayerStack;
+
+// A world, its derived grids and the player's place in it, detached from
+// the globals so a save can load beside the running game
+typedef struct {
+    WorldMap* world;
+    BitGrid passable;
+    BitGrid opaque;
+    FeatureFields fields;
+    TileJournal changes;
+    int width, height;
+    uint32_t seed;
+    Player player;
+    Player localPlayer;
+    PlayerStack stack;
+} WorldStash;
+
+// A* scratch space, allocated once per map size and reused by every query
+typedef struct {
+    int capacity;               // Tiles the buffers can hold
+    uint64_t* heap;             // Open list of packed (f, h, node) keys
+    int heapSize;
+    int heapCapacity;
+    int* gScore;
+    int* parent;
+    unsigned int* openStamp;    // Query generation that last touched a node
+    unsigned int* closedStamp;  // Query generation that closed a node
+    unsigned int stamp;
+    int* route;                 // Last found route, start excluded, goal included
+    int routeLength;
+} PathFinder;
+
 // Camera for following player
 typedef struct {
     Vector2 target;
     Vector2 offset;
     float zoom;
-    Camera2D camera;
+    Camera2D camera;        // Simulation camera, advanced once per tick
+    Vector2 prevTarget;     // Camera target at the start of the last tick
+    Camera2D view;          // Interpolated camera used for rendering
 } GameCamera;
 
+// Input latched between simulation ticks
+typedef struct {
+    unsigned int pressed;   // Bit per tracked key, pressed since the last tick
+    unsigned int down;      // Bit per tracked key, held at the last poll
+    float wheel;            // Mouse wheel movement since the last tick
+    bool clicked;           // Left mouse button pressed since the last tick
+    Vector2 clickPos;       // World position of that click
+} InputState;
+
+// Save file sections
+typedef enum {
+    SECTION_HEADER = 1,     // Dimensions, player state and stack, world seed
+    SECTION_MANIFEST,       // Hash and length of each stored section, in load order
+    SECTION_WORLD,          // World tiles and local map flags (stored)
+    SECTION_WORLD_EXPLORED, // World explored bits (stored)
+    SECTION_LOCAL,          // One generated map at any depth, edits since generation only (stored)
+    SECTION_END             // Present only in completely written files
+} SaveSectionType;
+
+// Result of checking a save slot's checksums
+typedef enum {
+    SLOT_EMPTY,
+    SLOT_OK,
+    SLOT_CORRUPT
+} SlotStatus;
+
+// Growable staging buffer for one save section
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+    bool failed;            // An append was refused by the memory budget
+} SaveBuffer;
+
+// Bounds-checked cursor over a loaded section
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+    bool failed;
+} SaveReader;
+
+// One whole read or write of a batched I/O run
+typedef struct {
+    int fd;
+    uint64_t offset;
+    uint8_t* data;          // Inside the batch's buffer
+    size_t length;
+    bool write;
+    bool ok;                // Every byte moved
+} IoRequest;
+
+// Batched I/O over one buffer, from io_begin to io_end
+typedef struct {
+    uint8_t* buffer;
+    size_t size;
+    void* ring;             // Kernel ring kept between batches, NULL on the plain path
+} IoSession;
+
+// A stored section being written or read, its bytes in the batch buffer
+typedef struct {
+    uint64_t hash;
+    uint8_t* data;
+    size_t length;
+} StoreObject;
+
+// Where frames are shown and keys come from: the raylib window or a
+// terminal. The main loop runs the same fixed-timestep game on either.
+typedef struct {
+    const char* name;
+    bool (*open)();
+    void (*close)();
+    double (*now)();                    // Steady clock, seconds
+    void (*idle)(double seconds);       // Wait for input or the time to pass (< 0: input only)
+    bool (*shouldClose)();
+    void (*poll)();                     // Latch input for the coming ticks
+    bool (*needsRedraw)(float alpha);
+    void (*draw)(float alpha);
+} Frontend;
+
 // Game states
 typedef enum {
     STATE_TITLE,
@@ -76,7 +480,7 @@ typedef enum {
 } GameState;
 
 // Global variables
-extern WorldTile** worldMap;
+extern WorldMap* worldMap;     // NULL without a world
 extern GameState currentState;
 extern Player player;
 extern Player localPlayer;
@@ -84,21 +488,291 @@ extern int currentMapWidth;
 extern int currentMapHeight;
 extern MapConfig mapSizes[];
 extern GameCamera gameCamera;
-extern bool isInLocalMap;
+extern bool isInLocalMap;     // playerStack.depth > 0
+extern PlayerStack playerStack;
 extern int saveSlotSelected;
 extern bool shouldQuit;  // Add quit flag
+extern InputState input;
+extern BitGrid worldPassable;
+extern PathFinder pathFinder;
+extern TileRect localVisible;  // Local map tiles drawn last frame
+extern MemStats memStats;
+extern bool showDebugHud;
+extern SlotStatus saveSlotStatus[];
+extern BitGrid worldOpaque;
+extern BitGrid fovVisible;     // Tiles in view on the current map
+extern bool frameDirty;  // Something changed since the last rendered frame
+extern bool headlessMode;
+extern bool allocCheck;
+extern bool gpuTilemapEnabled;
+extern bool showMinimap;
+extern TileJournal worldChanges;
+extern FeatureFields worldFields;
+extern uint32_t sessionSeed;
+extern uint32_t worldSeed;
 
 // Game functions
 void gamestartup();
 void gameupdate();
-void gamedraw();
+void gamedraw(float alpha);
+bool game_needs_redraw(float alpha);
+bool game_has_background_work();
+void game_frame_drawn();
+const char* game_status_message();
+const void* game_frame_map();
+bool game_frame_steady(const void* startMap);
+void mark_frame_dirty();
 void gameshutdown();
 void togglefullscreen(int windowWidth, int windowHeight);
-void generate_world_map(int width, int height);
+bool generate_world_map(int width, int height);
+bool world_alloc(int width, int height);
 void cleanup_all_maps();
+void world_stash(WorldStash* stash);
+void world_unstash(const WorldStash* stash);
+void world_release(WorldStash* stash);
+void world_reserve_scratch();
 void init_camera();
 void update_camera();
+void update_camera_view(float alpha);
 void reset_camera_to_default();
+void show_status(const char* message);
+
+// Input functions
+void input_poll();
+void input_consume();
+bool input_key_pressed(int key);
+bool input_key_down(int key);
+float input_wheel_move();
+bool input_mouse_clicked(Vector2* position);
+unsigned int input_key_mask(int key);
+
+// Replay functions
+bool replay_record_open(const char* path, uint32_t seed);
+void replay_record_tick(const InputState* state);
+void replay_record_close();
+bool replay_write_benchmark(const char* path, uint32_t seed);
+int run_replay(const char* path, const char* timingsPath);
+void timing_report(const char* label, double* samples, int count);
+
+// Server functions
+int run_server(const char* address, int sizeIndex, int ticks);
+int run_bot_client(const char* address, int ticks);
+
+// Memory functions
+void* mem_alloc(MemTag tag, size_t size);
+void* mem_calloc(MemTag tag, size_t count, size_t size);
+void* mem_realloc(MemTag tag, void* ptr, size_t size);
+void mem_free(void* ptr);
+void mem_set_budget(size_t bytes);
+void mem_set_evictor(MemTag tag, MemEvictFn evict);
+const char* mem_tag_name(MemTag tag);
+void mem_watch_begin();
+int mem_watch_end();
+void mem_watch_report(FILE* out, int frame);
+void draw_memory_panel(int x, int y);
+
+// Bit grid functions
+bool bitgrid_init(BitGrid* grid, int width, int height, MemTag tag);
+void bitgrid_free(BitGrid* grid);
+void bitgrid_clear(BitGrid* grid);
+
+static inline bool bitgrid_get(const BitGrid* grid, int x, int y)
+{
+    return (grid->words[y * grid->stride + (x >> 6)] >> (x & 63)) & 1;
+}
+
+static inline void bitgrid_put(BitGrid* grid, int x, int y, bool value)
+{
+    uint64_t* word = &grid->words[y * grid->stride + (x >> 6)];
+    uint64_t mask = (uint64_t)1 << (x & 63);
+    *word = value ? (*word | mask) : (*word & ~mask);
+}
+
+// Grid shapes for whole-grid passes. GridShape<W, H> fixes the size at
+// compile time, so indexing is a shift and bounds fold to constants (the
+// mapSizes presets and local maps are all powers of two); GridShape<0, 0>
+// carries any other size at run time.
+static constexpr int grid_log2(int n)
+{
+    return n <= 1 ? 0 : 1 + grid_log2(n / 2);
+}
+
+template <int W, int H>
+struct GridShape {
+    static_assert((W & (W - 1)) == 0 && (H & (H - 1)) == 0, "fixed grid sizes are powers of two");
+    constexpr int width() const { return W; }
+    constexpr int height() const { return H; }
+    constexpr int words() const { return (W + 63) / 64; }   // Bit grid words per row
+    constexpr size_t index(int x, int y) const { return ((size_t)y << grid_log2(W)) | (size_t)x; }
+};
+
+template <>
+struct GridShape<0, 0> {
+    int w, h;
+    int width() const { return w; }
+    int height() const { return h; }
+    int words() const { return (w + 63) / 64; }
+    size_t index(int x, int y) const { return (size_t)y * w + x; }
+};
+
+// Run fn(shape) specialised for the grid's size; dispatch once per pass,
+// not per tile
+template <typename Fn>
+static inline void grid_dispatch(int width, int height, Fn fn)
+{
+    if (width == height)
+    {
+        switch (width)
+        {
+            case 8: fn(GridShape<8, 8>()); return;
+            case 16: fn(GridShape<16, 16>()); return;
+            case 32: fn(GridShape<32, 32>()); return;
+            case 64: fn(GridShape<64, 64>()); return;
+            case 128: fn(GridShape<128, 128>()); return;
+            case 256: fn(GridShape<256, 256>()); return;
+        }
+    }
+    fn(GridShape<0, 0>{ width, height });
+}
+
+// Pack one bit per tile into bit grid words (rows padded to whole words);
+// test(i) reads row-major tile i
+template <typename Shape, typename Test>
+static inline void grid_pack_bits(Shape shape, uint64_t* words, Test test)
+{
+    for (int y = 0; y < shape.height(); y++)
+    {
+        uint64_t* row = &words[(size_t)y * shape.words()];
+        for (int w = 0; w < shape.words(); w++)
+        {
+            // Pack 64 tiles into one word
+            int count = shape.width() - w * 64;
+            if (count > 64) count = 64;
+            size_t first = shape.index(w * 64, y);
+            uint64_t bits = 0;
+            for (int b = 0; b < count; b++)
+            {
+                bits |= (uint64_t)test(first + b) << b;
+            }
+            row[w] = bits;
+        }
+    }
+}
+
+// Open-addressed hash tables: a power-of-two array of slots, linear
+// probing, at most three quarters full. The caller owns the slots, count
+// and capacity; Keys says how to read a slot:
+//   static bool empty(slot)              all-zero slots are empty (calloc)
+//   static uint64_t key(slot)            key of a used slot
+//   static int home(key, capacity)       first slot probed for a key
+
+// Slot holding a key, NULL if the table doesn't have it
+template <typename Keys, typename Slot>
+static inline Slot* hash_find(Slot* slots, int count, int capacity, uint64_t key)
+{
+    if (count == 0) return NULL;
+    for (int i = Keys::home(key, capacity);; i = (i + 1) & (capacity - 1))
+    {
+        if (Keys::empty(slots[i])) return NULL;
+        if (Keys::key(slots[i]) == key) return &slots[i];
+    }
+}
+
+// Put a slot in a table with room for it (the caller counts it)
+template <typename Keys, typename Slot>
+static inline void hash_insert(Slot* slots, int capacity, Slot slot)
+{
+    int i = Keys::home(Keys::key(slot), capacity);
+    while (!Keys::empty(slots[i])) i = (i + 1) & (capacity - 1);
+    slots[i] = slot;
+}
+
+// Room for one more slot: a full table doubles (starting at minimum slots)
+// and every slot moves to its new home. False if the memory budget refused
+// the bigger array; the table is left as it was.
+template <typename Keys, typename Slot>
+static inline bool hash_reserve(Slot** slots, int count, int* capacity, int minimum, MemTag tag)
+{
+    if ((count + 1) * 4 <= *capacity * 3) return true;
+    
+    int grown = *capacity ? *capacity * 2 : minimum;
+    Slot* fresh = (Slot*)mem_calloc(tag, grown, sizeof(Slot));
+    if (fresh == NULL) return false;
+    for (int i = 0; i < *capacity; i++)
+    {
+        if (!Keys::empty((*slots)[i])) hash_insert<Keys>(fresh, grown, (*slots)[i]);
+    }
+    mem_free(*slots);
+    *slots = fresh;
+    *capacity = grown;
+    return true;
+}
+
+// Pathfinding functions
+bool tile_is_passable(char tile);
+void local_map_build_passable(LocalMap* local);
+void world_build_passable();
+void path_reserve(int nodes);
+void path_shutdown();
+bool path_find(const BitGrid* grid, int startX, int startY, int goalX, int goalY);
+
+// Distance field functions
+void local_map_build_fields(LocalMap* local);
+void world_build_fields();
+void feature_fields_reserve(FeatureFields* fields, int width, int height);
+void feature_fields_free(FeatureFields* fields);
+void feature_fields_edit(FeatureFields* fields, int x, int y, char oldTile, char newTile);
+void feature_reserve(int tiles);
+void feature_shutdown();
+bool feature_nearest(const FeatureFields* fields, Feature feature, int x, int y, int* outX, int* outY);
+int feature_distance(const FeatureFields* fields, Feature feature, int x, int y);
+bool feature_within(const FeatureFields* fields, Feature feature, int x, int y, int radius);
+
+// Map statistics functions
+const MapStats* local_map_stats(LocalMap* local);
+int map_stats_count(const MapStats* stats, char tile);
+bool map_stats_connected(const MapStats* stats);
+void stats_reserve(int tiles);
+void stats_shutdown();
+
+// Living terrain functions
+void sim_update();
+bool sim_pending();
+void sim_reserve(int maps);
+void sim_cancel();
+void sim_shutdown();
+
+// Job system functions
+void jobs_init(int threads);
+void jobs_shutdown();
+int jobs_worker_count();
+JobId job_create(JobFn fn, void* data, JobPriority priority, bool mainThread);
+void job_depends_on(JobId job, JobId dependency);
+void job_submit(JobId job);
+JobId job_run(JobFn fn, void* data, JobPriority priority);
+void job_cancel(JobId job);
+bool job_cancelled();
+bool job_finished(JobId job);
+void job_wait(JobId job);
+void jobs_wait_all();
+bool jobs_busy();
+void jobs_run_main(double budgetSeconds);
+bool job_is_main_thread();
+
+// World export functions
+bool export_world_pyramid(const char* directory);
+
+// Menu layer functions
+bool menu_begin(GameState menu, uint32_t contentKey);
+void menu_title(const char* title, float y);
+void menu_option_style(int size, float gap);
+int menu_option(const char* label);
+void menu_note(int option, const char* text, Color color);
+void menu_detail(int option, const char* text, float y);
+void menu_instruction(const char* text);
+void menu_end();
+void menu_draw(int selected, unsigned int disabledMask);
+void menu_shutdown();
 
 // Title screen functions
 void title_update();
@@ -109,28 +783,147 @@ void mapsize_draw();
 void mapsize_update();
 
 // Save/Load functions
-void save_game_to_slot(int slot);
+bool save_game_to_slot(int slot);
 bool load_game_from_slot(int slot);
+SlotStatus save_slot_check(int slot);
+void refresh_save_slots();
+bool any_save_loadable();
+void savebuf_put(SaveBuffer* buf, const void* data, size_t size);
+void savebuf_free(SaveBuffer* buf);
+bool savebuf_get(SaveReader* reader, void* data, size_t size);
+uint32_t crc32c_update(uint32_t crc, const void* data, size_t length);
+bool crc32c_hardware();
 void save_menu_draw();
 void save_menu_update();
 void load_menu_draw();
 void load_menu_update();
 bool save_file_exists(int slot);  // New function
+uint64_t store_hash(const void* data, size_t length);
+bool store_write(StoreObject* objects, int count, uint8_t* buffer, size_t size);
+bool store_read(StoreObject* objects, int count, uint8_t* buffer, size_t size);
+bool store_has(uint64_t hash);
+FILE* store_open(uint64_t hash);
+void store_collect(uint64_t* keep, int count);
+bool store_replace(const char* temp, const char* filename);
+void store_shutdown();
+int io_open(const char* path, bool write);
+bool io_close(int fd);
+void io_begin(IoSession* session, uint8_t* buffer, size_t size);
+bool io_run(IoSession* session, IoRequest* requests, int count);
+void io_end(IoSession* session);
+const char* io_backend();
 
 // Player functions
 void draw_player();
 void draw_hud();
+const char* hud_feature_hint(const FeatureFields* fields, Feature feature, int x, int y);
+
+// Terminal front end
+extern const Frontend terminalFrontend;
+int term_columns();
+int term_rows();
+void term_text(int column, int row, const char* text, Color color);
+bool term_open_offscreen(int columns, int rows);
+void term_draw_offscreen();
+void term_close_offscreen();
 void draw_local_player();
 
 // Map functions
 Color get_tile_color(char tile);
+Color world_tile_color(int x, int y);
 void draw_world_map();
 void draw_local_map();
 
+// Tile mutation functions
+void set_local_tile(LocalMap* local, int x, int y, char tile);
+void set_world_tile(int x, int y, char tile);
+bool set_local_tiles(LocalMap* local, const TileEdit* edits, int count);
+bool set_world_tiles(const TileEdit* edits, int count);
+TileJournal* tile_journal(const void* owner);
+uint64_t tile_changes_since(const TileJournal* journal, uint64_t version, TileChunkFn visit, void* user);
+void tile_journal_free(TileJournal* journal);
+bool tile_journal_reset(TileJournal* journal, MemTag tag, int width, int height);
+
+// GPU tilemap functions
+bool tilemap_draw_world(TileRect visible, int fontSize);
+bool tilemap_draw_local(const LocalMap* local, TileRect visible);
+void tilemap_stage();
+void tilemap_mark_dirty(const void* owner, TileRect rect);
+void tilemap_mark_fov(const void* owner, TileRect rect);
+void tilemap_forget(const void* owner);
+void tilemap_evict(size_t bytesNeeded);
+void tilemap_shutdown();
+
+// Minimap functions
+void minimap_draw();
+void minimap_mark_dirty(const void* owner, TileRect rect);
+void minimap_forget(const void* owner);
+void minimap_evict();
+void minimap_shutdown();
+
+// Entity functions
+void entity_store_init(EntityStore* store, uint32_t seed);
+void entity_store_reset(EntityStore* store, uint32_t seed);
+bool entity_store_reserve(EntityStore* store, int capacity);
+void entity_store_free(EntityStore* store);
+int entity_spawn(EntityStore* store, int x, int y, char glyph, int hp);
+void entity_remove(EntityStore* store, int i);
+void entity_populate(LocalMap* local, char worldTile);
+void entity_update_ai(EntityStore* store, int playerX, int playerY);
+bool entity_update_movement(EntityStore* store, const BitGrid* passable, int playerX, int playerY, TileRect watch);
+void entity_store_write(const EntityStore* store, SaveBuffer* buf);
+bool entity_store_read(EntityStore* store, SaveReader* reader, int mapWidth, int mapHeight);
+void draw_entities(const EntityStore* store, TileRect visible, const BitGrid* inView);
+
+// Field of view functions
+bool tile_is_opaque(char tile);
+void local_map_build_opaque(LocalMap* local);
+void world_build_opaque();
+void fov_compute(const BitGrid* opaque, BitGrid* visible, BitGrid* explored, 
+                 int originX, int originY, int radius);
+bool fov_update();
+void fov_invalidate();
+void fov_shutdown();
+
+// World map functions
+WorldChunk* world_chunk(int x, int y);
+WorldChunk* world_chunk_store(int x, int y);
+void world_chunks_free(WorldMap* world);
+WorldTile world_cell(int x, int y);
+char world_tile(int x, int y);
+bool world_explored(int x, int y);
+void world_explore(const BitGrid* visible, int y0, int y1);
+bool world_passable(int x, int y);
+bool world_view_contains(int x, int y);
+void world_tile_changed(int x, int y);
+void world_view_center(int x, int y);
+bool world_view_follow(int x, int y);
+
+static inline int world_chunk_cell(int x, int y)
+{
+    return (y & (WORLD_CHUNK - 1)) * WORLD_CHUNK + (x & (WORLD_CHUNK - 1));
+}
+
 // Local map functions
-void enter_local_map(int worldX, int worldY);
+void enter_local_map(int x, int y);
 void exit_local_map();
 void generate_local_map_at(int worldX, int worldY);
+LocalMap* generate_child_map(LocalMap* parent, int x, int y);
+uint32_t local_map_seed(int worldX, int worldY);
+void local_map_fill(char* tiles, int width, int height, char worldTile, uint32_t seed);
+void local_map_generate_tiles(LocalMap* local);
+LocalMap* local_map_alloc(int width, int height);
+void local_map_free(LocalMap* local);
+void local_map_destroy(LocalMap* local);
+
+// Map hierarchy functions
+LocalMap* current_local_map();
+LocalMap* map_child(const LocalMap* parent, int x, int y);
+bool map_set_child(LocalMap* parent, int x, int y, LocalMap* child);
+bool map_tile_has_child(const LocalMap* parent, int x, int y);
+uint32_t map_child_seed(const LocalMap* parent, int x, int y);
+void map_children_free(MapChildren* children);
+void player_stack_reset();
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,329 @@
+#include "project.h"
+#include <chrono>
+
+// Recording header; the body is one record per simulation tick
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t seed;          // Session seed the worlds were generated from
+    uint32_t tickRate;      // Ticks per second the input was latched at
+} ReplayHeader;
+
+// Flags leading each tick record; an idle tick is a single zero byte
+enum {
+    REPLAY_PRESSED = 1,     // uint32 pressed mask follows
+    REPLAY_DOWN = 2,        // uint32 held mask follows (only when it changed)
+    REPLAY_WHEEL = 4,       // float wheel movement follows
+    REPLAY_CLICK = 8        // float x, y world click position follows
+};
+
+// Open recording and the held keys its last record left behind
+static FILE* recordFile = NULL;
+static unsigned int recordDown = 0;
+
+// Monotonic clock in milliseconds (works without a window)
+static double replay_now_ms()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Start writing ticks to a recording (false if the file can't be created)
+bool replay_record_open(const char* path, uint32_t seed)
+{
+    recordFile = fopen(path, "wb");
+    if (recordFile == NULL) return false;
+    
+    ReplayHeader header = { REPLAY_MAGIC, REPLAY_VERSION, seed, TICK_RATE };
+    fwrite(&header, sizeof(header), 1, recordFile);
+    recordDown = 0;
+    return true;
+}
+
+// Append the input one tick is about to consume
+void replay_record_tick(const InputState* state)
+{
+    if (recordFile == NULL) return;
+    
+    uint8_t flags = 0;
+    if (state->pressed) flags |= REPLAY_PRESSED;
+    if (state->down != recordDown) flags |= REPLAY_DOWN;
+    if (state->wheel != 0.0f) flags |= REPLAY_WHEEL;
+    if (state->clicked) flags |= REPLAY_CLICK;
+    
+    fwrite(&flags, 1, 1, recordFile);
+    if (flags & REPLAY_PRESSED) fwrite(&state->pressed, sizeof(uint32_t), 1, recordFile);
+    if (flags & REPLAY_DOWN) fwrite(&state->down, sizeof(uint32_t), 1, recordFile);
+    if (flags & REPLAY_WHEEL) fwrite(&state->wheel, sizeof(float), 1, recordFile);
+    if (flags & REPLAY_CLICK) fwrite(&state->clickPos, sizeof(float), 2, recordFile);
+    
+    recordDown = state->down;
+}
+
+// Finish the recording
+void replay_record_close()
+{
+    if (recordFile == NULL) return;
+    fclose(recordFile);
+    recordFile = NULL;
+}
+
+// Read the next tick's input (false at the end of the recording)
+static bool replay_read_tick(FILE* file, InputState* state, unsigned int* down)
+{
+    uint8_t flags;
+    if (fread(&flags, 1, 1, file) != 1) return false;
+    
+    InputState next = {};
+    next.down = *down;
+    
+    bool ok = true;
+    if (flags & REPLAY_PRESSED) ok = ok && fread(&next.pressed, sizeof(uint32_t), 1, file) == 1;
+    if (flags & REPLAY_DOWN) ok = ok && fread(&next.down, sizeof(uint32_t), 1, file) == 1;
+    if (flags & REPLAY_WHEEL) ok = ok && fread(&next.wheel, sizeof(float), 1, file) == 1;
+    if (flags & REPLAY_CLICK) {
+        ok = ok && fread(&next.clickPos, sizeof(float), 2, file) == 2;
+        next.clicked = true;
+    }
+    if (!ok) return false;
+    
+    *down = next.down;
+    *state = next;
+    return true;
+}
+
+// Benchmark helpers: press a key for one tick, then release it
+static void bench_tap(unsigned int mask)
+{
+    InputState state = {};
+    state.pressed = mask;
+    state.down = mask;
+    replay_record_tick(&state);
+    
+    state = {};
+    replay_record_tick(&state);
+}
+
+// Hold a key for a number of ticks
+static void bench_hold(unsigned int mask, int ticks)
+{
+    InputState state = {};
+    state.pressed = mask;
+    for (int i = 0; i < ticks; i++)
+    {
+        state.down = mask;
+        replay_record_tick(&state);
+        state.pressed = 0;
+    }
+    
+    state = {};
+    replay_record_tick(&state);
+}
+
+// Write the standard benchmark: start a GIGANTIC world, walk across it
+// and enter (and walk around in) REPLAY_BENCH_MAPS local maps
+bool replay_write_benchmark(const char* path, uint32_t seed)
+{
+    if (!replay_record_open(path, seed)) return false;
+    
+    unsigned int enter = input_key_mask(KEY_ENTER);
+    unsigned int down = input_key_mask(KEY_DOWN);
+    unsigned int right = input_key_mask(KEY_RIGHT);
+    unsigned int left = input_key_mask(KEY_LEFT);
+    unsigned int back = input_key_mask(KEY_BACKSPACE);
+    
+    // Title -> NEW GAME -> GIGANTIC
+    bench_tap(enter);
+    for (int i = 0; i < SIZE_GIGANTIC; i++) bench_tap(down);
+    bench_tap(enter);
+    
+    // Snake across the world, one new local map per step
+    int width = mapSizes[SIZE_GIGANTIC].width;
+    int x = 2;
+    bool eastward = true;
+    for (int i = 0; i < REPLAY_BENCH_MAPS; i++)
+    {
+        if ((eastward && x + 1 >= width - 1) || (!eastward && x - 1 <= 0)) {
+            bench_tap(down);
+            eastward = !eastward;
+        } else {
+            bench_tap(eastward ? right : left);
+            x += eastward ? 1 : -1;
+        }
+        
+        bench_tap(enter);
+        bench_hold(down, TICK_RATE);
+        bench_hold(right, TICK_RATE / 2);
+        bench_tap(back);
+    }
+    
+    replay_record_close();
+    return true;
+}
+
+// Sort helper for timing percentiles
+static int replay_compare_ms(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Print mean, median, 99th percentile and worst of one timing column
+void timing_report(const char* label, double* samples, int count)
+{
+    if (count == 0) return;
+    
+    double sum = 0.0;
+    for (int i = 0; i < count; i++) sum += samples[i];
+    qsort(samples, count, sizeof(double), replay_compare_ms);
+    
+    printf("%-7s mean %.3f ms  p50 %.3f ms  p99 %.3f ms  max %.3f ms\n", label,
+           sum / count, samples[count / 2], samples[(int)(count * 0.99)], samples[count - 1]);
+}
+
+// Without a window a frame is drawn to the offscreen terminal, and the
+// minimap and tilemap stage their changed tiles as for an upload
+static void replay_draw_headless()
+{
+    term_draw_offscreen();
+    if (currentState != STATE_PLAYING) return;
+    minimap_draw();
+    tilemap_stage();
+}
+
+// Play a recording back as fast as possible, one frame per tick, with or
+// without a window; returns the process exit code
+int run_replay(const char* path, const char* timingsPath)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "replay: can't open %s\n", path);
+        return 1;
+    }
+    
+    ReplayHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != REPLAY_MAGIC || header.version != REPLAY_VERSION ||
+        header.tickRate != TICK_RATE)
+    {
+        fprintf(stderr, "replay: %s is not a recording for this build\n", path);
+        fclose(file);
+        return 1;
+    }
+    
+    FILE* timings = NULL;
+    if (timingsPath) {
+        timings = fopen(timingsPath, "w");
+        if (timings) fprintf(timings, "frame,update_ms,draw_ms\n");
+    }
+    
+    // Per-frame timings, grown as the recording plays
+    int capacity = 4096;
+    int frames = 0;
+    int measured = 0;
+    bool timed = true;
+    double* updateMs = (double*)mem_alloc(MEM_REPLAY, capacity * sizeof(double));
+    double* drawMs = (double*)mem_alloc(MEM_REPLAY, capacity * sizeof(double));
+    if (updateMs == NULL || drawMs == NULL)
+    {
+        fprintf(stderr, "replay: no memory for frame timings\n");
+        mem_free(updateMs);
+        mem_free(drawMs);
+        if (timings) fclose(timings);
+        fclose(file);
+        return 1;
+    }
+    
+    // Same seed, same worlds, same input: same simulation
+    sessionSeed = header.seed;
+    if (!headlessMode) {
+        InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "BoneBound (replay)");
+        SetTargetFPS(0);
+    }
+    else if (!term_open_offscreen(REPLAY_TERM_COLUMNS, REPLAY_TERM_ROWS)) {
+        fprintf(stderr, "replay: no memory for the offscreen terminal\n");
+    }
+    gamestartup();
+    
+    unsigned int down = 0;
+    int steadyFrames = 0;
+    int allocFrames = 0;
+    int allocations = 0;
+    double start = replay_now_ms();
+    
+    while (!shouldQuit && replay_read_tick(file, &input, &down))
+    {
+        if (!headlessMode && WindowShouldClose()) break;
+        
+        const void* frameMap = game_frame_map();
+        if (allocCheck) mem_watch_begin();
+        double t0 = replay_now_ms();
+        gameupdate();
+        input_consume();
+        jobs_run_main(JOB_MAIN_BUDGET);
+        double t1 = replay_now_ms();
+        if (!headlessMode) gamedraw(1.0f);
+        else replay_draw_headless();
+        double t2 = replay_now_ms();
+        
+        // Steady-state frames must not touch the heap
+        if (allocCheck)
+        {
+            int seen = mem_watch_end();
+            if (game_frame_steady(frameMap))
+            {
+                steadyFrames++;
+                if (seen > 0) {
+                    if (allocFrames < 10) mem_watch_report(stderr, frames);
+                    allocFrames++;
+                    allocations += seen;
+                }
+            }
+        }
+        
+        // Past the memory cap the replay plays on, later frames unmeasured
+        if (timed && measured == capacity)
+        {
+            size_t grown = (size_t)capacity * 2 * sizeof(double);
+            double* moreUpdate = (double*)mem_realloc(MEM_REPLAY, updateMs, grown);
+            if (moreUpdate != NULL) updateMs = moreUpdate;
+            double* moreDraw = moreUpdate ? (double*)mem_realloc(MEM_REPLAY, drawMs, grown) : NULL;
+            if (moreDraw != NULL) {
+                drawMs = moreDraw;
+                capacity *= 2;
+            }
+            else timed = false;
+        }
+        if (timed)
+        {
+            updateMs[measured] = t1 - t0;
+            drawMs[measured] = t2 - t1;
+            measured++;
+        }
+        if (timings) fprintf(timings, "%d,%.4f,%.4f\n", frames, t1 - t0, t2 - t1);
+        frames++;
+    }
+    
+    double elapsed = replay_now_ms() - start;
+    printf("replay: %d frames in %.1f ms (%s), player at %d,%d%s\n", frames, elapsed,
+           headlessMode ? "headless" : "windowed", player.x, player.y,
+           isInLocalMap ? " in a local map" : "");
+    if (measured < frames) printf("timings cover the first %d frames (memory cap)\n", measured);
+    timing_report("update", updateMs, measured);
+    timing_report("draw", drawMs, measured);
+    if (allocCheck) {
+        printf("alloc-check: %d steady frames, %d allocations in %d of them\n",
+               steadyFrames, allocations, allocFrames);
+    }
+    
+    mem_free(updateMs);
+    mem_free(drawMs);
+    if (timings) fclose(timings);
+    fclose(file);
+    
+    gameshutdown();
+    if (!headlessMode) CloseWindow();
+    else term_close_offscreen();
+    return allocFrames > 0 ? 1 : 0;
+}
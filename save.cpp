@@ -0,0 +1,1088 @@
+#include "project.h"
+
+// Integrity of each slot, refreshed when saves change or the menu opens
+SlotStatus saveSlotStatus[NUM_SAVE_SLOTS];
+
+// Every save starts with these eight bytes
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} SaveFileHeader;
+
+// Prefix of each section; crc covers type, length and payload
+typedef struct {
+    uint32_t type;
+    uint32_t crc;
+    uint64_t length;
+} SaveSectionHeader;
+
+// Slot file name
+static void save_slot_filename(int slot, char* filename, size_t size)
+{
+    snprintf(filename, size, "save_%d.dat", slot);
+}
+
+// Check if save file exists
+bool save_file_exists(int slot)
+{
+    char filename[50];
+    save_slot_filename(slot, filename, sizeof(filename));
+    FILE* test = fopen(filename, "rb");
+    if (test) {
+        fclose(test);
+        return true;
+    }
+    return false;
+}
+
+// Make room for more bytes at the end of a save buffer, growing it under
+// the memory budget; returns where they go, NULL if refused
+static uint8_t* savebuf_extend(SaveBuffer* buf, size_t size)
+{
+    if (buf->failed) return NULL;
+    
+    if (buf->size + size > buf->capacity)
+    {
+        size_t capacity = buf->capacity ? buf->capacity : 4096;
+        while (capacity < buf->size + size) capacity *= 2;
+        
+        uint8_t* grown = (uint8_t*)mem_realloc(MEM_SAVE, buf->data, capacity);
+        if (grown == NULL) {
+            buf->failed = true;
+            return NULL;
+        }
+        buf->data = grown;
+        buf->capacity = capacity;
+    }
+    
+    uint8_t* at = buf->data + buf->size;
+    buf->size += size;
+    return at;
+}
+
+// Append bytes to a save buffer
+void savebuf_put(SaveBuffer* buf, const void* data, size_t size)
+{
+    uint8_t* at = savebuf_extend(buf, size);
+    if (at != NULL && size > 0) memcpy(at, data, size);
+}
+
+// Release a save buffer
+void savebuf_free(SaveBuffer* buf)
+{
+    mem_free(buf->data);
+    memset(buf, 0, sizeof(SaveBuffer));
+}
+
+// Read bytes from a section payload, failing instead of overrunning
+bool savebuf_get(SaveReader* reader, void* data, size_t size)
+{
+    if (reader->failed || size > reader->size - reader->pos) {
+        reader->failed = true;
+        return false;
+    }
+    memcpy(data, reader->data + reader->pos, size);
+    reader->pos += size;
+    return true;
+}
+
+// CRC of a section header's type and length, continued over the payload
+static uint32_t save_section_crc(uint32_t type, uint64_t length, const void* payload)
+{
+    uint32_t crc = crc32c_update(0, &type, sizeof(type));
+    crc = crc32c_update(crc, &length, sizeof(length));
+    return crc32c_update(crc, payload, (size_t)length);
+}
+
+// Reserve a section header in the file image; returns where it sits
+static size_t save_begin_section(SaveBuffer* file)
+{
+    SaveSectionHeader header = { 0, 0, 0 };
+    size_t at = file->size;
+    savebuf_put(file, &header, sizeof(header));
+    return at;
+}
+
+// Fill in a section's header once its payload follows it
+static void save_end_section(SaveBuffer* file, size_t at, uint32_t type)
+{
+    if (file->failed) return;
+    
+    SaveSectionHeader header;
+    header.type = type;
+    header.length = file->size - at - sizeof(header);
+    header.crc = save_section_crc(type, header.length, file->data + at + sizeof(header));
+    memcpy(file->data + at, &header, sizeof(header));
+}
+
+// Where save_edited_chunk writes
+typedef struct {
+    SaveBuffer* buf;
+    const LocalMap* local;
+    uint32_t count;
+} SaveEdits;
+
+// One edited chunk: index, edit bitset, then the edited tiles in bit order
+static void save_edited_chunk(TileRect rect, const uint64_t* dirty, void* user)
+{
+    SaveEdits* edits = (SaveEdits*)user;
+    const TileJournal* journal = &edits->local->changes;
+    uint32_t index = (uint32_t)((rect.y0 / TILE_CHUNK) * journal->chunksX + rect.x0 / TILE_CHUNK);
+    savebuf_put(edits->buf, &index, sizeof(index));
+    savebuf_put(edits->buf, dirty, TILE_CHUNK * TILE_CHUNK / 8);
+    
+    for (int bit = 0; bit < TILE_CHUNK * TILE_CHUNK; bit++)
+    {
+        if (!(dirty[bit >> 6] >> (bit & 63) & 1)) continue;
+        int x = rect.x0 + bit % TILE_CHUNK;
+        int y = rect.y0 + bit / TILE_CHUNK;
+        savebuf_put(edits->buf, &edits->local->tiles[y][x], 1);
+    }
+    edits->count++;
+}
+
+// Local tiles are regenerated from the world seed on load, so only the
+// tiles edited since generation are saved
+static void save_local_edits(SaveBuffer* buf, const LocalMap* local)
+{
+    SaveEdits edits = { buf, local, 0 };
+    size_t countAt = buf->size;
+    savebuf_put(buf, &edits.count, sizeof(edits.count));
+    
+    if (local->changes.chunks != NULL) tile_changes_since(&local->changes, 0, save_edited_chunk, &edits);
+    if (!buf->failed) memcpy(buf->data + countAt, &edits.count, sizeof(edits.count));
+}
+
+// Edited tiles saved by save_local_edits, applied as one batch
+static bool load_local_edits(SaveReader* reader, LocalMap* local)
+{
+    uint32_t count;
+    if (!savebuf_get(reader, &count, sizeof(count))) return false;
+    
+    int chunksX = (local->width + TILE_CHUNK - 1) / TILE_CHUNK;
+    int chunksY = (local->height + TILE_CHUNK - 1) / TILE_CHUNK;
+    if (count > (uint32_t)(chunksX * chunksY)) return false;
+    
+    static thread_local TileEdit edits[TILE_CHUNK * TILE_CHUNK];
+    for (uint32_t c = 0; c < count; c++)
+    {
+        uint32_t index;
+        uint64_t dirty[TILE_CHUNK * TILE_CHUNK / 64];
+        if (!savebuf_get(reader, &index, sizeof(index)) || index >= (uint32_t)(chunksX * chunksY) ||
+            !savebuf_get(reader, dirty, sizeof(dirty))) return false;
+        
+        int editCount = 0;
+        for (int bit = 0; bit < TILE_CHUNK * TILE_CHUNK; bit++)
+        {
+            if (!(dirty[bit >> 6] >> (bit & 63) & 1)) continue;
+            TileEdit* edit = &edits[editCount++];
+            edit->x = (int)(index % chunksX) * TILE_CHUNK + bit % TILE_CHUNK;
+            edit->y = (int)(index / chunksX) * TILE_CHUNK + bit / TILE_CHUNK;
+            if (!savebuf_get(reader, &edit->tile, 1)) return false;
+        }
+        if (!set_local_tiles(local, edits, editCount)) return false;
+    }
+    return true;
+}
+
+// Chunks in row order of their positions
+static int save_compare_chunks(const void* a, const void* b)
+{
+    const WorldChunk* ca = *(const WorldChunk* const*)a;
+    const WorldChunk* cb = *(const WorldChunk* const*)b;
+    if (ca->cy != cb->cy) return ca->cy < cb->cy ? -1 : 1;
+    return (ca->cx > cb->cx) - (ca->cx < cb->cx);
+}
+
+// The world's stored chunks in row order, so the same world saves to the
+// same bytes whatever order its chunks were created in (NULL if out of
+// memory; free with mem_free)
+static WorldChunk** save_world_chunks()
+{
+    WorldChunk** chunks = (WorldChunk**)mem_alloc(MEM_SAVE, (size_t)(worldMap->count + 1) * sizeof(WorldChunk*));
+    if (chunks == NULL) return NULL;
+    
+    int count = 0;
+    for (int i = 0; i < worldMap->capacity; i++)
+    {
+        if (worldMap->slots[i] != NULL) chunks[count++] = worldMap->slots[i];
+    }
+    qsort(chunks, (size_t)count, sizeof(WorldChunk*), save_compare_chunks);
+    return chunks;
+}
+
+// Small world: tile chars, then local map flags, a row at a time (the view
+// is the whole world, so its chars are already rows)
+static void save_world_grid(SaveBuffer* buf)
+{
+    uint8_t row[WORLD_VIEW_SIDE];
+    for (int y = 0; y < currentMapHeight; y++) {
+        savebuf_put(buf, worldMap->tiles + (size_t)y * currentMapWidth, currentMapWidth);
+    }
+    for (int y = 0; y < currentMapHeight; y++)
+    {
+        for (int x = 0; x < currentMapWidth; x++) row[x] = world_cell(x, y).hasLocalMap ? 1 : 0;
+        savebuf_put(buf, row, currentMapWidth);
+    }
+}
+
+// Small world: explored bits as rows of 64-bit words, each word one
+// chunk's row
+static void save_world_explored(SaveBuffer* buf)
+{
+    for (int y = 0; y < currentMapHeight; y++)
+    {
+        for (int x = 0; x < currentMapWidth; x += WORLD_CHUNK) {
+            savebuf_put(buf, &world_chunk(x, y)->explored[y & (WORLD_CHUNK - 1)], sizeof(uint64_t));
+        }
+    }
+}
+
+// Sparse world: the edited chunks whole (the rest generate from the seed),
+// each as its position, tile chars and local map flags
+static void save_world_edited(SaveBuffer* buf, WorldChunk* const* chunks)
+{
+    uint32_t count = 0;
+    for (int i = 0; i < worldMap->count; i++) count += chunks[i]->edited ? 1 : 0;
+    savebuf_put(buf, &count, sizeof(count));
+    
+    uint8_t bytes[WORLD_CHUNK * WORLD_CHUNK];
+    for (int i = 0; i < worldMap->count; i++)
+    {
+        const WorldChunk* chunk = chunks[i];
+        if (!chunk->edited) continue;
+        
+        int32_t at[2] = { chunk->cx, chunk->cy };
+        savebuf_put(buf, at, sizeof(at));
+        for (int j = 0; j < WORLD_CHUNK * WORLD_CHUNK; j++) bytes[j] = (uint8_t)chunk->cells[j].worldTile;
+        savebuf_put(buf, bytes, sizeof(bytes));
+        for (int j = 0; j < WORLD_CHUNK * WORLD_CHUNK; j++) bytes[j] = chunk->cells[j].hasLocalMap ? 1 : 0;
+        savebuf_put(buf, bytes, sizeof(bytes));
+    }
+}
+
+// Sparse world: the chunks with anything explored, each as its position
+// and explored words
+static void save_world_seen(SaveBuffer* buf, WorldChunk* const* chunks)
+{
+    uint32_t count = 0;
+    for (int i = 0; i < worldMap->count; i++)
+    {
+        uint64_t any = 0;
+        for (int r = 0; r < WORLD_CHUNK; r++) any |= chunks[i]->explored[r];
+        count += any != 0 ? 1 : 0;
+    }
+    savebuf_put(buf, &count, sizeof(count));
+    
+    for (int i = 0; i < worldMap->count; i++)
+    {
+        const WorldChunk* chunk = chunks[i];
+        uint64_t any = 0;
+        for (int r = 0; r < WORLD_CHUNK; r++) any |= chunk->explored[r];
+        if (any == 0) continue;
+        
+        int32_t at[2] = { chunk->cx, chunk->cy };
+        savebuf_put(buf, at, sizeof(at));
+        savebuf_put(buf, chunk->explored, sizeof(chunk->explored));
+    }
+}
+
+// Generated maps below a map (NULL = the world), all the way down
+static int save_count_maps(const LocalMap* parent)
+{
+    int count = 0;
+    if (parent == NULL)
+    {
+        for (int i = 0; i < worldMap->capacity; i++)
+        {
+            const WorldChunk* chunk = worldMap->slots[i];
+            for (int j = 0; chunk != NULL && j < WORLD_CHUNK * WORLD_CHUNK; j++)
+            {
+                if (chunk->cells[j].localMap != NULL) count += 1 + save_count_maps(chunk->cells[j].localMap);
+            }
+        }
+        return count;
+    }
+    
+    for (int i = 0; i < parent->children.capacity; i++)
+    {
+        if (parent->children.slots[i].tile != 0) count += 1 + save_count_maps(parent->children.slots[i].map);
+    }
+    return count;
+}
+
+// Manifest entry: one stored section, named by the hash of its framed bytes
+typedef struct {
+    uint64_t hash;
+    uint64_t length;        // Section header plus payload
+} SaveObjectRef;
+
+// A save on its way to disk: the stored sections and the slot file that
+// lists them are built on the main thread, written out by a worker and
+// reported back on the main thread
+typedef struct {
+    int slot;
+    SaveBuffer objects;     // Sections serialized for this save, in manifest order
+    SaveBuffer refs;        // Manifest: every section by hash, in the order they load
+    SaveBuffer fresh;       // One byte per manifest entry, 1 if it is in objects
+    SaveBuffer file;        // Slot file: header, manifest, end marker
+    int objectCount;
+    bool ok;
+} SaveWrite;
+
+// Failed saves so far; a map cached before one may not have been stored
+static uint32_t saveEpoch = 0;
+
+// List a section in the manifest
+static void save_list_section(SaveWrite* save, uint64_t hash, uint64_t length, uint8_t fresh)
+{
+    SaveObjectRef ref = { hash, length };
+    savebuf_put(&save->refs, &ref, sizeof(ref));
+    savebuf_put(&save->fresh, &fresh, 1);
+}
+
+// Close a section serialized into objects, hash it and list it
+static SaveObjectRef save_store_section(SaveWrite* save, size_t at, uint32_t type)
+{
+    SaveBuffer* objects = &save->objects;
+    save_end_section(objects, at, type);
+    
+    SaveObjectRef ref = { 0, 0 };
+    if (objects->failed) return ref;
+    ref.length = objects->size - at;
+    ref.hash = store_hash(objects->data + at, (size_t)ref.length);
+    save_list_section(save, ref.hash, ref.length, 1);
+    return ref;
+}
+
+// One section per generated map, parents before children. Each starts with
+// its path from the world, one (x, y) per level, so loading finds the
+// parent in constant time per level and rebuilds the tiles from its seed.
+// A map unchanged since the last save is listed by its stored hash again,
+// without serializing or hashing it.
+static void save_map_tree(SaveWrite* save, LocalMap* local, int32_t* path)
+{
+    SaveBuffer* buf = &save->objects;
+    int32_t depth = local->depth;
+    path[2 * (depth - 1)] = local->parentX;
+    path[2 * (depth - 1) + 1] = local->parentY;
+    
+    MapSaveCache* cache = &local->saved;
+    if (cache->valid && cache->epoch == saveEpoch && 
+        cache->editVersion == local->changes.version && 
+        cache->stateVersion == local->stateVersion && 
+        cache->children == local->children.count)
+    {
+        save_list_section(save, cache->hash, cache->length, 0);
+    }
+    else
+    {
+        size_t section = save_begin_section(buf);
+        int32_t size[2] = { local->width, local->height };
+        savebuf_put(buf, &depth, sizeof(depth));
+        savebuf_put(buf, path, (size_t)depth * 2 * sizeof(int32_t));
+        savebuf_put(buf, size, sizeof(size));
+        savebuf_put(buf, &local->worldTile, 1);
+        savebuf_put(buf, local->explored.words, 
+                    (size_t)local->explored.stride * local->explored.height * sizeof(uint64_t));
+        entity_store_write(&local->entities, buf);
+        save_local_edits(buf, local);
+        SaveObjectRef ref = save_store_section(save, section, SECTION_LOCAL);
+        
+        *cache = (MapSaveCache){ 
+            !buf->failed, local->changes.version, local->stateVersion, 
+            local->children.count, saveEpoch, ref.hash, ref.length 
+        };
+    }
+    
+    for (int i = 0; i < local->children.capacity && !buf->failed; i++)
+    {
+        if (local->children.slots[i].tile != 0) save_map_tree(save, local->children.slots[i].map, path);
+    }
+}
+
+// Last queued save; later saves chain behind it and loads wait for it
+static JobId saveJob = 0;
+
+static SlotStatus save_read_slot(int slot, SaveBuffer* file, SaveReader* manifest, bool* outOfMemory);
+
+// Delete stored sections no slot lists any more (save chain only). Slots
+// that can't be read can't be loaded either, so they keep nothing alive.
+static void save_collect_objects()
+{
+    SaveBuffer keep = { NULL, 0, 0, false };
+    for (int slot = 0; slot < NUM_SAVE_SLOTS; slot++)
+    {
+        SaveBuffer file = { NULL, 0, 0, false };
+        SaveReader manifest;
+        bool outOfMemory = false;
+        SlotStatus status = save_read_slot(slot, &file, &manifest, &outOfMemory);
+        
+        // Without a readable manifest nothing is known to be unused
+        if (outOfMemory) keep.failed = true;
+        
+        SaveObjectRef ref;
+        while (status == SLOT_OK && savebuf_get(&manifest, &ref, sizeof(ref)))
+        {
+            savebuf_put(&keep, &ref.hash, sizeof(ref.hash));
+        }
+        savebuf_free(&file);
+    }
+    
+    if (!keep.failed) store_collect((uint64_t*)keep.data, (int)(keep.size / sizeof(uint64_t)));
+    savebuf_free(&keep);
+}
+
+// Worker job: store the sections the store doesn't have yet, then write
+// the slot file next to its final name and swap it in, so a failed write
+// never costs the previous save
+static void save_write_job(void* data)
+{
+    SaveWrite* save = (SaveWrite*)data;
+    
+    // Fresh sections go out in batches straight from objects; the rest
+    // were stored by an earlier save and must still be there
+    StoreObject* stored = (StoreObject*)mem_alloc(MEM_SAVE, (size_t)save->objectCount * sizeof(StoreObject));
+    if (stored == NULL) return;
+    const SaveObjectRef* refs = (const SaveObjectRef*)save->refs.data;
+    uint8_t* object = save->objects.data;
+    int count = 0;
+    bool listed = true;
+    for (int i = 0; i < save->objectCount && listed; i++)
+    {
+        if (save->fresh.data[i]) {
+            stored[count++] = (StoreObject){ refs[i].hash, object, (size_t)refs[i].length };
+            object += refs[i].length;
+        }
+        else listed = store_has(refs[i].hash);
+    }
+    bool written = listed && store_write(stored, count, save->objects.data, save->objects.size);
+    mem_free(stored);
+    if (!written) return;
+    
+    char filename[50];
+    char temp[60];
+    save_slot_filename(save->slot, filename, sizeof(filename));
+    snprintf(temp, sizeof(temp), "save_%d.tmp", save->slot);
+    
+    FILE* file = fopen(temp, "wb");
+    if (!file) return;
+    
+    bool ok = fwrite(save->file.data, 1, save->file.size, file) == save->file.size;
+    ok = (fclose(file) == 0) && ok;
+    
+    if (ok) ok = store_replace(temp, filename);
+    else remove(temp);
+    save->ok = ok;
+    
+    // What the replaced slot file alone listed can go
+    if (ok) save_collect_objects();
+}
+
+// Main-thread job: report the result and release the image. Only the
+// saved slot changed, and its new file was just written in full, so its
+// status is known without reading anything back.
+static void save_done_job(void* data)
+{
+    SaveWrite* save = (SaveWrite*)data;
+    if (save->ok) saveSlotStatus[save->slot] = SLOT_OK;
+    else {
+        // Maps cached by this save may never have reached the store
+        saveEpoch++;
+        show_status("Save failed");
+    }
+    
+    savebuf_free(&save->objects);
+    savebuf_free(&save->refs);
+    savebuf_free(&save->fresh);
+    savebuf_free(&save->file);
+    mem_free(save);
+}
+
+// Save game to slot; the file is written in the background
+bool save_game_to_slot(int slot)
+{
+    if (worldMap == NULL) return false;
+    
+    SaveWrite* save = (SaveWrite*)mem_calloc(MEM_SAVE, 1, sizeof(SaveWrite));
+    if (save == NULL) return false;
+    save->slot = slot;
+    SaveBuffer* objects = &save->objects;
+    SaveBuffer* buf = &save->file;
+    
+    WorldChunk** chunks = save_world_chunks();
+    if (chunks == NULL) {
+        mem_free(save);
+        return false;
+    }
+    
+    // World grid: tile chars and local map flags, then the explored bits
+    // on their own, as they change far more often than the grid. A sparse
+    // world keeps only the chunks that differ from what the seed makes.
+    size_t section = save_begin_section(objects);
+    if (worldMap->sparse) save_world_edited(objects, chunks);
+    else save_world_grid(objects);
+    save_store_section(save, section, SECTION_WORLD);
+    
+    section = save_begin_section(objects);
+    if (worldMap->sparse) save_world_seen(objects, chunks);
+    else save_world_explored(objects);
+    save_store_section(save, section, SECTION_WORLD_EXPLORED);
+    
+    // Every generated map, local maps and the dungeon floors below them
+    int32_t path[2 * MAP_MAX_DEPTH];
+    for (int i = 0; i < worldMap->count && !objects->failed; i++)
+    {
+        const WorldChunk* chunk = chunks[i];
+        for (int j = 0; j < WORLD_CHUNK * WORLD_CHUNK && !objects->failed; j++)
+        {
+            if (chunk->cells[j].localMap != NULL) save_map_tree(save, chunk->cells[j].localMap, path);
+        }
+    }
+    mem_free(chunks);
+    
+    SaveFileHeader fileHeader = { SAVE_MAGIC, SAVE_VERSION };
+    savebuf_put(buf, &fileHeader, sizeof(fileHeader));
+    
+    // Header: dimensions, player state, then where the player stands on
+    // each level between the world and the current map
+    int32_t header[8] = {
+        currentMapWidth, currentMapHeight,
+        player.x, player.y,
+        localPlayer.x, localPlayer.y,
+        playerStack.depth,
+        save_count_maps(NULL)
+    };
+    section = save_begin_section(buf);
+    savebuf_put(buf, header, sizeof(header));
+    savebuf_put(buf, &worldSeed, sizeof(worldSeed));
+    for (int d = 1; d < playerStack.depth; d++)
+    {
+        int32_t at[2] = { playerStack.levels[d].at.x, playerStack.levels[d].at.y };
+        savebuf_put(buf, at, sizeof(at));
+    }
+    save_end_section(buf, section, SECTION_HEADER);
+    
+    // Manifest: the sections above, by hash, in the order they load
+    section = save_begin_section(buf);
+    savebuf_put(buf, save->refs.data, save->refs.size);
+    save->objectCount = (int)(save->refs.size / sizeof(SaveObjectRef));
+    save_end_section(buf, section, SECTION_MANIFEST);
+    
+    // End marker, a file without one was cut short
+    section = save_begin_section(buf);
+    save_end_section(buf, section, SECTION_END);
+    
+    if (buf->failed || objects->failed || save->refs.failed || save->fresh.failed)
+    {
+        saveEpoch++;
+        savebuf_free(objects);
+        savebuf_free(&save->refs);
+        savebuf_free(&save->fresh);
+        savebuf_free(buf);
+        mem_free(save);
+        show_status("Save failed");
+        return false;
+    }
+    
+    // Write after any earlier save, report back on the main thread
+    JobId write = job_create(save_write_job, save, JOB_NORMAL, false);
+    job_depends_on(write, saveJob);
+    JobId done = job_create(save_done_job, save, JOB_NORMAL, true);
+    job_depends_on(done, write);
+    job_submit(done);
+    job_submit(write);
+    saveJob = done;
+    return true;
+}
+
+// Read the next section header, rejecting impossible lengths
+static bool save_read_section_header(FILE* file, SaveSectionHeader* header)
+{
+    if (fread(header, sizeof(SaveSectionHeader), 1, file) != 1) return false;
+    if (header->type < SECTION_HEADER || header->type > SECTION_END) return false;
+    return header->length <= SAVE_MAX_SECTION_BYTES;
+}
+
+// Read a slot file and verify it: header, manifest and end marker in that
+// order, every checksum intact. manifest is set to the manifest's entries.
+static SlotStatus save_read_slot(int slot, SaveBuffer* file, SaveReader* manifest, bool* outOfMemory)
+{
+    char filename[50];
+    save_slot_filename(slot, filename, sizeof(filename));
+    FILE* in = fopen(filename, "rb");
+    if (!in) return SLOT_EMPTY;
+    
+    fseek(in, 0, SEEK_END);
+    long length = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    if (length < (long)sizeof(SaveFileHeader) || length > (long)SAVE_MAX_SECTION_BYTES) {
+        fclose(in);
+        return SLOT_CORRUPT;
+    }
+    
+    file->data = (uint8_t*)mem_alloc(MEM_SAVE, (size_t)length);
+    if (file->data == NULL) {
+        *outOfMemory = true;
+        fclose(in);
+        return SLOT_CORRUPT;
+    }
+    file->capacity = (size_t)length;
+    file->size = fread(file->data, 1, (size_t)length, in);
+    fclose(in);
+    
+    SaveReader image = { file->data, file->size, 0, false };
+    SaveFileHeader fileHeader;
+    if (!savebuf_get(&image, &fileHeader, sizeof(fileHeader)) ||
+        fileHeader.magic != SAVE_MAGIC || fileHeader.version != SAVE_VERSION) return SLOT_CORRUPT;
+    
+    static const uint32_t order[3] = { SECTION_HEADER, SECTION_MANIFEST, SECTION_END };
+    for (int i = 0; i < 3; i++)
+    {
+        SaveSectionHeader header;
+        if (!savebuf_get(&image, &header, sizeof(header)) || header.type != order[i]) return SLOT_CORRUPT;
+        if (header.length > image.size - image.pos) return SLOT_CORRUPT;
+        if (save_section_crc(header.type, header.length, image.data + image.pos) != header.crc) return SLOT_CORRUPT;
+        
+        if (header.type == SECTION_MANIFEST) *manifest = (SaveReader){ image.data + image.pos, (size_t)header.length, 0, false };
+        image.pos += (size_t)header.length;
+    }
+    return manifest->size % sizeof(SaveObjectRef) == 0 ? SLOT_OK : SLOT_CORRUPT;
+}
+
+// Stream one stored section through a fixed buffer (one per thread, slots
+// are checked in parallel) and verify its checksum
+static bool save_check_object(const SaveObjectRef* ref)
+{
+    static thread_local uint8_t chunk[64 * 1024];
+    FILE* file = store_open(ref->hash);
+    if (!file) return false;
+    
+    SaveSectionHeader header;
+    if (!save_read_section_header(file, &header) || sizeof(header) + header.length != ref->length) {
+        fclose(file);
+        return false;
+    }
+    
+    uint32_t crc = crc32c_update(0, &header.type, sizeof(header.type));
+    crc = crc32c_update(crc, &header.length, sizeof(header.length));
+    uint64_t remaining = header.length;
+    while (remaining > 0)
+    {
+        size_t want = remaining > sizeof(chunk) ? sizeof(chunk) : (size_t)remaining;
+        if (fread(chunk, 1, want, file) != want) break;
+        crc = crc32c_update(crc, chunk, want);
+        remaining -= want;
+    }
+    
+    fclose(file);
+    return remaining == 0 && crc == header.crc;
+}
+
+// Verify every checksum, the slot file's and its stored sections', without
+// building any maps
+SlotStatus save_slot_check(int slot)
+{
+    SaveBuffer file = { NULL, 0, 0, false };
+    SaveReader manifest;
+    bool outOfMemory = false;
+    SlotStatus status = save_read_slot(slot, &file, &manifest, &outOfMemory);
+    
+    SaveObjectRef ref;
+    while (status == SLOT_OK && savebuf_get(&manifest, &ref, sizeof(ref)))
+    {
+        if (!save_check_object(&ref)) status = SLOT_CORRUPT;
+    }
+    
+    savebuf_free(&file);
+    return status;
+}
+
+// Worker job: check one slot, data points at its saveSlotStatus entry
+static void save_slot_check_job(void* data)
+{
+    SlotStatus* status = (SlotStatus*)data;
+    *status = save_slot_check((int)(status - saveSlotStatus));
+}
+
+// Refresh the cached status of every slot, all slots at once. A queued
+// save goes first: its collector deletes objects a check may be reading,
+// and its done job writes the same statuses.
+void refresh_save_slots()
+{
+    job_wait(saveJob);
+    
+    JobId checks[NUM_SAVE_SLOTS];
+    for (int i = 0; i < NUM_SAVE_SLOTS; i++)
+    {
+        checks[i] = job_run(save_slot_check_job, &saveSlotStatus[i], JOB_NORMAL);
+    }
+    for (int i = 0; i < NUM_SAVE_SLOTS; i++)
+    {
+        job_wait(checks[i]);
+    }
+}
+
+// True when any slot holds a loadable save
+bool any_save_loadable()
+{
+    for (int i = 0; i < NUM_SAVE_SLOTS; i++)
+    {
+        if (saveSlotStatus[i] == SLOT_OK) return true;
+    }
+    return false;
+}
+
+// Rebuild one map (at any depth) from its section payload
+static bool load_local_section(SaveReader* reader)
+{
+    int32_t depth;
+    int32_t path[2 * MAP_MAX_DEPTH];
+    if (!savebuf_get(reader, &depth, sizeof(depth)) || depth < 1 || depth >= MAP_MAX_DEPTH ||
+        !savebuf_get(reader, path, (size_t)depth * 2 * sizeof(int32_t))) return false;
+    
+    // Walk down from the world; parents were saved before their children
+    LocalMap* parent = NULL;
+    for (int d = 0; d < depth; d++)
+    {
+        int x = path[2 * d], y = path[2 * d + 1];
+        int parentWidth = parent ? parent->width : currentMapWidth;
+        int parentHeight = parent ? parent->height : currentMapHeight;
+        if (x < 0 || y < 0 || x >= parentWidth || y >= parentHeight) return false;
+        if (d + 1 < depth && (parent = map_child(parent, x, y)) == NULL) return false;
+    }
+    
+    int x = path[2 * (depth - 1)], y = path[2 * (depth - 1) + 1];
+    int32_t size[2];
+    if (!savebuf_get(reader, size, sizeof(size))) return false;
+    int width = size[0], height = size[1];
+    if (width < 1 || height < 1 || width > SAVE_MAX_MAP_SIDE || height > SAVE_MAX_MAP_SIDE) return false;
+    if (map_child(parent, x, y) != NULL) return false;
+    
+    LocalMap* local = local_map_alloc(width, height);
+    if (local == NULL) return false;
+    if (!map_set_child(parent, x, y, local)) {
+        local_map_destroy(local);
+        return false;
+    }
+    
+    // Generated tiles first, the saved edits go on top
+    if (!savebuf_get(reader, &local->worldTile, 1)) return false;
+    local->depth = depth;
+    local->seed = map_child_seed(parent, x, y);
+    local_map_generate_tiles(local);
+    
+    if (!savebuf_get(reader, local->explored.words, 
+                     (size_t)local->explored.stride * local->explored.height * sizeof(uint64_t)) ||
+        !entity_store_read(&local->entities, reader, local->width, local->height) ||
+        !load_local_edits(reader, local))
+    {
+        return false;
+    }
+    
+    local_map_build_passable(local);
+    local_map_build_opaque(local);
+    local_map_build_fields(local);
+    return true;
+}
+
+// Small world grid saved by save_world_grid; every local map starts
+// unloaded
+static bool load_world_grid(SaveReader* reader)
+{
+    uint8_t row[WORLD_VIEW_SIDE];
+    for (int y = 0; y < currentMapHeight; y++)
+    {
+        if (!savebuf_get(reader, row, currentMapWidth)) return false;
+        for (int x = 0; x < currentMapWidth; x++) {
+            world_chunk(x, y)->cells[world_chunk_cell(x, y)].worldTile = (char)row[x];
+        }
+    }
+    for (int y = 0; y < currentMapHeight; y++)
+    {
+        if (!savebuf_get(reader, row, currentMapWidth)) return false;
+        for (int x = 0; x < currentMapWidth; x++) {
+            world_chunk(x, y)->cells[world_chunk_cell(x, y)].hasLocalMap = row[x] != 0;
+        }
+    }
+    return true;
+}
+
+// Small world explored bits saved by save_world_explored
+static bool load_world_explored(SaveReader* reader)
+{
+    for (int y = 0; y < currentMapHeight; y++)
+    {
+        for (int x = 0; x < currentMapWidth; x += WORLD_CHUNK)
+        {
+            if (!savebuf_get(reader, &world_chunk(x, y)->explored[y & (WORLD_CHUNK - 1)], sizeof(uint64_t))) return false;
+        }
+    }
+    return true;
+}
+
+// Chunk at a saved chunk position, stored if it wasn't (NULL if the
+// position is outside the world or memory ran out)
+static WorldChunk* load_world_chunk(SaveReader* reader)
+{
+    int32_t at[2];
+    if (!savebuf_get(reader, at, sizeof(at))) return NULL;
+    if (at[0] < 0 || at[1] < 0 ||
+        at[0] >= (currentMapWidth + WORLD_CHUNK - 1) / WORLD_CHUNK ||
+        at[1] >= (currentMapHeight + WORLD_CHUNK - 1) / WORLD_CHUNK) return NULL;
+    return world_chunk_store(at[0] * WORLD_CHUNK, at[1] * WORLD_CHUNK);
+}
+
+// Sparse world chunks saved by save_world_edited
+static bool load_world_edited(SaveReader* reader)
+{
+    uint32_t count;
+    if (!savebuf_get(reader, &count, sizeof(count))) return false;
+    
+    uint8_t bytes[WORLD_CHUNK * WORLD_CHUNK];
+    for (uint32_t i = 0; i < count; i++)
+    {
+        WorldChunk* chunk = load_world_chunk(reader);
+        if (chunk == NULL || !savebuf_get(reader, bytes, sizeof(bytes))) return false;
+        for (int j = 0; j < WORLD_CHUNK * WORLD_CHUNK; j++) chunk->cells[j].worldTile = (char)bytes[j];
+        if (!savebuf_get(reader, bytes, sizeof(bytes))) return false;
+        for (int j = 0; j < WORLD_CHUNK * WORLD_CHUNK; j++) chunk->cells[j].hasLocalMap = bytes[j] != 0;
+        chunk->edited = true;
+    }
+    return true;
+}
+
+// Sparse world explored bits saved by save_world_seen
+static bool load_world_seen(SaveReader* reader)
+{
+    uint32_t count;
+    if (!savebuf_get(reader, &count, sizeof(count))) return false;
+    
+    for (uint32_t i = 0; i < count; i++)
+    {
+        WorldChunk* chunk = load_world_chunk(reader);
+        if (chunk == NULL || !savebuf_get(reader, chunk->explored, sizeof(chunk->explored))) return false;
+    }
+    return true;
+}
+
+// A save read back into one image, the slot file's sections followed by
+// the stored ones, and verified by a worker
+typedef struct {
+    int slot;
+    SaveBuffer file;
+    SlotStatus status;
+    bool outOfMemory;
+} SaveRead;
+
+// Check a stored section read into the image is the one asked for
+static bool save_verify_object(const SaveObjectRef* ref, const uint8_t* at)
+{
+    SaveSectionHeader header;
+    memcpy(&header, at, sizeof(header));
+    return header.type >= SECTION_WORLD && header.type <= SECTION_LOCAL &&
+           sizeof(header) + header.length == ref->length &&
+           save_section_crc(header.type, header.length, at + sizeof(header)) == header.crc &&
+           store_hash(at, (size_t)ref->length) == ref->hash;
+}
+
+// Worker job: read the slot file and every section it lists, verifying
+// each checksum
+static void save_read_job(void* data)
+{
+    SaveRead* read = (SaveRead*)data;
+    
+    SaveBuffer* image = &read->file;
+    SaveReader manifest;
+    read->status = save_read_slot(read->slot, image, &manifest, &read->outOfMemory);
+    if (read->status != SLOT_OK) return;
+    
+    // Keep the header and manifest, the stored sections go after them
+    image->size = (size_t)(manifest.data + manifest.size - image->data);
+    size_t manifestAt = (size_t)(manifest.data - image->data);
+    int count = (int)(manifest.size / sizeof(SaveObjectRef));
+    
+    // Room for every section at once, so the reads can all be in flight
+    size_t total = 0;
+    SaveObjectRef ref;
+    while (savebuf_get(&manifest, &ref, sizeof(ref)))
+    {
+        if (ref.length < sizeof(SaveSectionHeader) || ref.length > sizeof(SaveSectionHeader) + SAVE_MAX_SECTION_BYTES) {
+            read->status = SLOT_CORRUPT;
+            return;
+        }
+        total += (size_t)ref.length;
+    }
+    size_t objectsAt = image->size;
+    StoreObject* objects = (StoreObject*)mem_alloc(MEM_SAVE, (size_t)count * sizeof(StoreObject));
+    if (objects == NULL || savebuf_extend(image, total) == NULL) {
+        mem_free(objects);
+        read->outOfMemory = true;
+        read->status = SLOT_CORRUPT;
+        return;
+    }
+    
+    const uint8_t* refs = image->data + manifestAt;
+    size_t at = objectsAt;
+    for (int i = 0; i < count; i++)
+    {
+        memcpy(&ref, refs + i * sizeof(ref), sizeof(ref));
+        objects[i] = (StoreObject){ ref.hash, image->data + at, (size_t)ref.length };
+        at += (size_t)ref.length;
+    }
+    
+    bool ok = store_read(objects, count, image->data + objectsAt, total);
+    for (int i = 0; i < count && ok; i++)
+    {
+        memcpy(&ref, refs + i * sizeof(ref), sizeof(ref));
+        ok = save_verify_object(&ref, objects[i].data);
+    }
+    mem_free(objects);
+    if (!ok) {
+        read->status = SLOT_CORRUPT;
+        return;
+    }
+    
+    size_t section = save_begin_section(image);
+    save_end_section(image, section, SECTION_END);
+    if (image->failed) {
+        read->outOfMemory = true;
+        read->status = SLOT_CORRUPT;
+    }
+}
+
+// Load game from slot
+bool load_game_from_slot(int slot)
+{
+    // A save still being written may be the one asked for
+    job_wait(saveJob);
+    
+    // One read of the file, verified before touching the current game
+    SaveRead read = { slot, { NULL, 0, 0, false }, SLOT_CORRUPT, false };
+    job_wait(job_run(save_read_job, &read, JOB_HIGH));
+    
+    if (read.status != SLOT_OK)
+    {
+        savebuf_free(&read.file);
+        show_status(read.outOfMemory ? "Memory budget reached - cannot load this save" 
+                                     : "Save file is damaged");
+        refresh_save_slots();
+        return false;
+    }
+    
+    // Build the saved game beside the running one, which is only torn down
+    // once every section has loaded (living terrain reads every map)
+    sim_cancel();
+    WorldStash previous;
+    world_stash(&previous);
+    
+    bool ok = true;
+    bool haveHeader = false, haveWorld = false, finished = false;
+    int32_t header[8] = { 0 };
+    int32_t stackAt[2 * MAP_MAX_DEPTH];
+    SaveSectionHeader section;
+    SaveReader image = { read.file.data, read.file.size, sizeof(SaveFileHeader), false };
+    
+    while (ok && !finished && savebuf_get(&image, &section, sizeof(section)))
+    {
+        // Lengths and checksums were verified by save_read_job
+        SaveReader reader = { image.data + image.pos, (size_t)section.length, 0, false };
+        image.pos += (size_t)section.length;
+        
+        switch (section.type)
+        {
+            case SECTION_HEADER:
+                ok = savebuf_get(&reader, header, sizeof(header)) &&
+                     savebuf_get(&reader, &worldSeed, sizeof(worldSeed)) &&
+                     header[0] >= 1 && header[1] >= 1 &&
+                     header[0] <= SAVE_MAX_WORLD_SIDE && header[1] <= SAVE_MAX_WORLD_SIDE &&
+                     header[6] >= 0 && header[6] < MAP_MAX_DEPTH &&
+                     (header[6] < 2 || savebuf_get(&reader, stackAt, (size_t)(header[6] - 1) * 2 * sizeof(int32_t))) &&
+                     world_alloc(header[0], header[1]);
+                haveHeader = ok;
+                break;
+            
+            case SECTION_MANIFEST:
+                // The sections it lists follow it in the image
+                break;
+            
+            case SECTION_WORLD:
+                if (!haveHeader) {
+                    ok = false;
+                    break;
+                }
+                ok = worldMap->sparse ? load_world_edited(&reader) : load_world_grid(&reader);
+                haveWorld = ok;
+                break;
+            
+            case SECTION_WORLD_EXPLORED:
+                ok = haveWorld && (worldMap->sparse ? load_world_seen(&reader) : load_world_explored(&reader));
+                break;
+            
+            case SECTION_LOCAL:
+                ok = haveWorld && load_local_section(&reader);
+                break;
+            
+            case SECTION_END:
+                finished = true;
+                break;
+        }
+    }
+    
+    savebuf_free(&read.file);
+    
+    // Player must stand inside the loaded world
+    if (ok && finished && haveWorld)
+    {
+        player.x = header[2];
+        player.y = header[3];
+        localPlayer.x = header[4];
+        localPlayer.y = header[5];
+        
+        // Rebuild the stack: the world position, the saved positions on
+        // the levels in between, and the live position on the deepest one
+        int depth = header[6];
+        Player at[MAP_MAX_DEPTH];
+        at[0] = player;
+        for (int d = 1; d < depth; d++)
+        {
+            at[d].x = stackAt[2 * (d - 1)];
+            at[d].y = stackAt[2 * (d - 1) + 1];
+        }
+        at[depth] = depth > 0 ? localPlayer : player;
+        
+        player_stack_reset();
+        for (int d = 0; d <= depth && ok; d++)
+        {
+            LocalMap* map = d > 0 ? map_child(playerStack.levels[d - 1].map, at[d - 1].x, at[d - 1].y) : NULL;
+            int width = map ? map->width : currentMapWidth;
+            int height = map ? map->height : currentMapHeight;
+            ok = (d == 0 || map != NULL) && at[d].x >= 0 && at[d].y >= 0 && at[d].x < width && at[d].y < height;
+            playerStack.levels[d].map = map;
+            if (d > 0 && d < depth) playerStack.levels[d].at = at[d];
+        }
+        playerStack.depth = depth;
+    }
+    
+    if (!ok || !finished || !haveWorld)
+    {
+        // Drop what was loaded and carry on with the game as it was
+        WorldStash partial;
+        world_stash(&partial);
+        world_release(&partial);
+        world_unstash(&previous);
+        show_status("Save file could not be loaded");
+        return false;
+    }
+    world_release(&previous);
+    
+    isInLocalMap = playerStack.depth > 0;
+    world_view_center(player.x, player.y);
+    world_reserve_scratch();
+    
+    // Setup camera
+    init_camera();
+    currentState = STATE_PLAYING;
+    
+    return true;
+}
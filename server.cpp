@@ -0,0 +1,1151 @@
+#include "project.h"
+#include <chrono>
+#include <thread>
+
+#if defined(_WIN32)
+    // Keep windows.h from redefining raylib names (Rectangle, DrawText, ...)
+    #define NOGDI
+    #define NOUSER
+    #define WIN32_LEAN_AND_MEAN
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    typedef SOCKET NetSocket;
+    #define NET_INVALID INVALID_SOCKET
+    #define net_close closesocket
+    #define net_would_block() (WSAGetLastError() == WSAEWOULDBLOCK)
+#else
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <arpa/inet.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <errno.h>
+    #include <signal.h>
+    typedef int NetSocket;
+    #define NET_INVALID -1
+    #define net_close close
+    #define net_would_block() (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS)
+#endif
+
+// Headless authoritative server. The world and local maps are the game's
+// own (generate_world_map, generate_local_map_at); every connected client
+// walks its own player over them. A client gets the world grid once, the
+// chunks of its local map that come into view, and then per tick only the
+// tiles and players that changed since what it was last sent. The server
+// keeps a shadow of each client's view to diff against.
+//
+// Every frame is a type byte and a uint32 payload length. Counts and
+// offsets inside payloads are LEB128 varints.
+
+// Server -> client
+enum {
+    MSG_WELCOME = 1,    // u16 id, i32 width, i32 height, u32 tick rate
+    MSG_WORLD,          // RLE world tiles, then a bit per tile: has a local map
+    MSG_ENTER,          // i32 world x, y, i32 local width, height
+    MSG_EXIT,           // Back on the world map
+    MSG_CHUNK,          // u16 chunk x, y, RLE chunk tiles
+    MSG_DELTA,          // u8 map (0 world, 1 local), runs of (skip, count, tiles)
+    MSG_PLAYERS,        // u8 count, then (u16 id, u8 here, i16 x, i16 y)
+    MSG_CHECK,          // u32 CRC32C of the world view, u32 of the local view
+    MSG_PONG,           // Echo of a ping, sent on the tick that handled it
+    
+    // Client -> server
+    MSG_ACTION = 32,    // u8 action
+    MSG_PING            // f64 client clock in ms, echoed back
+};
+
+// Player actions a client can ask for
+enum {
+    ACTION_RIGHT,
+    ACTION_LEFT,
+    ACTION_UP,
+    ACTION_DOWN,
+    ACTION_ENTER,
+    ACTION_EXIT
+};
+
+#define FRAME_HEADER 5
+
+// Byte queue from MEM_NET, grown on demand up to a limit. Past the limit,
+// or over the memory budget, it takes no more bytes and is marked failed.
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+    size_t limit;
+    bool failed;
+} NetBuffer;
+
+// Most recent samples of a timing, in a ring; enough for timing_report
+typedef struct {
+    double ms[NET_TIMING_WINDOW];
+    uint64_t count;                 // Samples taken in all
+} NetTimings;
+
+// One connected client and the server's copy of what it has seen
+typedef struct {
+    NetSocket socket;
+    bool active;
+    int x, y;                       // World position
+    bool inLocal;
+    int localX, localY;
+    
+    NetBuffer in;                   // Received, not yet parsed
+    NetBuffer out;                  // Queued, not yet sent
+    
+    uint8_t* worldShadow;           // World tiles as last sent
+    uint8_t* localShadow;           // Local tiles as last sent (sent chunks only)
+    uint8_t* sentChunks;            // One byte per chunk of the local map
+    
+    int16_t known[SERVER_MAX_CLIENTS][3];   // Last sent (here, x, y) per player
+    
+    uint64_t bytesSent;
+    size_t maxTickBytes;
+    int ticks;
+} ServerClient;
+
+static ServerClient clients[SERVER_MAX_CLIENTS];
+static volatile bool serverQuit = false;
+
+// ---------------------------------------------------------------------------
+// Sockets
+
+static bool net_startup()
+{
+#if defined(_WIN32)
+    WSADATA wsa;
+    return WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+#else
+    signal(SIGPIPE, SIG_IGN);
+    return true;
+#endif
+}
+
+static void net_cleanup()
+{
+#if defined(_WIN32)
+    WSACleanup();
+#endif
+}
+
+static void net_set_nonblocking(NetSocket s)
+{
+#if defined(_WIN32)
+    u_long on = 1;
+    ioctlsocket(s, FIONBIO, &on);
+#else
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+// Small updates go out now, not when Nagle decides
+static void net_set_nodelay(NetSocket s)
+{
+    int on = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+}
+
+// "7777" and "host:7777" are TCP, anything with a '/' is a Unix socket path
+static bool net_is_unix(const char* address)
+{
+    return strchr(address, '/') != NULL;
+}
+
+static bool net_tcp_address(const char* address, sockaddr_in* addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    
+    const char* colon = strrchr(address, ':');
+    const char* port = colon ? colon + 1 : address;
+    if (colon)
+    {
+        char host[64];
+        size_t length = (size_t)(colon - address);
+        if (length >= sizeof(host)) return false;
+        memcpy(host, address, length);
+        host[length] = 0;
+        if (inet_pton(AF_INET, host, &addr->sin_addr) != 1) return false;
+    }
+    
+    int value = atoi(port);
+    if (value <= 0 || value > 65535) return false;
+    addr->sin_port = htons((uint16_t)value);
+    return true;
+}
+
+// Listening socket for an address (NET_INVALID on failure)
+static NetSocket net_listen(const char* address)
+{
+#if !defined(_WIN32)
+    if (net_is_unix(address))
+    {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(address) >= sizeof(addr.sun_path)) return NET_INVALID;
+        strcpy(addr.sun_path, address);
+        unlink(address);
+        
+        NetSocket s = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (s == NET_INVALID) return NET_INVALID;
+        if (bind(s, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(s, SERVER_MAX_CLIENTS) != 0) {
+            net_close(s);
+            return NET_INVALID;
+        }
+        net_set_nonblocking(s);
+        return s;
+    }
+#endif
+    
+    sockaddr_in addr;
+    if (!net_tcp_address(address, &addr)) return NET_INVALID;
+    
+    NetSocket s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == NET_INVALID) return NET_INVALID;
+    int on = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+    if (bind(s, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(s, SERVER_MAX_CLIENTS) != 0) {
+        net_close(s);
+        return NET_INVALID;
+    }
+    net_set_nonblocking(s);
+    return s;
+}
+
+// Connected socket for an address (NET_INVALID on failure)
+static NetSocket net_connect(const char* address)
+{
+    NetSocket s = NET_INVALID;
+
+#if !defined(_WIN32)
+    if (net_is_unix(address))
+    {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(address) >= sizeof(addr.sun_path)) return NET_INVALID;
+        strcpy(addr.sun_path, address);
+        
+        s = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (s == NET_INVALID) return NET_INVALID;
+        if (connect(s, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            net_close(s);
+            return NET_INVALID;
+        }
+        net_set_nonblocking(s);
+        return s;
+    }
+#endif
+    
+    sockaddr_in addr;
+    if (!net_tcp_address(address, &addr)) return NET_INVALID;
+    s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == NET_INVALID) return NET_INVALID;
+    if (connect(s, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        net_close(s);
+        return NET_INVALID;
+    }
+    net_set_nodelay(s);
+    net_set_nonblocking(s);
+    return s;
+}
+
+// ---------------------------------------------------------------------------
+// Buffers
+
+static void net_buffer_init(NetBuffer* buf, size_t limit)
+{
+    memset(buf, 0, sizeof(NetBuffer));
+    buf->limit = limit;
+}
+
+// Release the bytes, keeping the limit for reuse
+static void net_buffer_free(NetBuffer* buf)
+{
+    mem_free(buf->data);
+    net_buffer_init(buf, buf->limit);
+}
+
+// Room for size more bytes at the end (NULL once the buffer failed)
+static uint8_t* net_extend(NetBuffer* buf, size_t size)
+{
+    if (buf->failed) return NULL;
+    if (size > buf->limit - buf->size) {
+        buf->failed = true;
+        return NULL;
+    }
+    
+    if (buf->size + size > buf->capacity)
+    {
+        size_t capacity = buf->capacity ? buf->capacity : 4096;
+        while (capacity < buf->size + size) capacity *= 2;
+        if (capacity > buf->limit) capacity = buf->limit;
+        uint8_t* grown = (uint8_t*)mem_realloc(MEM_NET, buf->data, capacity);
+        if (grown == NULL) {
+            buf->failed = true;
+            return NULL;
+        }
+        buf->data = grown;
+        buf->capacity = capacity;
+    }
+    
+    uint8_t* at = buf->data + buf->size;
+    buf->size += size;
+    return at;
+}
+
+// Drop bytes from the front once they are sent or parsed
+static void net_consume(NetBuffer* buf, size_t size)
+{
+    memmove(buf->data, buf->data + size, buf->size - size);
+    buf->size -= size;
+}
+
+static void net_time(NetTimings* timings, double ms)
+{
+    timings->ms[timings->count++ % NET_TIMING_WINDOW] = ms;
+}
+
+static void net_timing_report(const char* label, NetTimings* timings)
+{
+    int count = timings->count < NET_TIMING_WINDOW ? (int)timings->count : NET_TIMING_WINDOW;
+    if (timings->count > NET_TIMING_WINDOW) {
+        printf("%s timings cover the last %d of %llu\n", label, count, (unsigned long long)timings->count);
+    }
+    timing_report(label, timings->ms, count);
+}
+
+// Send as much of the queue as the socket takes (false: connection lost)
+static bool net_flush(NetSocket s, NetBuffer* out)
+{
+    size_t sent = 0;
+    while (sent < out->size)
+    {
+        int n = (int)send(s, (const char*)out->data + sent, (int)(out->size - sent), 0);
+        if (n > 0) {
+            sent += (size_t)n;
+            continue;
+        }
+        if (n < 0 && net_would_block()) break;
+        return false;
+    }
+    net_consume(out, sent);
+    return true;
+}
+
+// Read whatever has arrived (false: connection closed, or more arrived
+// than the queue may hold)
+static bool net_receive(NetSocket s, NetBuffer* in)
+{
+    uint8_t chunk[4096];
+    for (;;)
+    {
+        int n = (int)recv(s, (char*)chunk, sizeof(chunk), 0);
+        if (n > 0) {
+            uint8_t* at = net_extend(in, (size_t)n);
+            if (at == NULL) return false;
+            memcpy(at, chunk, (size_t)n);
+            continue;
+        }
+        if (n < 0 && net_would_block()) return true;
+        return false;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Encoding
+
+static void put_bytes(NetBuffer* out, const void* data, size_t size)
+{
+    uint8_t* at = net_extend(out, size);
+    if (at != NULL) memcpy(at, data, size);
+}
+
+static void put_byte(NetBuffer* out, uint8_t value)
+{
+    put_bytes(out, &value, 1);
+}
+
+static void put_varint(NetBuffer* out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        put_byte(out, (uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    put_byte(out, (uint8_t)value);
+}
+
+// Start a frame; returns where its header sits
+static size_t frame_begin(NetBuffer* out, uint8_t type)
+{
+    size_t at = out->size;
+    uint8_t* header = net_extend(out, FRAME_HEADER);
+    if (header != NULL) header[0] = type;
+    return at;
+}
+
+// Patch the payload length in once the frame is complete
+static void frame_end(NetBuffer* out, size_t at)
+{
+    if (out->failed) return;
+    uint32_t length = (uint32_t)(out->size - at - FRAME_HEADER);
+    memcpy(out->data + at + 1, &length, 4);
+}
+
+// Tiles as (count, byte) runs; terrain is mostly long runs
+static void put_rle(NetBuffer* out, const uint8_t* tiles, size_t size)
+{
+    size_t i = 0;
+    while (i < size && !out->failed)
+    {
+        size_t run = 1;
+        while (i + run < size && tiles[i + run] == tiles[i]) run++;
+        put_varint(out, (uint32_t)run);
+        put_byte(out, tiles[i]);
+        i += run;
+    }
+}
+
+// Bounds-checked cursor over a received payload
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+    bool failed;
+} NetReader;
+
+static bool get_bytes(NetReader* reader, void* data, size_t size)
+{
+    if (reader->failed || size > reader->size - reader->pos) {
+        reader->failed = true;
+        return false;
+    }
+    memcpy(data, reader->data + reader->pos, size);
+    reader->pos += size;
+    return true;
+}
+
+static uint32_t get_varint(NetReader* reader)
+{
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        uint8_t byte;
+        if (!get_bytes(reader, &byte, 1)) return 0;
+        value |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    reader->failed = true;
+    return 0;
+}
+
+static bool get_rle(NetReader* reader, uint8_t* tiles, size_t size)
+{
+    size_t i = 0;
+    while (i < size)
+    {
+        uint32_t run = get_varint(reader);
+        uint8_t value;
+        if (!get_bytes(reader, &value, 1) || run == 0 || run > size - i) return false;
+        memset(tiles + i, value, run);
+        i += run;
+    }
+    return true;
+}
+
+// Pull the next complete frame off a receive queue
+static bool frame_next(NetBuffer* in, size_t* pos, uint8_t* type, NetReader* payload)
+{
+    if (in->size - *pos < FRAME_HEADER) return false;
+    uint32_t length;
+    memcpy(&length, in->data + *pos + 1, 4);
+    if (in->size - *pos - FRAME_HEADER < length) return false;
+    
+    *type = in->data[*pos];
+    *payload = (NetReader){ in->data + *pos + FRAME_HEADER, length, 0, false };
+    *pos += FRAME_HEADER + length;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Delta runs: changed tiles only, each run as (skip since last run, count,
+// new tiles). Compared segment by segment, in increasing offset order.
+
+typedef struct {
+    NetBuffer body;         // Capped like a client's queue
+    uint32_t runs;
+    size_t end;             // Offset just past the last run
+} DeltaWriter;
+
+static void delta_begin(DeltaWriter* delta)
+{
+    delta->body.size = 0;
+    delta->body.failed = false;
+    delta->runs = 0;
+    delta->end = 0;
+}
+
+// Diff one segment, copying changes into the shadow as they are written
+static void delta_segment(DeltaWriter* delta, size_t offset, const uint8_t* current,
+                          uint8_t* shadow, size_t length)
+{
+    if (memcmp(current, shadow, length) == 0) return;
+    
+    size_t i = 0;
+    while (i < length)
+    {
+        if (current[i] == shadow[i]) {
+            i++;
+            continue;
+        }
+        size_t start = i;
+        while (i < length && current[i] != shadow[i]) i++;
+        
+        put_varint(&delta->body, (uint32_t)(offset + start - delta->end));
+        put_varint(&delta->body, (uint32_t)(i - start));
+        put_bytes(&delta->body, current + start, i - start);
+        memcpy(shadow + start, current + start, i - start);
+        delta->end = offset + i;
+        delta->runs++;
+    }
+}
+
+// Queue the runs as one MSG_DELTA frame (nothing when no tile changed).
+// The shadow already holds runs that didn't fit, so the queue fails too.
+static void delta_send(DeltaWriter* delta, NetBuffer* out, uint8_t map)
+{
+    if (delta->body.failed) out->failed = true;
+    if (delta->runs == 0) return;
+    size_t frame = frame_begin(out, MSG_DELTA);
+    put_byte(out, map);
+    put_varint(out, delta->runs);
+    put_bytes(out, delta->body.data, delta->body.size);
+    frame_end(out, frame);
+}
+
+// Apply a MSG_DELTA payload to a tile array
+static bool delta_apply(NetReader* reader, uint8_t* tiles, size_t size)
+{
+    uint32_t runs = get_varint(reader);
+    size_t pos = 0;
+    for (uint32_t r = 0; r < runs && !reader->failed; r++)
+    {
+        pos += get_varint(reader);
+        uint32_t count = get_varint(reader);
+        if (pos > size || count > size - pos) return false;
+        if (!get_bytes(reader, tiles + pos, count)) return false;
+        pos += count;
+    }
+    return !reader->failed;
+}
+
+// ---------------------------------------------------------------------------
+// Server
+
+static double server_now_ms()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static const LocalMap* server_client_local(const ServerClient* client)
+{
+    return client->inLocal ? map_child(NULL, client->x, client->y) : NULL;
+}
+
+static void server_drop(ServerClient* client, int id)
+{
+    printf("server: client %d left after %d ticks, %llu bytes (%.1f B/tick, max %zu)\n", id,
+           client->ticks, (unsigned long long)client->bytesSent,
+           client->ticks ? (double)client->bytesSent / client->ticks : 0.0, client->maxTickBytes);
+    
+    net_close(client->socket);
+    mem_free(client->worldShadow);
+    mem_free(client->localShadow);
+    mem_free(client->sentChunks);
+    net_buffer_free(&client->in);
+    net_buffer_free(&client->out);
+    client->worldShadow = NULL;
+    client->localShadow = NULL;
+    client->sentChunks = NULL;
+    client->active = false;
+}
+
+// New connection: welcome it and send the whole world grid
+static void server_join(NetSocket s)
+{
+    int id = -1;
+    for (int i = 0; i < SERVER_MAX_CLIENTS && id < 0; i++) {
+        if (!clients[i].active) id = i;
+    }
+    if (id < 0) {
+        net_close(s);
+        return;
+    }
+    
+    ServerClient* client = &clients[id];
+    size_t cells = (size_t)currentMapWidth * currentMapHeight;
+    client->worldShadow = (uint8_t*)mem_alloc(MEM_NET, cells);
+    if (client->worldShadow == NULL) {
+        net_close(s);
+        return;
+    }
+    
+    net_set_nonblocking(s);
+    net_set_nodelay(s);
+    client->socket = s;
+    client->active = true;
+    client->x = 2;
+    client->y = 2;
+    client->inLocal = false;
+    client->localShadow = NULL;
+    client->sentChunks = NULL;
+    net_buffer_init(&client->in, SERVER_MAX_INPUT);
+    net_buffer_init(&client->out, SERVER_MAX_BACKLOG);
+    client->bytesSent = 0;
+    client->maxTickBytes = 0;
+    client->ticks = 0;
+    memset(client->known, 0, sizeof(client->known));
+    
+    NetBuffer* out = &client->out;
+    size_t frame = frame_begin(out, MSG_WELCOME);
+    uint16_t clientId = (uint16_t)id;
+    int32_t size[2] = { currentMapWidth, currentMapHeight };
+    uint32_t tickRate = TICK_RATE;
+    put_bytes(out, &clientId, sizeof(clientId));
+    put_bytes(out, size, sizeof(size));
+    put_bytes(out, &tickRate, sizeof(tickRate));
+    frame_end(out, frame);
+    
+    // World grid, which also seeds the shadow the deltas diff against (the
+    // server only runs whole-world views, so the view's tiles are all of it)
+    memcpy(client->worldShadow, worldMap->tiles, cells);
+    frame = frame_begin(out, MSG_WORLD);
+    put_rle(out, client->worldShadow, cells);
+    uint8_t* flags = net_extend(out, (cells + 7) / 8);
+    if (flags != NULL)
+    {
+        memset(flags, 0, (cells + 7) / 8);
+        for (size_t i = 0; i < cells; i++) {
+            if (world_cell((int)(i % currentMapWidth), (int)(i / currentMapWidth)).hasLocalMap) flags[i / 8] |= 1 << (i % 8);
+        }
+    }
+    frame_end(out, frame);
+    
+    printf("server: client %d joined\n", id);
+}
+
+// Apply one action to a client's player, with the game's movement rules
+static void server_action(ServerClient* client, uint8_t action)
+{
+    static const int dx[4] = { 1, -1, 0, 0 };
+    static const int dy[4] = { 0, 0, -1, 1 };
+    
+    if (action <= ACTION_DOWN)
+    {
+        if (client->inLocal)
+        {
+            const LocalMap* local = server_client_local(client);
+            int x = client->localX + dx[action];
+            int y = client->localY + dy[action];
+            if (x >= 0 && y >= 0 && x < local->width && y < local->height && bitgrid_get(&local->passable, x, y)) {
+                client->localX = x;
+                client->localY = y;
+            }
+        }
+        else
+        {
+            int x = client->x + dx[action];
+            int y = client->y + dy[action];
+            if (x >= 0 && y >= 0 && x < currentMapWidth && y < currentMapHeight && world_passable(x, y)) {
+                client->x = x;
+                client->y = y;
+            }
+        }
+    }
+    else if (action == ACTION_ENTER && !client->inLocal && world_cell(client->x, client->y).hasLocalMap)
+    {
+        if (map_child(NULL, client->x, client->y) == NULL) generate_local_map_at(client->x, client->y);
+        const LocalMap* local = map_child(NULL, client->x, client->y);
+        if (local == NULL) return;
+        
+        client->inLocal = true;
+        client->localX = local->width / 2;
+        client->localY = local->height / 2;
+        
+        // Fresh view of this map: no chunks sent yet
+        int chunksX = (local->width + SERVER_CHUNK - 1) / SERVER_CHUNK;
+        int chunksY = (local->height + SERVER_CHUNK - 1) / SERVER_CHUNK;
+        mem_free(client->localShadow);
+        mem_free(client->sentChunks);
+        client->localShadow = (uint8_t*)mem_calloc(MEM_NET, (size_t)local->width * local->height, 1);
+        client->sentChunks = (uint8_t*)mem_calloc(MEM_NET, (size_t)chunksX * chunksY, 1);
+        if (client->localShadow == NULL || client->sentChunks == NULL) {
+            client->inLocal = false;
+            return;
+        }
+        
+        size_t frame = frame_begin(&client->out, MSG_ENTER);
+        int32_t place[4] = { client->x, client->y, local->width, local->height };
+        put_bytes(&client->out, place, sizeof(place));
+        frame_end(&client->out, frame);
+    }
+    else if (action == ACTION_EXIT && client->inLocal)
+    {
+        client->inLocal = false;
+        size_t frame = frame_begin(&client->out, MSG_EXIT);
+        frame_end(&client->out, frame);
+    }
+}
+
+// Read and handle everything a client sent (false: it disconnected)
+static bool server_receive(ServerClient* client)
+{
+    if (!net_receive(client->socket, &client->in)) return false;
+    
+    size_t pos = 0;
+    uint8_t type;
+    NetReader payload;
+    while (frame_next(&client->in, &pos, &type, &payload))
+    {
+        if (type == MSG_ACTION)
+        {
+            uint8_t action;
+            if (get_bytes(&payload, &action, 1)) server_action(client, action);
+        }
+        else if (type == MSG_PING)
+        {
+            size_t frame = frame_begin(&client->out, MSG_PONG);
+            put_bytes(&client->out, payload.data, payload.size);
+            frame_end(&client->out, frame);
+        }
+    }
+    net_consume(&client->in, pos);
+    return true;
+}
+
+// Local chunks newly in view go out whole
+static void server_send_chunks(ServerClient* client, const LocalMap* local)
+{
+    int chunksX = (local->width + SERVER_CHUNK - 1) / SERVER_CHUNK;
+    int chunksY = (local->height + SERVER_CHUNK - 1) / SERVER_CHUNK;
+    int centerX = client->localX / SERVER_CHUNK;
+    int centerY = client->localY / SERVER_CHUNK;
+    
+    for (int cy = centerY - SERVER_VIEW_CHUNKS; cy <= centerY + SERVER_VIEW_CHUNKS; cy++)
+    {
+        for (int cx = centerX - SERVER_VIEW_CHUNKS; cx <= centerX + SERVER_VIEW_CHUNKS; cx++)
+        {
+            if (cx < 0 || cy < 0 || cx >= chunksX || cy >= chunksY) continue;
+            if (client->sentChunks[(size_t)cy * chunksX + cx]) continue;
+            client->sentChunks[(size_t)cy * chunksX + cx] = 1;
+            
+            // Copy into the shadow, then send the shadow's rows
+            int x0 = cx * SERVER_CHUNK, y0 = cy * SERVER_CHUNK;
+            int w = local->width - x0 < SERVER_CHUNK ? local->width - x0 : SERVER_CHUNK;
+            int h = local->height - y0 < SERVER_CHUNK ? local->height - y0 : SERVER_CHUNK;
+            uint8_t tiles[SERVER_CHUNK * SERVER_CHUNK];
+            for (int y = 0; y < h; y++)
+            {
+                uint8_t* row = client->localShadow + (size_t)(y0 + y) * local->width + x0;
+                memcpy(row, &local->tiles[y0 + y][x0], w);
+                memcpy(tiles + y * w, row, w);
+            }
+            
+            size_t frame = frame_begin(&client->out, MSG_CHUNK);
+            uint16_t place[2] = { (uint16_t)cx, (uint16_t)cy };
+            put_bytes(&client->out, place, sizeof(place));
+            put_rle(&client->out, tiles, (size_t)w * h);
+            frame_end(&client->out, frame);
+        }
+    }
+}
+
+// Player entries that changed for this client since last sent, written
+// straight into the frame (taken back out when none changed)
+static void server_send_players(ServerClient* client)
+{
+    NetBuffer* out = &client->out;
+    size_t frame = frame_begin(out, MSG_PLAYERS);
+    size_t countAt = out->size;
+    put_byte(out, 0);
+    uint8_t count = 0;
+    
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++)
+    {
+        const ServerClient* other = &clients[i];
+        
+        // Visible when on the same map
+        bool here = other->active && other->inLocal == client->inLocal &&
+                    (!client->inLocal || (other->x == client->x && other->y == client->y));
+        int16_t x = 0, y = 0;
+        if (here) {
+            x = (int16_t)(client->inLocal ? other->localX : other->x);
+            y = (int16_t)(client->inLocal ? other->localY : other->y);
+        }
+        
+        int16_t* known = client->known[i];
+        if (known[0] == (here ? 1 : 0) && (!here || (known[1] == x && known[2] == y))) continue;
+        known[0] = here ? 1 : 0;
+        known[1] = x;
+        known[2] = y;
+        
+        uint16_t id = (uint16_t)i;
+        uint8_t flag = here ? 1 : 0;
+        put_bytes(out, &id, sizeof(id));
+        put_bytes(out, &flag, 1);
+        put_bytes(out, &x, sizeof(x));
+        put_bytes(out, &y, sizeof(y));
+        count++;
+    }
+    
+    if (out->failed) return;
+    if (count == 0) {
+        out->size = frame;
+        return;
+    }
+    out->data[countAt] = count;
+    frame_end(out, frame);
+}
+
+// This tick's changes for one client
+static void server_update_client(ServerClient* client, DeltaWriter* delta, int tick)
+{
+    // World tiles, diffed row by row against the shadow; the view's tile
+    // chars are the whole world here and already a byte per tile
+    const uint8_t* tiles = (const uint8_t*)worldMap->tiles;
+    delta_begin(delta);
+    for (int y = 0; y < currentMapHeight; y++)
+    {
+        size_t offset = (size_t)y * currentMapWidth;
+        delta_segment(delta, offset, tiles + offset, client->worldShadow + offset, currentMapWidth);
+    }
+    delta_send(delta, &client->out, 0);
+    
+    // Local tiles: only chunks the client has
+    const LocalMap* local = server_client_local(client);
+    if (local != NULL)
+    {
+        server_send_chunks(client, local);
+        
+        int chunksX = (local->width + SERVER_CHUNK - 1) / SERVER_CHUNK;
+        delta_begin(delta);
+        for (int y = 0; y < local->height; y++)
+        {
+            for (int cx = 0; cx < chunksX; cx++)
+            {
+                if (!client->sentChunks[(size_t)(y / SERVER_CHUNK) * chunksX + cx]) continue;
+                int x0 = cx * SERVER_CHUNK;
+                int w = local->width - x0 < SERVER_CHUNK ? local->width - x0 : SERVER_CHUNK;
+                size_t offset = (size_t)y * local->width + x0;
+                delta_segment(delta, offset, (const uint8_t*)&local->tiles[y][x0],
+                              client->localShadow + offset, w);
+            }
+        }
+        delta_send(delta, &client->out, 1);
+    }
+    
+    server_send_players(client);
+    
+    // Periodic checksum of the client's view, so it can verify its copy
+    if (tick % SERVER_CHECK_INTERVAL == 0)
+    {
+        uint32_t crcs[2] = {
+            crc32c_update(0, client->worldShadow, (size_t)currentMapWidth * currentMapHeight),
+            local ? crc32c_update(0, client->localShadow, (size_t)local->width * local->height) : 0
+        };
+        size_t frame = frame_begin(&client->out, MSG_CHECK);
+        put_bytes(&client->out, crcs, sizeof(crcs));
+        frame_end(&client->out, frame);
+    }
+}
+
+#if !defined(_WIN32)
+static void server_signal(int)
+{
+    serverQuit = true;
+}
+#endif
+
+// Run a world as a headless server (ticks <= 0: until interrupted);
+// returns the process exit code
+int run_server(const char* address, int sizeIndex, int ticks)
+{
+    // Clients are sent the whole world grid, which sparse worlds don't have
+    if (mapSizes[sizeIndex].width > WORLD_VIEW_SIDE || mapSizes[sizeIndex].height > WORLD_VIEW_SIDE) {
+        fprintf(stderr, "server: %s worlds are too large to serve\n", mapSizes[sizeIndex].name);
+        return 1;
+    }
+    
+    if (!net_startup()) return 1;
+    
+    NetSocket listener = net_listen(address);
+    if (listener == NET_INVALID) {
+        fprintf(stderr, "server: can't listen on %s\n", address);
+        net_cleanup();
+        return 1;
+    }
+    
+    headlessMode = true;
+    if (!generate_world_map(mapSizes[sizeIndex].width, mapSizes[sizeIndex].height)) {
+        fprintf(stderr, "server: can't generate a %s world\n", mapSizes[sizeIndex].name);
+        net_close(listener);
+        net_cleanup();
+        return 1;
+    }
+
+#if !defined(_WIN32)
+    signal(SIGINT, server_signal);
+    signal(SIGTERM, server_signal);
+#endif
+    printf("server: %s world on %s\n", mapSizes[sizeIndex].name, address);
+    fflush(stdout);
+    
+    static NetTimings tickMs;
+    DeltaWriter delta;
+    net_buffer_init(&delta.body, SERVER_MAX_BACKLOG);
+    double nextTick = server_now_ms();
+    
+    for (int tick = 0; !serverQuit && (ticks <= 0 || tick < ticks); tick++)
+    {
+        double start = server_now_ms();
+        
+        // Joins
+        for (;;)
+        {
+            NetSocket s = accept(listener, NULL, NULL);
+            if (s == NET_INVALID) break;
+            server_join(s);
+        }
+        
+        // Input, then the world's response to it; the terrain lives on too
+        sim_update();
+        for (int i = 0; i < SERVER_MAX_CLIENTS; i++)
+        {
+            if (clients[i].active && !server_receive(&clients[i])) server_drop(&clients[i], i);
+        }
+        for (int i = 0; i < SERVER_MAX_CLIENTS; i++)
+        {
+            ServerClient* client = &clients[i];
+            if (!client->active) continue;
+            
+            size_t queued = client->out.size;
+            server_update_client(client, &delta, tick);
+            size_t bytes = client->out.size - queued;
+            client->bytesSent += bytes;
+            if (bytes > client->maxTickBytes) client->maxTickBytes = bytes;
+            client->ticks++;
+            
+            // Clients that stop reading are dropped, not buffered forever
+            if (client->out.failed || !net_flush(client->socket, &client->out)) {
+                server_drop(client, i);
+            }
+        }
+        
+        net_time(&tickMs, server_now_ms() - start);
+        
+        // Fixed rate; a late tick starts the next one right away
+        nextTick += 1000.0 / TICK_RATE;
+        double wait = nextTick - server_now_ms();
+        if (wait > 0) std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(wait));
+        else nextTick = server_now_ms();
+    }
+    
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++) {
+        if (clients[i].active) server_drop(&clients[i], i);
+    }
+    net_timing_report("tick", &tickMs);
+    net_buffer_free(&delta.body);
+    
+    net_close(listener);
+#if !defined(_WIN32)
+    if (net_is_unix(address)) unlink(address);
+#endif
+    net_cleanup();
+    cleanup_all_maps();
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Bot client: random walk over loopback, checking its copy of the world
+// against the server's checksums
+
+int run_bot_client(const char* address, int ticks)
+{
+    if (!net_startup()) return 1;
+    
+    NetSocket s = net_connect(address);
+    if (s == NET_INVALID) {
+        fprintf(stderr, "client: can't connect to %s\n", address);
+        net_cleanup();
+        return 1;
+    }
+    
+    NetBuffer in, out;
+    net_buffer_init(&in, SERVER_MAX_BACKLOG);
+    net_buffer_init(&out, SERVER_MAX_INPUT);
+    uint8_t* world = NULL;
+    uint8_t* hasLocal = NULL;
+    uint8_t* local = NULL;
+    static NetTimings latencyMs;
+    int width = 0, height = 0, localWidth = 0, localHeight = 0;
+    int x = 2, y = 2;
+    bool inLocal = false;
+    uint16_t self = 0;
+    int checksOk = 0, checksBad = 0, ticksInLocal = 0;
+    uint64_t received = 0;
+    uint32_t rng = 0x9e3779b9u ^ (uint32_t)server_now_ms();
+    bool connected = true;
+    
+    for (int tick = 0; tick < ticks && connected; tick++)
+    {
+        size_t before = in.size;
+        connected = net_receive(s, &in);
+        received += in.size - before;
+        
+        size_t pos = 0;
+        uint8_t type;
+        NetReader payload;
+        while (frame_next(&in, &pos, &type, &payload))
+        {
+            switch (type)
+            {
+                case MSG_WELCOME:
+                {
+                    int32_t size[2];
+                    get_bytes(&payload, &self, sizeof(self));
+                    get_bytes(&payload, size, sizeof(size));
+                    mem_free(world);
+                    mem_free(hasLocal);
+                    world = (uint8_t*)mem_calloc(MEM_NET, (size_t)size[0] * size[1], 1);
+                    hasLocal = (uint8_t*)mem_calloc(MEM_NET, ((size_t)size[0] * size[1] + 7) / 8, 1);
+                    bool fits = world != NULL && hasLocal != NULL;
+                    width = fits ? size[0] : 0;
+                    height = fits ? size[1] : 0;
+                    break;
+                }
+                case MSG_WORLD:
+                    get_rle(&payload, world, (size_t)width * height);
+                    get_bytes(&payload, hasLocal, ((size_t)width * height + 7) / 8);
+                    break;
+                
+                case MSG_ENTER:
+                {
+                    int32_t place[4];
+                    get_bytes(&payload, place, sizeof(place));
+                    mem_free(local);
+                    local = (uint8_t*)mem_calloc(MEM_NET, (size_t)place[2] * place[3], 1);
+                    localWidth = local ? place[2] : 0;
+                    localHeight = local ? place[3] : 0;
+                    inLocal = true;
+                    ticksInLocal = 0;
+                    break;
+                }
+                case MSG_EXIT:
+                    inLocal = false;
+                    break;
+                
+                case MSG_CHUNK:
+                {
+                    uint16_t place[2];
+                    get_bytes(&payload, place, sizeof(place));
+                    int x0 = place[0] * SERVER_CHUNK, y0 = place[1] * SERVER_CHUNK;
+                    if (x0 >= localWidth || y0 >= localHeight) break;
+                    int w = localWidth - x0 < SERVER_CHUNK ? localWidth - x0 : SERVER_CHUNK;
+                    int h = localHeight - y0 < SERVER_CHUNK ? localHeight - y0 : SERVER_CHUNK;
+                    uint8_t tiles[SERVER_CHUNK * SERVER_CHUNK];
+                    if (!get_rle(&payload, tiles, (size_t)w * h)) break;
+                    for (int row = 0; row < h; row++) {
+                        memcpy(&local[(size_t)(y0 + row) * localWidth + x0], tiles + row * w, w);
+                    }
+                    break;
+                }
+                case MSG_DELTA:
+                {
+                    uint8_t map = 0;
+                    get_bytes(&payload, &map, 1);
+                    if (map == 0) delta_apply(&payload, world, (size_t)width * height);
+                    else delta_apply(&payload, local, (size_t)localWidth * localHeight);
+                    break;
+                }
+                case MSG_PLAYERS:
+                {
+                    uint8_t count = 0;
+                    get_bytes(&payload, &count, 1);
+                    for (int i = 0; i < count; i++)
+                    {
+                        uint16_t id = 0;
+                        uint8_t here = 0;
+                        int16_t px = 0, py = 0;
+                        get_bytes(&payload, &id, sizeof(id));
+                        get_bytes(&payload, &here, 1);
+                        get_bytes(&payload, &px, sizeof(px));
+                        get_bytes(&payload, &py, sizeof(py));
+                        if (id == self && here) {
+                            x = px;
+                            y = py;
+                        }
+                    }
+                    break;
+                }
+                case MSG_CHECK:
+                {
+                    uint32_t crcs[2];
+                    get_bytes(&payload, crcs, sizeof(crcs));
+                    bool ok = crcs[0] == crc32c_update(0, world, (size_t)width * height) &&
+                              (!inLocal || crcs[1] == crc32c_update(0, local, (size_t)localWidth * localHeight));
+                    if (ok) checksOk++;
+                    else checksBad++;
+                    break;
+                }
+                case MSG_PONG:
+                {
+                    double sentAt;
+                    if (get_bytes(&payload, &sentAt, sizeof(sentAt))) net_time(&latencyMs, server_now_ms() - sentAt);
+                    break;
+                }
+            }
+        }
+        net_consume(&in, pos);
+        
+        // Wander; step into local maps now and then and back out later
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        uint8_t action = (uint8_t)(rng % 4);
+        size_t cell = (size_t)y * width + x;
+        if (!inLocal && width > 0 && (hasLocal[cell / 8] >> (cell % 8) & 1) && rng % 16 == 0) action = ACTION_ENTER;
+        if (inLocal && ++ticksInLocal > TICK_RATE * 2 && rng % 8 == 0) action = ACTION_EXIT;
+        
+        size_t frame = frame_begin(&out, MSG_ACTION);
+        put_byte(&out, action);
+        frame_end(&out, frame);
+        
+        double now = server_now_ms();
+        frame = frame_begin(&out, MSG_PING);
+        put_bytes(&out, &now, sizeof(now));
+        frame_end(&out, frame);
+        
+        connected = connected && !out.failed && net_flush(s, &out);
+        std::this_thread::sleep_for(std::chrono::duration<double>(TICK_DT));
+    }
+    
+    net_close(s);
+    net_cleanup();
+    net_buffer_free(&in);
+    net_buffer_free(&out);
+    mem_free(world);
+    mem_free(hasLocal);
+    mem_free(local);
+    
+    printf("client: %llu bytes in %d ticks (%.1f B/tick), checks %d ok %d bad%s\n",
+           (unsigned long long)received, ticks, ticks ? (double)received / ticks : 0.0,
+           checksOk, checksBad, connected ? "" : ", disconnected");
+    net_timing_report("latency", &latencyMs);
+    return (checksBad == 0 && checksOk > 0 && connected) ? 0 : 1;
+}
@@ -0,0 +1,358 @@
+#include "project.h"
+#include <atomic>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SIM_HAVE_SSE2 1
+#endif
+
+// Living terrain. Every SIM_TICK_INTERVAL ticks a generation of cellular
+// automaton rules runs over every generated map on the workers: forests
+// creep into the grass they surround, lakes spill over their shores in the
+// wet season and shrink back in the dry one, and lone puddles dry up.
+// Jobs only read the tiles and write each map's changes to its own list;
+// the main thread applies the lists, one edit batch per map, when the next
+// generation is due. The journals then tell the renderer and the save
+// writer what changed, and the outcome never depends on how the workers
+// were scheduled. A tile that may change does so with a 1 in 16 chance per
+// generation, drawn from a hash of its position, so fronts advance raggedly.
+
+// Neighbour thresholds of one generation (counts over the eight neighbours)
+typedef struct {
+    int spread;             // Forest neighbours that seed a tree on grass
+    int flood;              // Water neighbours that flood grass (9 = never)
+    int recede;             // Water with at most this many water neighbours dries (-1 = never)
+} SimRules;
+
+#define SIM_CHANCE 16               // Noise values (of 256) that let a tile change
+
+// Generation in flight (main thread, except for the jobs' cursor)
+typedef struct {
+    LocalMap** maps;        // Every generated map when the generation started
+    int count;
+    int capacity;
+    std::atomic<int> next;  // Next map a job takes
+    JobId jobs[SIM_MAX_JOBS];
+    int jobCount;
+    uint32_t generation;
+    int ticks;              // Since the last generation started
+} SimState;
+
+static SimState sim;
+
+// Thresholds for a generation; seasons alternate every SIM_SEASON_LENGTH
+static SimRules sim_rules(uint32_t generation)
+{
+    bool wet = (generation / SIM_SEASON_LENGTH) % 2 == 0;
+    SimRules rules = { 5, wet ? 3 : 9, wet ? -1 : 5 };
+    return rules;
+}
+
+// Next state of one tile from its neighbour counts (0 = unchanged)
+static char sim_rule(char tile, int forest, int water, const SimRules* rules)
+{
+    if (tile == '.' && water >= rules->flood) return '~';
+    if (tile == '.' && forest >= rules->spread) return 'T';
+    if (tile == '~' && water <= rules->recede) return '.';
+    return 0;
+}
+
+// Noise seed of one row of one map in one generation
+static uint16_t sim_row_seed(uint32_t mapSeed, uint32_t generation, int y)
+{
+    uint32_t h = mapSeed ^ (generation * 0x9E3779B9u) ^ ((uint32_t)y * 0x85ebca6bu);
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    return (uint16_t)(h ^ (h >> 16));
+}
+
+// Noise byte of tile x in a row; the SSE2 path computes the same values
+static int sim_noise(uint16_t rowSeed, int x)
+{
+    uint16_t v = (uint16_t)(((uint16_t)x ^ rowSeed) * 0x9E37u);
+    v ^= v >> 7;
+    v = (uint16_t)(v * 0x2C1Bu);
+    return v >> 8;
+}
+
+// Queue a change unless the list is full (the tile gets another chance later)
+static void sim_push(SimChanges* next, int x, int y, char tile)
+{
+    if (next->count >= SIM_MAX_CHANGES) return;
+    TileEdit* edit = &next->edits[next->count++];
+    edit->x = x;
+    edit->y = y;
+    edit->tile = tile;
+}
+
+// One tile the plain way: count its neighbours and apply the rules
+static void sim_tile(const LocalMap* local, int x, int y, uint16_t rowSeed, const SimRules* rules, SimChanges* next)
+{
+    if (sim_noise(rowSeed, x) >= SIM_CHANCE) return;
+    
+    int forest = 0, water = 0;
+    for (int dy = -1; dy <= 1; dy++)
+    {
+        for (int dx = -1; dx <= 1; dx++)
+        {
+            if (dx == 0 && dy == 0) continue;
+            char n = local->tiles[y + dy][x + dx];
+            forest += n == 'T';
+            water += n == '~';
+        }
+    }
+    
+    char tile = sim_rule(local->tiles[y][x], forest, water, rules);
+    if (tile != 0) sim_push(next, x, y, tile);
+}
+
+#ifdef SIM_HAVE_SSE2
+// Forest and water counts of one column of three tiles, for the columns
+// at either end of a run of blocks
+static void sim_column(const char* const* rows, int x, int* forest, int* water)
+{
+    *forest = (rows[0][x] == 'T') + (rows[1][x] == 'T') + (rows[2][x] == 'T');
+    *water = (rows[0][x] == '~') + (rows[1][x] == '~') + (rows[2][x] == '~');
+}
+
+// Forest and water counts of sixteen columns of three tiles
+static void sim_columns(const char* const* rows, int x, __m128i* forest, __m128i* water)
+{
+    const __m128i forestTile = _mm_set1_epi8('T');
+    const __m128i waterTile = _mm_set1_epi8('~');
+    
+    // Matches are -1, so subtracting them counts up
+    *forest = _mm_setzero_si128();
+    *water = _mm_setzero_si128();
+    for (int r = 0; r < 3; r++)
+    {
+        __m128i n = _mm_loadu_si128((const __m128i*)(rows[r] + x));
+        *forest = _mm_sub_epi8(*forest, _mm_cmpeq_epi8(n, forestTile));
+        *water = _mm_sub_epi8(*water, _mm_cmpeq_epi8(n, waterTile));
+    }
+}
+
+// Sixteen tiles of a row at once. Each block's column counts are taken
+// once and shifted a byte either way for the neighbouring columns, and the
+// rules (as in sim_rule) become byte masks. Returns the first x left for
+// sim_tile.
+static int sim_row_sse2(const LocalMap* local, int y, uint16_t rowSeed, const SimRules* rules, SimChanges* next)
+{
+    const char* rows[3] = { local->tiles[y - 1], local->tiles[y], local->tiles[y + 1] };
+    const __m128i forestTile = _mm_set1_epi8('T');
+    const __m128i waterTile = _mm_set1_epi8('~');
+    const __m128i grassTile = _mm_set1_epi8('.');
+    const __m128i spread = _mm_set1_epi8((char)(rules->spread - 1));
+    const __m128i flood = _mm_set1_epi8((char)(rules->flood - 1));
+    const __m128i recede = _mm_set1_epi8((char)(rules->recede + 1));
+    const __m128i seed = _mm_set1_epi16((short)rowSeed);
+    const __m128i lanes = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m128i chanceMask = _mm_set1_epi8((char)(0x100 - SIM_CHANCE));
+    
+    int x = 1;
+    if (x + 17 > local->width) return x;
+    
+    // Column 0 sits in the top byte of the block before the first
+    int edgeForest, edgeWater;
+    sim_column(rows, 0, &edgeForest, &edgeWater);
+    __m128i prevForest = _mm_slli_si128(_mm_cvtsi32_si128(edgeForest), 15);
+    __m128i prevWater = _mm_slli_si128(_mm_cvtsi32_si128(edgeWater), 15);
+    __m128i forest, water;
+    sim_columns(rows, x, &forest, &water);
+    
+    for (; x + 17 <= local->width; x += 16)
+    {
+        // The next block, or just its first column at the end of the row
+        __m128i nextForest, nextWater;
+        if (x + 32 <= local->width) sim_columns(rows, x + 16, &nextForest, &nextWater);
+        else {
+            sim_column(rows, x + 16, &edgeForest, &edgeWater);
+            nextForest = _mm_cvtsi32_si128(edgeForest);
+            nextWater = _mm_cvtsi32_si128(edgeWater);
+        }
+        
+        // Left, middle and right columns, less the tile itself
+        __m128i tile = _mm_loadu_si128((const __m128i*)(rows[1] + x));
+        __m128i isForest = _mm_cmpeq_epi8(tile, forestTile);
+        __m128i isWater = _mm_cmpeq_epi8(tile, waterTile);
+        __m128i forestAround = _mm_add_epi8(_mm_add_epi8(forest, isForest),
+            _mm_add_epi8(_mm_or_si128(_mm_slli_si128(forest, 1), _mm_srli_si128(prevForest, 15)),
+                         _mm_or_si128(_mm_srli_si128(forest, 1), _mm_slli_si128(nextForest, 15))));
+        __m128i waterAround = _mm_add_epi8(_mm_add_epi8(water, isWater),
+            _mm_add_epi8(_mm_or_si128(_mm_slli_si128(water, 1), _mm_srli_si128(prevWater, 15)),
+                         _mm_or_si128(_mm_srli_si128(water, 1), _mm_slli_si128(nextWater, 15))));
+        prevForest = forest;
+        prevWater = water;
+        forest = nextForest;
+        water = nextWater;
+        
+        // Flooding wins over new trees; receding water leaves grass
+        __m128i grass = _mm_cmpeq_epi8(tile, grassTile);
+        __m128i toWater = _mm_and_si128(grass, _mm_cmpgt_epi8(waterAround, flood));
+        __m128i toForest = _mm_andnot_si128(toWater, _mm_and_si128(grass, _mm_cmpgt_epi8(forestAround, spread)));
+        __m128i toGrass = _mm_and_si128(isWater, _mm_cmplt_epi8(waterAround, recede));
+        __m128i change = _mm_or_si128(_mm_or_si128(toWater, toForest), toGrass);
+        __m128i after = _mm_or_si128(_mm_or_si128(_mm_and_si128(toWater, waterTile), _mm_and_si128(toForest, forestTile)),
+                                     _mm_and_si128(toGrass, grassTile));
+        
+        // Noise for the sixteen tiles, eight 16-bit lanes at a time
+        __m128i noise[2];
+        for (int half = 0; half < 2; half++)
+        {
+            __m128i v = _mm_add_epi16(lanes, _mm_set1_epi16((short)(x + half * 8)));
+            v = _mm_mullo_epi16(_mm_xor_si128(v, seed), _mm_set1_epi16((short)0x9E37));
+            v = _mm_xor_si128(v, _mm_srli_epi16(v, 7));
+            v = _mm_mullo_epi16(v, _mm_set1_epi16((short)0x2C1B));
+            noise[half] = _mm_srli_epi16(v, 8);
+        }
+        __m128i lucky = _mm_cmpeq_epi8(_mm_and_si128(_mm_packus_epi16(noise[0], noise[1]), chanceMask), _mm_setzero_si128());
+        int mask = _mm_movemask_epi8(_mm_and_si128(change, lucky));
+        if (mask == 0) continue;
+        
+        char to[16];
+        _mm_storeu_si128((__m128i*)to, after);
+        while (mask != 0)
+        {
+            int lane = __builtin_ctz((unsigned)mask);
+            mask &= mask - 1;
+            sim_push(next, x + lane, y, to[lane]);
+        }
+    }
+    return x;
+}
+#endif
+
+// Work out one map's next generation into its change list; border tiles
+// never change
+static void sim_map_step(LocalMap* local, uint32_t generation)
+{
+    SimChanges* next = &local->next;
+    next->count = 0;
+    if (next->edits == NULL) return;
+    
+    SimRules rules = sim_rules(generation);
+    for (int y = 1; y + 1 < local->height && next->count < SIM_MAX_CHANGES; y++)
+    {
+        uint16_t rowSeed = sim_row_seed(local->seed, generation, y);
+        int x = 1;
+#ifdef SIM_HAVE_SSE2
+        x = sim_row_sse2(local, y, rowSeed, &rules, next);
+#endif
+        for (; x + 1 < local->width; x++) sim_tile(local, x, y, rowSeed, &rules, next);
+    }
+}
+
+// Worker job: take maps until the generation runs out of them
+static void sim_job(void* data)
+{
+    (void)data;
+    int i;
+    while (!job_cancelled() && (i = sim.next++) < sim.count) sim_map_step(sim.maps[i], sim.generation);
+}
+
+// Append a map and everything below it to the generation (false if the
+// list couldn't grow; the maps left out just skip this generation)
+static bool sim_gather(LocalMap* local)
+{
+    if (sim.count == sim.capacity)
+    {
+        int capacity = sim.capacity ? sim.capacity * 2 : 256;
+        LocalMap** grown = (LocalMap**)mem_realloc(MEM_SIM, sim.maps, (size_t)capacity * sizeof(LocalMap*));
+        if (grown == NULL) return false;
+        sim.maps = grown;
+        sim.capacity = capacity;
+    }
+    sim.maps[sim.count++] = local;
+    
+    for (int i = 0; i < local->children.capacity; i++)
+    {
+        if (local->children.slots[i].tile != 0 && !sim_gather(local->children.slots[i].map)) return false;
+    }
+    return true;
+}
+
+// Wait for the generation in flight, then apply what it changed
+static void sim_finish()
+{
+    for (int i = 0; i < sim.jobCount; i++) job_wait(sim.jobs[i]);
+    sim.jobCount = 0;
+    
+    for (int i = 0; i < sim.count; i++)
+    {
+        LocalMap* local = sim.maps[i];
+        if (local->next.count > 0) set_local_tiles(local, local->next.edits, local->next.count);
+        local->next.count = 0;
+    }
+    sim.count = 0;
+}
+
+// Start the next generation over every generated map
+static void sim_start()
+{
+    sim.count = 0;
+    bool room = true;
+    for (int i = 0; i < worldMap->capacity && room; i++)
+    {
+        const WorldChunk* chunk = worldMap->slots[i];
+        if (chunk == NULL) continue;
+        for (int j = 0; j < WORLD_CHUNK * WORLD_CHUNK && room; j++)
+        {
+            if (chunk->cells[j].localMap != NULL) room = sim_gather(chunk->cells[j].localMap);
+        }
+    }
+    if (sim.count == 0) return;
+    
+    sim.generation++;
+    sim.next = 0;
+    sim.jobCount = jobs_worker_count() < SIM_MAX_JOBS ? jobs_worker_count() : SIM_MAX_JOBS;
+    if (sim.jobCount > sim.count) sim.jobCount = sim.count;
+    for (int i = 0; i < sim.jobCount; i++) sim.jobs[i] = job_run(sim_job, NULL, JOB_LOW);
+}
+
+// One tick of living terrain: a generation is applied and the next one
+// started every SIM_TICK_INTERVAL ticks, whatever the frame rate
+void sim_update()
+{
+    if (worldMap == NULL || ++sim.ticks < SIM_TICK_INTERVAL) return;
+    sim.ticks = 0;
+    
+    sim_finish();
+    sim_start();
+}
+
+// Is a generation in flight, with maps whose changes the next one applies?
+bool sim_pending()
+{
+    return sim.count > 0;
+}
+
+// Make room for this many maps in a generation, ahead of time
+void sim_reserve(int maps)
+{
+    if (maps <= sim.capacity) return;
+    LocalMap** grown = (LocalMap**)mem_realloc(MEM_SIM, sim.maps, (size_t)maps * sizeof(LocalMap*));
+    if (grown == NULL) return;
+    sim.maps = grown;
+    sim.capacity = maps;
+}
+
+// Drop the generation in flight (before maps go away)
+void sim_cancel()
+{
+    for (int i = 0; i < sim.jobCount; i++) job_cancel(sim.jobs[i]);
+    for (int i = 0; i < sim.jobCount; i++) job_wait(sim.jobs[i]);
+    for (int i = 0; i < sim.count; i++) sim.maps[i]->next.count = 0;
+    sim.jobCount = 0;
+    sim.count = 0;
+    sim.ticks = 0;
+}
+
+// Free the map list
+void sim_shutdown()
+{
+    sim_cancel();
+    mem_free(sim.maps);
+    sim.maps = NULL;
+    sim.capacity = 0;
+}
@@ -0,0 +1,287 @@
+#include "project.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define STATS_HAVE_SSE2 1
+#endif
+
+// Map statistics: how much of each tile a map has, its largest lake and
+// whether every passable tile can be reached from where the map starts.
+// Each LocalMap caches its numbers with the edit version they were taken
+// at, so they are recomputed only after the map changed. Connected regions
+// are found over runs of set bits rather than single tiles: each row's runs
+// are joined to the runs they touch in the row above with union-find.
+
+// Tiles counted, in MapStats.tileCount order
+static const char statTiles[STAT_TILE_KINDS] = { '.', 'T', '~', '^', '#', '>', '<' };
+
+// Labeling scratch, sized for the largest map seen (main thread only)
+typedef struct {
+    int* parent;            // Union-find over run labels
+    int* size;              // Tiles under each root
+    uint32_t* first;        // Packed (y << 16) | x of each label's first tile
+    int* runs;              // Two rows of runs: start, end, label
+    uint64_t* bits;         // One row of the region being labeled
+    int capacity;           // Tiles
+} StatsScratch;
+
+static StatsScratch statsScratch;
+
+// Make sure a map of this many tiles can be labeled
+void stats_reserve(int tiles)
+{
+    if (tiles <= statsScratch.capacity) return;
+    
+    stats_shutdown();
+    // At most one run per two tiles of a row, plus one
+    int labels = tiles / 2 + SAVE_MAX_MAP_SIDE;
+    statsScratch.parent = (int*)mem_alloc(MEM_STATS, (size_t)labels * sizeof(int));
+    statsScratch.size = (int*)mem_alloc(MEM_STATS, (size_t)labels * sizeof(int));
+    statsScratch.first = (uint32_t*)mem_alloc(MEM_STATS, (size_t)labels * sizeof(uint32_t));
+    statsScratch.runs = (int*)mem_alloc(MEM_STATS, (size_t)2 * 3 * (SAVE_MAX_MAP_SIDE / 2 + 1) * sizeof(int));
+    statsScratch.bits = (uint64_t*)mem_alloc(MEM_STATS, (SAVE_MAX_MAP_SIDE / 64) * sizeof(uint64_t));
+    if (!statsScratch.parent || !statsScratch.size || !statsScratch.first ||
+        !statsScratch.runs || !statsScratch.bits) {
+        stats_shutdown();
+        return;
+    }
+    statsScratch.capacity = tiles;
+}
+
+// Free the labeling scratch
+void stats_shutdown()
+{
+    mem_free(statsScratch.parent);
+    mem_free(statsScratch.size);
+    mem_free(statsScratch.first);
+    mem_free(statsScratch.runs);
+    mem_free(statsScratch.bits);
+    memset(&statsScratch, 0, sizeof(statsScratch));
+}
+
+// Count each tile kind, sixteen tiles per step. Byte counters are folded
+// into wide totals before they can overflow.
+static void stats_histogram(const char* tiles, size_t count, int* out)
+{
+    size_t i = 0;
+    memset(out, 0, STAT_TILE_KINDS * sizeof(int));
+#ifdef STATS_HAVE_SSE2
+    __m128i kinds[STAT_TILE_KINDS];
+    __m128i totals[STAT_TILE_KINDS];
+    for (int k = 0; k < STAT_TILE_KINDS; k++)
+    {
+        kinds[k] = _mm_set1_epi8(statTiles[k]);
+        totals[k] = _mm_setzero_si128();
+    }
+    
+    while (i + 16 <= count)
+    {
+        __m128i bytes[STAT_TILE_KINDS];
+        for (int k = 0; k < STAT_TILE_KINDS; k++) bytes[k] = _mm_setzero_si128();
+        
+        // Equal bytes are -1, so subtracting counts them
+        size_t end = i + 255 * 16 < count ? i + 255 * 16 : count - (count - i) % 16;
+        for (; i < end; i += 16)
+        {
+            __m128i chunk = _mm_loadu_si128((const __m128i*)(tiles + i));
+            for (int k = 0; k < STAT_TILE_KINDS; k++)
+            {
+                bytes[k] = _mm_sub_epi8(bytes[k], _mm_cmpeq_epi8(chunk, kinds[k]));
+            }
+        }
+        for (int k = 0; k < STAT_TILE_KINDS; k++)
+        {
+            totals[k] = _mm_add_epi64(totals[k], _mm_sad_epu8(bytes[k], _mm_setzero_si128()));
+        }
+    }
+    for (int k = 0; k < STAT_TILE_KINDS; k++)
+    {
+        uint64_t halves[2];
+        _mm_storeu_si128((__m128i*)halves, totals[k]);
+        out[k] = (int)(halves[0] + halves[1]);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        for (int k = 0; k < STAT_TILE_KINDS; k++) out[k] += tiles[i] == statTiles[k];
+    }
+}
+
+// One row of water tiles as bits, sixteen tiles per compare
+static void stats_water_bits(const char* row, int width, uint64_t* bits)
+{
+    memset(bits, 0, (size_t)((width + 63) / 64) * sizeof(uint64_t));
+    int x = 0;
+#ifdef STATS_HAVE_SSE2
+    const __m128i water = _mm_set1_epi8('~');
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(row + x));
+        uint64_t mask = (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, water));
+        bits[x >> 6] |= mask << (x & 63);
+    }
+#endif
+    for (; x < width; x++)
+    {
+        if (row[x] == '~') bits[x >> 6] |= (uint64_t)1 << (x & 63);
+    }
+}
+
+// Root of a label, halving the path on the way
+static int stats_find(int* parent, int label)
+{
+    while (parent[label] != label)
+    {
+        parent[label] = parent[parent[label]];
+        label = parent[label];
+    }
+    return label;
+}
+
+// Runs of set bits in one row, as (start, end, label) with new labels
+static int stats_row_runs(const uint64_t* bits, int width, int y, int* runs, int* labels)
+{
+    int count = 0;
+    int words = (width + 63) / 64;
+    int x = 0;
+    while (x < width)
+    {
+        // Skip to the next set bit, then to the next clear one
+        int w = x >> 6;
+        uint64_t word = bits[w] & (~(uint64_t)0 << (x & 63));
+        while (word == 0 && ++w < words) word = bits[w];
+        if (word == 0) break;
+        int start = w * 64 + __builtin_ctzll(word);
+        if (start >= width) break;
+        
+        w = start >> 6;
+        word = ~bits[w] & (~(uint64_t)0 << (start & 63));
+        while (word == 0 && ++w < words) word = ~bits[w];
+        int end = word == 0 ? width : w * 64 + __builtin_ctzll(word);
+        if (end > width) end = width;
+        
+        int label = (*labels)++;
+        statsScratch.parent[label] = label;
+        statsScratch.size[label] = end - start;
+        statsScratch.first[label] = ((uint32_t)y << 16) | (uint32_t)start;
+        runs[count * 3] = start;
+        runs[count * 3 + 1] = end;
+        runs[count * 3 + 2] = label;
+        count++;
+        x = end;
+    }
+    return count;
+}
+
+// Connected regions (4-connected) of the tiles rowBits sets; returns the
+// size of the largest, with one of its tiles, and the size of the one
+// holding (probeX, probeY), 0 if that tile isn't set
+template <typename RowBits>
+static int stats_label(int width, int height, RowBits rowBits, int probeX, int probeY,
+                       uint32_t* largestAt, int* probeSize)
+{
+    int* prev = statsScratch.runs;
+    int* cur = statsScratch.runs + 3 * (SAVE_MAX_MAP_SIDE / 2 + 1);
+    int prevCount = 0;
+    int labels = 0;
+    int probeLabel = -1;
+    
+    for (int y = 0; y < height; y++)
+    {
+        int count = stats_row_runs(rowBits(y), width, y, cur, &labels);
+        
+        // Join runs that overlap a run of the row above
+        int j = 0;
+        for (int i = 0; i < count; i++)
+        {
+            int start = cur[i * 3], end = cur[i * 3 + 1];
+            while (j < prevCount && prev[j * 3 + 1] <= start) j++;
+            for (int k = j; k < prevCount && prev[k * 3] < end; k++)
+            {
+                int a = stats_find(statsScratch.parent, cur[i * 3 + 2]);
+                int b = stats_find(statsScratch.parent, prev[k * 3 + 2]);
+                if (a == b) continue;
+                if (a > b) { int t = a; a = b; b = t; }
+                statsScratch.parent[b] = a;
+                statsScratch.size[a] += statsScratch.size[b];
+            }
+            if (y == probeY && probeX >= start && probeX < end) probeLabel = cur[i * 3 + 2];
+        }
+        
+        int* swap = prev;
+        prev = cur;
+        cur = swap;
+        prevCount = count;
+    }
+    
+    int largest = 0;
+    *largestAt = 0;
+    for (int label = 0; label < labels; label++)
+    {
+        if (statsScratch.parent[label] != label || statsScratch.size[label] <= largest) continue;
+        largest = statsScratch.size[label];
+        *largestAt = statsScratch.first[label];
+    }
+    *probeSize = probeLabel >= 0 ? statsScratch.size[stats_find(statsScratch.parent, probeLabel)] : 0;
+    return largest;
+}
+
+// Where a map starts: the area cleared in the corner of local maps, the
+// arrival stairs of dungeon floors
+static void stats_start(const LocalMap* local, int* x, int* y)
+{
+    bool dungeon = local->worldTile == '>';
+    *x = dungeon ? local->width / 2 : 2;
+    *y = dungeon ? local->height / 2 : 2;
+}
+
+// Statistics of a local map, recomputed only if it changed since they were
+// last taken; NULL if the labeling scratch couldn't be had (main thread)
+const MapStats* local_map_stats(LocalMap* local)
+{
+    MapStats* stats = &local->stats;
+    if (stats->valid && stats->version == local->changes.version) return stats;
+    
+    stats_reserve(local->width * local->height);
+    if (local->width * local->height > statsScratch.capacity || local->width > SAVE_MAX_MAP_SIDE) return NULL;
+    
+    stats_histogram(local->tiles[0], (size_t)local->width * local->height, stats->tileCount);
+    
+    // Bodies of water
+    uint32_t at;
+    int unused;
+    stats->largestLake = stats_label(local->width, local->height, [&](int y) {
+        stats_water_bits(local->tiles[y], local->width, statsScratch.bits);
+        return (const uint64_t*)statsScratch.bits;
+    }, -1, -1, &at, &unused);
+    stats->lakeX = stats->largestLake > 0 ? (int)(at & 0xFFFF) : -1;
+    stats->lakeY = stats->largestLake > 0 ? (int)(at >> 16) : -1;
+    
+    // Walkable ground, straight from the passability bits
+    int startX, startY;
+    stats_start(local, &startX, &startY);
+    stats_label(local->width, local->height, [&](int y) {
+        return (const uint64_t*)&local->passable.words[(size_t)y * local->passable.stride];
+    }, startX, startY, &at, &stats->reachable);
+    stats->passable = local->width * local->height - map_stats_count(stats, '#');
+    
+    stats->version = local->changes.version;
+    stats->valid = true;
+    return stats;
+}
+
+// Tiles of one kind on the map (0 for kinds not counted)
+int map_stats_count(const MapStats* stats, char tile)
+{
+    for (int k = 0; k < STAT_TILE_KINDS; k++)
+    {
+        if (statTiles[k] == tile) return stats->tileCount[k];
+    }
+    return 0;
+}
+
+// Can every passable tile be reached from where the map starts?
+bool map_stats_connected(const MapStats* stats)
+{
+    return stats->reachable == stats->passable;
+}
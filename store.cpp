@@ -0,0 +1,352 @@
+#include "project.h"
+
+#if defined(_WIN32)
+    #include <direct.h>
+    #define store_mkdir(path) _mkdir(path)
+#else
+    #include <sys/stat.h>
+    #define store_mkdir(path) mkdir(path, 0755)
+#endif
+
+// Content-addressed object store shared by every save slot. Each object is
+// one framed save section (the world grid, its explored bits, one generated
+// map) in a file named by the hash of its bytes, so a map that didn't change
+// between saves, or that another slot already holds, is on disk only once.
+// The index lists every object written, for the collector to sweep once the
+// slots that referenced an object are gone. Objects move in batches through
+// io_run. Writing and collecting happen only in the save chain, one save at
+// a time; reading is safe anywhere.
+
+#define STORE_PRIME1 0x9E3779B185EBCA87ull
+#define STORE_PRIME2 0xC2B2AE3D27D4EB4Full
+#define STORE_PRIME3 0x165667B19E3779F9ull
+#define STORE_PRIME4 0x85EBCA77C2B2AE63ull
+#define STORE_PRIME5 0x27D4EB2F165667C5ull
+
+// Objects known to be on disk (open addressing, 0 = empty slot)
+typedef struct {
+    uint64_t* slots;
+    int count;
+    int capacity;
+    bool loaded;            // Index read in
+} StoreIndex;
+
+static StoreIndex storeIndex;
+
+static uint64_t store_rotl(uint64_t v, int bits)
+{
+    return (v << bits) | (v >> (64 - bits));
+}
+
+static uint64_t store_read64(const uint8_t* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// One lane step of the hash
+static uint64_t store_round(uint64_t acc, uint64_t input)
+{
+    acc += input * STORE_PRIME2;
+    return store_rotl(acc, 31) * STORE_PRIME1;
+}
+
+static uint64_t store_merge(uint64_t h, uint64_t lane)
+{
+    h ^= store_round(0, lane);
+    return h * STORE_PRIME1 + STORE_PRIME4;
+}
+
+// xxHash64 of an object's bytes (never 0, which marks empty index slots)
+uint64_t store_hash(const void* data, size_t length)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    const uint8_t* end = p + length;
+    uint64_t h;
+    
+    // Four independent lanes over 32-byte stripes
+    if (length >= 32)
+    {
+        uint64_t v1 = STORE_PRIME1 + STORE_PRIME2;
+        uint64_t v2 = STORE_PRIME2;
+        uint64_t v3 = 0;
+        uint64_t v4 = 0 - STORE_PRIME1;
+        for (; p + 32 <= end; p += 32)
+        {
+            v1 = store_round(v1, store_read64(p));
+            v2 = store_round(v2, store_read64(p + 8));
+            v3 = store_round(v3, store_read64(p + 16));
+            v4 = store_round(v4, store_read64(p + 24));
+        }
+        h = store_rotl(v1, 1) + store_rotl(v2, 7) + store_rotl(v3, 12) + store_rotl(v4, 18);
+        h = store_merge(h, v1);
+        h = store_merge(h, v2);
+        h = store_merge(h, v3);
+        h = store_merge(h, v4);
+    }
+    else h = STORE_PRIME5;
+    
+    h += (uint64_t)length;
+    for (; p + 8 <= end; p += 8)
+    {
+        h ^= store_round(0, store_read64(p));
+        h = store_rotl(h, 27) * STORE_PRIME1 + STORE_PRIME4;
+    }
+    if (p + 4 <= end)
+    {
+        uint32_t word;
+        memcpy(&word, p, sizeof(word));
+        h ^= (uint64_t)word * STORE_PRIME1;
+        h = store_rotl(h, 23) * STORE_PRIME2 + STORE_PRIME3;
+        p += 4;
+    }
+    for (; p < end; p++)
+    {
+        h ^= *p * STORE_PRIME5;
+        h = store_rotl(h, 11) * STORE_PRIME1;
+    }
+    
+    h ^= h >> 33;
+    h *= STORE_PRIME2;
+    h ^= h >> 29;
+    h *= STORE_PRIME3;
+    h ^= h >> 32;
+    return h ? h : 1;
+}
+
+// Object file name
+static void store_filename(uint64_t hash, const char* suffix, char* filename, size_t size)
+{
+    snprintf(filename, size, SAVE_STORE_DIR "/%016llx.%s", (unsigned long long)hash, suffix);
+}
+
+// Index slots: the hashes themselves (never 0, which marks an empty slot)
+struct StoreKeys {
+    static bool empty(uint64_t hash) { return hash == 0; }
+    static uint64_t key(uint64_t hash) { return hash; }
+    static int home(uint64_t hash, int capacity) { return (int)(hash >> 7) & (capacity - 1); }
+};
+
+static bool store_known(uint64_t hash)
+{
+    return hash_find<StoreKeys>(storeIndex.slots, storeIndex.count, storeIndex.capacity, hash) != NULL;
+}
+
+// Remember an object as stored (false if the table can't grow)
+static bool store_remember(uint64_t hash)
+{
+    if (store_known(hash)) return true;
+    if (!hash_reserve<StoreKeys>(&storeIndex.slots, storeIndex.count, &storeIndex.capacity, 256, MEM_SAVE)) return false;
+    
+    hash_insert<StoreKeys>(storeIndex.slots, storeIndex.capacity, hash);
+    storeIndex.count++;
+    return true;
+}
+
+// Read the index on first use (a missing one is an empty store)
+static void store_load_index()
+{
+    if (storeIndex.loaded) return;
+    storeIndex.loaded = true;
+    store_mkdir(SAVE_STORE_DIR);
+    
+    FILE* file = fopen(SAVE_STORE_DIR "/index.dat", "rb");
+    if (!file) return;
+    
+    uint64_t hashes[512];
+    size_t count;
+    while ((count = fread(hashes, sizeof(uint64_t), 512, file)) > 0)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (hashes[i] != 0) store_remember(hashes[i]);
+        }
+    }
+    fclose(file);
+}
+
+// Move a finished file over its final name. POSIX rename swaps it in
+// atomically; Windows refuses an existing target, so it goes first there.
+bool store_replace(const char* temp, const char* filename)
+{
+#if defined(_WIN32)
+    remove(filename);
+#endif
+    return rename(temp, filename) == 0;
+}
+
+static int store_compare_objects(const void* a, const void* b)
+{
+    uint64_t x = ((const StoreObject*)a)->hash, y = ((const StoreObject*)b)->hash;
+    return x < y ? -1 : x > y;
+}
+
+// Close a written batch: whole objects are renamed in, the rest removed,
+// and the batch is listed in the index with one append
+static bool store_commit(const IoRequest* requests, const uint64_t* hashes, int count, bool ok)
+{
+    for (int i = 0; i < count; i++)
+    {
+        char filename[64];
+        char temp[64];
+        store_filename(hashes[i], "obj", filename, sizeof(filename));
+        store_filename(hashes[i], "tmp", temp, sizeof(temp));
+        
+        bool written = io_close(requests[i].fd) && ok;
+        if (written) written = store_replace(temp, filename);
+        else remove(temp);
+        ok = ok && written;
+    }
+    if (!ok || count == 0) return ok;
+    
+    // Listed before any slot refers to them, so the collector can find them
+    FILE* index = fopen(SAVE_STORE_DIR "/index.dat", "ab");
+    if (!index) return false;
+    ok = fwrite(hashes, sizeof(uint64_t), (size_t)count, index) == (size_t)count;
+    ok = (fclose(index) == 0) && ok;
+    for (int i = 0; i < count && ok; i++) ok = store_remember(hashes[i]);
+    return ok;
+}
+
+// Write the objects the store doesn't have yet, IO_BATCH files at a time
+// (objects is sorted by hash on the way). Each is written next to its
+// final name and renamed, so a stored object is always whole.
+bool store_write(StoreObject* objects, int count, uint8_t* buffer, size_t size)
+{
+    store_load_index();
+    qsort(objects, (size_t)count, sizeof(StoreObject), store_compare_objects);
+    
+    IoSession io;
+    io_begin(&io, buffer, size);
+    IoRequest requests[IO_BATCH];
+    uint64_t hashes[IO_BATCH];
+    bool stored = true;
+    int i = 0;
+    while (i < count && stored)
+    {
+        // Open the next batch, each new object once
+        int n = 0;
+        bool ok = true;
+        for (; i < count && n < IO_BATCH; i++)
+        {
+            uint64_t hash = objects[i].hash;
+            if (store_known(hash) || (i > 0 && objects[i - 1].hash == hash)) continue;
+            
+            char temp[64];
+            store_filename(hash, "tmp", temp, sizeof(temp));
+            int fd = io_open(temp, true);
+            if (fd < 0) {
+                ok = false;
+                break;
+            }
+            requests[n] = (IoRequest){ fd, 0, objects[i].data, objects[i].length, true, false };
+            hashes[n++] = hash;
+        }
+        
+        if (ok && n > 0) ok = io_run(&io, requests, n);
+        stored = store_commit(requests, hashes, n, ok);
+    }
+    io_end(&io);
+    return stored;
+}
+
+// Read whole objects into their places in buffer, IO_BATCH files at a
+// time; false if any is missing or shorter than asked
+bool store_read(StoreObject* objects, int count, uint8_t* buffer, size_t size)
+{
+    IoSession io;
+    io_begin(&io, buffer, size);
+    IoRequest requests[IO_BATCH];
+    bool ok = true;
+    for (int first = 0; first < count && ok; first += IO_BATCH)
+    {
+        int n = 0;
+        for (int i = first; i < count && n < IO_BATCH; i++)
+        {
+            char filename[64];
+            store_filename(objects[i].hash, "obj", filename, sizeof(filename));
+            int fd = io_open(filename, false);
+            if (fd < 0) {
+                ok = false;
+                break;
+            }
+            requests[n++] = (IoRequest){ fd, 0, objects[i].data, objects[i].length, false, false };
+        }
+        
+        if (ok && n > 0) ok = io_run(&io, requests, n);
+        for (int i = 0; i < n; i++) io_close(requests[i].fd);
+    }
+    io_end(&io);
+    return ok;
+}
+
+// Is an object in the store? (save chain only, like writing)
+bool store_has(uint64_t hash)
+{
+    store_load_index();
+    return store_known(hash);
+}
+
+// Open an object for reading, NULL if the store doesn't have it
+FILE* store_open(uint64_t hash)
+{
+    char filename[64];
+    store_filename(hash, "obj", filename, sizeof(filename));
+    return fopen(filename, "rb");
+}
+
+static int store_compare(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Delete every object not in keep (sorted in place) and rewrite the index
+// with the rest; an object is deleted only after it left the index
+void store_collect(uint64_t* keep, int count)
+{
+    store_load_index();
+    qsort(keep, (size_t)count, sizeof(uint64_t), store_compare);
+    
+    FILE* file = fopen(SAVE_STORE_DIR "/index.tmp", "wb");
+    if (!file) return;
+    bool ok = true;
+    for (int i = 0; i < storeIndex.capacity; i++)
+    {
+        uint64_t hash = storeIndex.slots[i];
+        if (hash == 0 || !bsearch(&hash, keep, (size_t)count, sizeof(uint64_t), store_compare)) continue;
+        ok = fwrite(&hash, sizeof(hash), 1, file) == 1 && ok;
+    }
+    ok = (fclose(file) == 0) && ok;
+    ok = ok && store_replace(SAVE_STORE_DIR "/index.tmp", SAVE_STORE_DIR "/index.dat");
+    if (!ok) {
+        remove(SAVE_STORE_DIR "/index.tmp");
+        return;
+    }
+    
+    // Drop the swept objects from the table, reinserting the survivors
+    uint64_t* slots = storeIndex.slots;
+    int capacity = storeIndex.capacity;
+    memset(&storeIndex, 0, sizeof(storeIndex));
+    storeIndex.loaded = true;
+    for (int i = 0; i < capacity; i++)
+    {
+        uint64_t hash = slots[i];
+        if (hash == 0) continue;
+        if (bsearch(&hash, keep, (size_t)count, sizeof(uint64_t), store_compare)) store_remember(hash);
+        else {
+            char filename[64];
+            store_filename(hash, "obj", filename, sizeof(filename));
+            remove(filename);
+        }
+    }
+    mem_free(slots);
+}
+
+// Forget the index (at shutdown)
+void store_shutdown()
+{
+    mem_free(storeIndex.slots);
+    memset(&storeIndex, 0, sizeof(storeIndex));
+}
@@ -0,0 +1,629 @@
+#include "project.h"
+
+#if !defined(_WIN32)
+    #include <termios.h>
+    #include <unistd.h>
+    #include <poll.h>
+    #include <signal.h>
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <sys/ioctl.h>
+#endif
+
+// Terminal front end: the game in a text terminal, over SSH or on a machine
+// without a display. Each frame is composed into a grid of cells (glyph and
+// true colour) and compared with the grid the terminal already shows; only
+// the cells that differ are sent, so a step costs a few dozen bytes. The
+// map view pages rather than scrolls: it recentres only when the player
+// nears its edge. Keys come from the terminal in raw mode.
+
+#define TERM_HUD_ROWS 4             // Text rows under the map
+#define TERM_CELL_BYTES 32          // Most escape bytes one cell can need
+
+// One character cell
+typedef struct {
+    char glyph;
+    uint8_t r, g, b;
+} TermCell;
+
+typedef struct {
+    TermCell* front;        // What the terminal shows
+    TermCell* back;         // Frame being composed
+    char* out;              // Escapes for one frame
+    size_t outCapacity;
+    int columns;
+    int rows;
+    bool repaint;           // Clear the screen and send every cell
+    bool offscreen;         // Frames are composed but never sent (headless)
+    TermCell pen;           // Colour the terminal writes in
+    bool penSet;            // False until a colour was sent
+    
+    // Map view
+    const void* viewMap;
+    int viewX;
+    int viewY;
+    
+    double nextFrame;
+    long frames;
+    uint64_t bytes;
+    size_t maxBytes;
+} Terminal;
+
+static Terminal term;
+
+static void term_free()
+{
+    mem_free(term.front);
+    mem_free(term.back);
+    mem_free(term.out);
+    term.front = term.back = NULL;
+    term.out = NULL;
+}
+
+// Grids and escape buffer for a screen of this size, repainted in full
+static bool term_alloc(int columns, int rows)
+{
+    term_free();
+    size_t cells = (size_t)columns * rows;
+    term.front = (TermCell*)mem_alloc(MEM_RENDER, cells * sizeof(TermCell));
+    term.back = (TermCell*)mem_alloc(MEM_RENDER, cells * sizeof(TermCell));
+    term.outCapacity = cells * TERM_CELL_BYTES + 64;
+    term.out = (char*)mem_alloc(MEM_RENDER, term.outCapacity);
+    if (!term.front || !term.back || !term.out) {
+        term_free();
+        term.columns = term.rows = 0;
+        return false;
+    }
+    
+    term.columns = columns;
+    term.rows = rows;
+    term.repaint = true;
+    term.viewMap = NULL;
+    return true;
+}
+
+#if !defined(_WIN32)
+
+static struct termios termSaved;
+static struct termios termRaw;
+static volatile sig_atomic_t termResized = 0;
+static volatile sig_atomic_t termQuit = 0;
+static int termWake[2] = { -1, -1 };    // Handlers write a byte to end an idle wait
+
+// Signals the terminal handles, and the handlers it put aside for them
+static const int termSignals[] = { SIGWINCH, SIGINT, SIGTERM, SIGTSTP, SIGCONT };
+#define TERM_SIGNALS ((int)(sizeof(termSignals) / sizeof(termSignals[0])))
+static struct sigaction termSavedActions[TERM_SIGNALS];
+
+static const char termEnter[] = "\x1b[?1049h\x1b[?25l\x1b[?7l";
+static const char termLeave[] = "\x1b[0m\x1b[?7h\x1b[?25h\x1b[?1049l";
+
+// Steady clock, seconds
+static double term_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Send bytes, however many writes it takes
+static void term_write(const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = write(STDOUT_FILENO, data, size);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return;
+        data += written;
+        size -= (size_t)written;
+    }
+}
+
+// Back to the shell's screen and line mode (safe in a signal handler)
+static void term_leave()
+{
+    term_write(termLeave, sizeof(termLeave) - 1);
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &termSaved);
+}
+
+// Raw mode on the alternate screen, cursor hidden, no line wrap (safe in a
+// signal handler)
+static void term_enter()
+{
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &termRaw);
+    term_write(termEnter, sizeof(termEnter) - 1);
+}
+
+static void term_signal(int sig)
+{
+    int savedErrno = errno;
+    if (sig == SIGWINCH) termResized = 1;
+    else if (sig == SIGTSTP)
+    {
+        // Ctrl-Z: give the shell its screen back, then stop for real with
+        // the default action; execution resumes here once continued
+        term_leave();
+        struct sigaction stop, ours;
+        memset(&stop, 0, sizeof(stop));
+        stop.sa_handler = SIG_DFL;
+        sigemptyset(&stop.sa_mask);
+        sigaction(SIGTSTP, &stop, &ours);
+        
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGTSTP);
+        pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+        raise(SIGTSTP);
+        sigaction(SIGTSTP, &ours, NULL);
+    }
+    else if (sig == SIGCONT)
+    {
+        // Continued (fg, or kill -CONT): take the screen again and repaint
+        // all of it, the shell drew over it and the size may have changed
+        term_enter();
+        termResized = 1;
+    }
+    else termQuit = 1;
+    
+    // A wait with no time limit may be about to start; it must not miss this
+    ssize_t woken = write(termWake[1], "", 1);
+    (void)woken;
+    errno = savedErrno;
+}
+
+// Size the grids to the window and repaint it all
+static bool term_resize()
+{
+    struct winsize size;
+    int columns = 80, rows = 24;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0 && size.ws_row > 0) {
+        columns = size.ws_col;
+        rows = size.ws_row;
+    }
+    if (term.front != NULL && columns == term.columns && rows == term.rows) {
+        term.repaint = true;
+        return true;
+    }
+    return term_alloc(columns, rows);
+}
+
+// Put the signal handlers back, then the shell's screen and line mode
+static void term_restore()
+{
+    for (int i = 0; i < TERM_SIGNALS; i++) sigaction(termSignals[i], &termSavedActions[i], NULL);
+    term_leave();
+    close(termWake[0]);
+    close(termWake[1]);
+    termWake[0] = termWake[1] = -1;
+}
+
+// Raw mode on the alternate screen; signals still work, so Ctrl-C quits
+// like closing the window would and Ctrl-Z suspends to the shell
+static bool term_open()
+{
+    if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO)) {
+        fprintf(stderr, "terminal: stdin and stdout must be a terminal\n");
+        return false;
+    }
+    if (tcgetattr(STDIN_FILENO, &termSaved) != 0 || pipe(termWake) != 0) return false;
+    for (int i = 0; i < 2; i++) fcntl(termWake[i], F_SETFL, fcntl(termWake[i], F_GETFL, 0) | O_NONBLOCK);
+    
+    termRaw = termSaved;
+    termRaw.c_iflag &= ~(tcflag_t)(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    termRaw.c_lflag &= ~(tcflag_t)(ECHO | ICANON | IEXTEN);
+    termRaw.c_cflag |= CS8;
+    termRaw.c_cc[VMIN] = 0;
+    termRaw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &termRaw) != 0) {
+        close(termWake[0]);
+        close(termWake[1]);
+        termWake[0] = termWake[1] = -1;
+        return false;
+    }
+    
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = term_signal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    for (int i = 0; i < TERM_SIGNALS; i++) sigaction(termSignals[i], &action, &termSavedActions[i]);
+    
+    term_write(termEnter, sizeof(termEnter) - 1);
+    
+    // No window, no audio: the game runs as it does headless
+    headlessMode = true;
+    if (!term_resize()) {
+        term_restore();
+        return false;
+    }
+    term.nextFrame = term_now();
+    return true;
+}
+
+static void term_close()
+{
+    term_restore();
+    term_free();
+    if (term.frames > 0) {
+        fprintf(stderr, "terminal: %ld frames, %.1f bytes per frame, largest %zu\n",
+                term.frames, (double)term.bytes / term.frames, term.maxBytes);
+    }
+    memset(&term, 0, sizeof(term));
+}
+
+static bool term_should_close()
+{
+    return termQuit != 0;
+}
+
+// Sleep until a key arrives or the time is up (seconds < 0: no time
+// limit); a signal cuts it short either way, even one that came just
+// before the wait began
+static void term_idle(double seconds)
+{
+    struct pollfd fds[2] = { { STDIN_FILENO, POLLIN, 0 }, { termWake[0], POLLIN, 0 } };
+    poll(fds, 2, seconds < 0.0 ? -1 : (int)(seconds * 1000.0));
+    
+    char drain[64];
+    while (read(termWake[0], drain, sizeof(drain)) > 0) {}
+}
+
+static void term_key(int key)
+{
+    input.pressed |= input_key_mask(key);
+}
+
+// Escape sequence after ESC [ or ESC O; returns bytes used
+static int term_escape(const unsigned char* p, int count)
+{
+    int number = 0;
+    int i = 0;
+    while (i < count && p[i] >= '0' && p[i] <= '9') number = number * 10 + (p[i++] - '0');
+    while (i < count && (p[i] < 0x40 || p[i] > 0x7E)) i++;
+    if (i == count) return count;
+    
+    switch (p[i])
+    {
+        case 'A': term_key(KEY_UP); break;
+        case 'B': term_key(KEY_DOWN); break;
+        case 'C': term_key(KEY_RIGHT); break;
+        case 'D': term_key(KEY_LEFT); break;
+        case 'R': term_key(KEY_F3); break;
+        case '~':
+            if (number == 13) term_key(KEY_F3);
+            else if (number == 15) term_key(KEY_F5);
+            else if (number == 20) term_key(KEY_F9);
+            break;
+    }
+    return i + 1;
+}
+
+// Latch the keys typed since the last frame. Terminals send presses (and
+// auto-repeats of held keys) but no releases, so nothing counts as held.
+static void term_poll()
+{
+    if (termResized) {
+        termResized = 0;
+        term_resize();
+        mark_frame_dirty();
+    }
+    
+    unsigned char bytes[256];
+    ssize_t count;
+    unsigned int before = input.pressed;
+    while ((count = read(STDIN_FILENO, bytes, sizeof(bytes))) > 0)
+    {
+        for (int i = 0; i < count;)
+        {
+            unsigned char c = bytes[i++];
+            if (c == 0x1b) {
+                // A lone ESC is the key; ESC [ and ESC O start a sequence
+                if (i < count && (bytes[i] == '[' || bytes[i] == 'O')) {
+                    i++;
+                    i += term_escape(bytes + i, (int)count - i);
+                }
+                else term_key(KEY_ESCAPE);
+            }
+            else if (c == '\r' || c == '\n') term_key(KEY_ENTER);
+            else if (c == 127 || c == 8) term_key(KEY_BACKSPACE);
+            else if (c == ' ') term_key(KEY_SPACE);
+            else if (c >= 'a' && c <= 'z') term_key(c - 'a' + 'A');
+            else if (c >= 'A' && c <= 'Z') term_key(c);
+        }
+    }
+    input.down = 0;
+    
+    if (input.pressed != before) mark_frame_dirty();
+}
+
+static bool term_needs_redraw(float alpha)
+{
+    return term.front != NULL && (term.repaint || game_needs_redraw(alpha));
+}
+
+#endif
+
+// Columns and rows of the terminal (0 when it isn't in use)
+int term_columns()
+{
+    return term.columns;
+}
+
+int term_rows()
+{
+    return term.rows;
+}
+
+// Put one glyph in the frame being composed
+static void term_put(int column, int row, char glyph, Color color)
+{
+    if (column < 0 || row < 0 || column >= term.columns || row >= term.rows) return;
+    TermCell* cell = &term.back[row * term.columns + column];
+    cell->glyph = glyph;
+    cell->r = color.r;
+    cell->g = color.g;
+    cell->b = color.b;
+}
+
+// Write a line of text into the frame, clipped to the screen
+void term_text(int column, int row, const char* text, Color color)
+{
+    if (term.back == NULL) return;
+    for (; *text; text++, column++) term_put(column, row, *text, color);
+}
+
+// Remembered but out of sight, as the window's 40% fade over black
+static Color term_dim(Color color)
+{
+    return (Color){ (unsigned char)(color.r * 2 / 5), (unsigned char)(color.g * 2 / 5),
+                    (unsigned char)(color.b * 2 / 5), 255 };
+}
+
+// Place the view so the player is well inside it, only moving it when the
+// player comes within a quarter of its size of an edge (or the map changed)
+static void term_place_view(const void* map, int width, int height, int px, int py, int columns, int rows)
+{
+    int marginX = columns / 4, marginY = rows / 4;
+    if (map == term.viewMap && px >= term.viewX + marginX && px < term.viewX + columns - marginX &&
+        py >= term.viewY + marginY && py < term.viewY + rows - marginY) return;
+    
+    term.viewMap = map;
+    term.viewX = px - columns / 2;
+    term.viewY = py - rows / 2;
+    if (term.viewX > width - columns) term.viewX = width - columns;
+    if (term.viewY > height - rows) term.viewY = height - rows;
+    if (term.viewX < 0) term.viewX = 0;
+    if (term.viewY < 0) term.viewY = 0;
+}
+
+// The visible part of the current map, its creatures and the player
+static void term_draw_map()
+{
+    LocalMap* local = isInLocalMap ? current_local_map() : NULL;
+    int width = local ? local->width : currentMapWidth;
+    int height = local ? local->height : currentMapHeight;
+    int px = local ? localPlayer.x : player.x;
+    int py = local ? localPlayer.y : player.y;
+    int rows = term.rows - TERM_HUD_ROWS;
+    if (rows <= 0) return;
+    
+    const void* map = local ? (const void*)local : (const void*)worldMap;
+    term_place_view(map, width, height, px, py, term.columns, rows);
+    
+    // Field of view only applies when it was computed for this map (on the
+    // world it covers the world map's view)
+    TileRect fovArea = local ? (TileRect){ 0, 0, width, height } : worldMap->view;
+    bool haveFov = fovVisible.width == fovArea.x1 - fovArea.x0 && fovVisible.height == fovArea.y1 - fovArea.y0;
+    int x1 = term.viewX + term.columns < width ? term.viewX + term.columns : width;
+    int y1 = term.viewY + rows < height ? term.viewY + rows : height;
+    for (int y = term.viewY; y < y1; y++)
+    {
+        for (int x = term.viewX; x < x1; x++)
+        {
+            // Fog of war: never-seen tiles stay black
+            if (local ? !bitgrid_get(&local->explored, x, y) : !world_explored(x, y)) continue;
+            
+            char tile = local ? local->tiles[y][x] : world_tile(x, y);
+            Color color = local ? get_tile_color(tile) : world_tile_color(x, y);
+            bool inSight = haveFov && x >= fovArea.x0 && y >= fovArea.y0 && x < fovArea.x1 && y < fovArea.y1 &&
+                           bitgrid_get(&fovVisible, x - fovArea.x0, y - fovArea.y0);
+            if (!inSight) color = term_dim(color);
+            term_put(x - term.viewX, y - term.viewY, tile, color);
+        }
+    }
+    
+    // Creatures in sight, as the window draws them
+    if (local != NULL && haveFov)
+    {
+        const EntityStore* store = &local->entities;
+        for (int i = 0; i < store->count; i++)
+        {
+            int x = store->x[i], y = store->y[i];
+            if (x < term.viewX || x >= x1 || y < term.viewY || y >= y1 || !bitgrid_get(&fovVisible, x, y)) continue;
+            term_put(x - term.viewX, y - term.viewY, store->glyph[i], store->aiState[i] == AI_CHASE ? RED : LIGHTGRAY);
+        }
+    }
+    
+    term_put(px - term.viewX, py - term.viewY, 'D', YELLOW);
+}
+
+// Position, terrain hints, the key help (or a status message) and, on
+// local maps, the map's statistics as the window's HUD shows them
+static void term_draw_hud()
+{
+    int row = term.rows - TERM_HUD_ROWS;
+    const FeatureFields* fields = isInLocalMap ? &current_local_map()->fields : &worldFields;
+    int hereX = isInLocalMap ? localPlayer.x : player.x - worldMap->view.x0;
+    int hereY = isInLocalMap ? localPlayer.y : player.y - worldMap->view.y0;
+    const char* hints = TextFormat("Nearest water: %s | forest: %s",
+                                   hud_feature_hint(fields, FEATURE_WATER, hereX, hereY),
+                                   hud_feature_hint(fields, FEATURE_FOREST, hereX, hereY));
+    
+    if (isInLocalMap)
+    {
+        const LocalMap* local = current_local_map();
+        term_text(0, row, TextFormat("%s %d,%d | Map %dx%d | Depth %d | %s",
+                                     playerStack.depth > 1 ? "Dungeon" : "Local", localPlayer.x, localPlayer.y,
+                                     local->width, local->height, playerStack.depth, hints), LIGHTGRAY);
+        term_text(0, row + 1, "ENTER on >: Go Down | BACKSPACE: Go Up | F5: Save | F9: Load", LIGHTGRAY);
+        
+        const MapStats* stats = local_map_stats(current_local_map());
+        if (stats != NULL)
+        {
+            int tiles = local->width * local->height;
+            term_text(0, row + 3, TextFormat("Water %d%% | Forest %d%% | Largest lake: %d | All reachable: %s",
+                                             map_stats_count(stats, '~') * 100 / tiles, map_stats_count(stats, 'T') * 100 / tiles,
+                                             stats->largestLake, map_stats_connected(stats) ? "yes" : "no"), LIGHTGRAY);
+        }
+    }
+    else
+    {
+        term_text(0, row, TextFormat("World %d,%d | Tile %c | %s", player.x, player.y,
+                                     world_tile(player.x, player.y), hints), LIGHTGRAY);
+        term_text(0, row + 1, "ENTER: Enter Local Area | F5: Save | F9: Load", LIGHTGRAY);
+    }
+    term_text(0, row + 2, "WASD/Arrows: Move | BACKSPACE: Menu/Exit | Ctrl-C: Quit", LIGHTGRAY);
+}
+
+// Append a cursor move or colour change
+static size_t term_emit(size_t at, const char* text)
+{
+    size_t length = strlen(text);
+    memcpy(term.out + at, text, length);
+    return at + length;
+}
+
+// Send the cells that differ from what the terminal shows, in one write.
+// Runs of changed cells need no cursor moves, and a colour is only sent
+// when it changes; blanks are drawn in whatever colour is current.
+static void term_present()
+{
+    size_t at = 0;
+    if (term.repaint)
+    {
+        at = term_emit(at, "\x1b[0m\x1b[2J");
+        memset(term.front, 0, (size_t)term.columns * term.rows * sizeof(TermCell));
+        for (int i = 0; i < term.columns * term.rows; i++) term.front[i].glyph = ' ';
+        term.penSet = false;
+        term.repaint = false;
+    }
+    
+    int cursor = -1;
+    for (int i = 0; i < term.columns * term.rows; i++)
+    {
+        TermCell cell = term.back[i];
+        TermCell shown = term.front[i];
+        if (cell.glyph == shown.glyph && (cell.glyph == ' ' || (cell.r == shown.r && cell.g == shown.g && cell.b == shown.b))) continue;
+        
+        if (i != cursor) at = term_emit(at, TextFormat("\x1b[%d;%dH", i / term.columns + 1, i % term.columns + 1));
+        if (cell.glyph != ' ' && (!term.penSet || cell.r != term.pen.r || cell.g != term.pen.g || cell.b != term.pen.b)) {
+            at = term_emit(at, TextFormat("\x1b[38;2;%d;%d;%dm", cell.r, cell.g, cell.b));
+            term.pen = cell;
+            term.penSet = true;
+        }
+        term.out[at++] = cell.glyph;
+        term.front[i] = cell;
+        
+        // The cursor stays put after the last column (no wrap)
+        cursor = (i + 1) % term.columns == 0 ? -1 : i + 1;
+    }
+
+#if !defined(_WIN32)
+    if (!term.offscreen) term_write(term.out, at);
+#endif
+    term.frames++;
+    term.bytes += at;
+    if (at > term.maxBytes) term.maxBytes = at;
+}
+
+// Compose the frame for the current screen into the back grid
+static void term_compose()
+{
+    for (int i = 0; i < term.columns * term.rows; i++) term.back[i] = (TermCell){ ' ', 0, 0, 0 };
+    
+    if (currentState == STATE_TITLE) title_draw();
+    else if (currentState == STATE_MAPSIZE) mapsize_draw();
+    else if (currentState == STATE_SAVE_MENU) save_menu_draw();
+    else if (currentState == STATE_LOAD_MENU) load_menu_draw();
+    else if (currentState == STATE_PLAYING)
+    {
+        term_draw_map();
+        term_draw_hud();
+    }
+    
+    const char* status = game_status_message();
+    if (status != NULL) term_text((term.columns - (int)strlen(status)) / 2, 0, status, ORANGE);
+}
+
+// Compose the frame for the current screen and send what changed; paced
+// to TERMINAL_FPS like the window's frame cap
+static void term_draw(float alpha)
+{
+    (void)alpha;
+    if (term.back == NULL) return;
+
+#if !defined(_WIN32)
+    double now = term_now();
+    if (now < term.nextFrame) term_idle(term.nextFrame - now);
+    term.nextFrame = (now > term.nextFrame ? now : term.nextFrame) + 1.0 / TERMINAL_FPS;
+#endif
+    
+    term_compose();
+    term_present();
+    game_frame_drawn();
+}
+
+// Headless draws: frames are composed and diffed as for a terminal of this
+// size, unpaced, and the escapes are dropped instead of written. A headless
+// replay draws through this, so the draw side runs (and its allocations
+// count) with no window and no terminal.
+bool term_open_offscreen(int columns, int rows)
+{
+    memset(&term, 0, sizeof(term));
+    term.offscreen = true;
+    return term_alloc(columns, rows);
+}
+
+void term_draw_offscreen()
+{
+    if (term.back == NULL) return;
+    term_compose();
+    term_present();
+    game_frame_drawn();
+}
+
+void term_close_offscreen()
+{
+    term_free();
+    memset(&term, 0, sizeof(term));
+}
+
+#if defined(_WIN32)
+
+// Raw console input isn't wired up on Windows; the window is the front end
+static bool term_open()
+{
+    fprintf(stderr, "terminal: not available on this platform\n");
+    return false;
+}
+
+static void term_close() {}
+static double term_now() { return GetTime(); }
+static void term_idle(double seconds) { WaitTime(seconds); }
+static bool term_should_close() { return true; }
+static void term_poll() {}
+static bool term_needs_redraw(float alpha) { (void)alpha; return false; }
+
+#endif
+
+const Frontend terminalFrontend = {
+    "terminal",
+    term_open,
+    term_close,
+    term_now,
+    term_idle,
+    term_should_close,
+    term_poll,
+    term_needs_redraw,
+    term_draw
+};
@@ -0,0 +1,400 @@
+#include "project.h"
+
+// GPU tilemap: each map lives in a two-byte-per-tile texture (tile byte,
+// state bits) and one shaded quad draws every visible tile. Unchanged tiles
+// are never re-uploaded; edits and field of view changes mark dirty rects.
+
+// State bits stored next to each tile byte
+#define CELL_EXPLORED 1
+#define CELL_VISIBLE 2
+#define CELL_HAS_LOCAL 4
+#define CELL_VISITED 8
+
+#define ATLAS_COLUMNS 16        // Glyph atlas is 16x16 cells of TILE_SIZE
+
+// One uploaded map
+typedef struct {
+    Texture2D texture;
+    const void* owner;      // worldMap or a LocalMap, NULL when empty
+    int width;              // Tiles the layer was built for
+    int height;
+    TileRect dirty;         // Tiles to re-upload before the next draw
+    TileRect fov;           // Field of view rect applied last
+    uint64_t version;       // Map edits already uploaded
+} TileLayer;
+
+// Fragment shader body shared by both GLSL versions. Everything is float
+// math so it also runs on GLSL 100 and software rasterizers (llvmpipe).
+static const char* tilemapShaderBody =
+    "uniform sampler2D texture0;\n"
+    "uniform sampler2D atlas;\n"
+    "uniform sampler2D palette;\n"
+    "uniform vec2 mapSize;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 cellPos = fragTexCoord * mapSize;\n"
+    "    vec2 cell = floor(cellPos);\n"
+    "    vec4 texel = TEX(texture0, (cell + 0.5) / mapSize);\n"
+    "    float id = floor(texel.r * 255.0 + 0.5);\n"
+    "    float state = floor(texel.a * 255.0 + 0.5);\n"
+    "    if (mod(state, 2.0) < 0.5) discard;\n"
+    "    vec2 glyph = vec2(mod(id, 16.0), floor(id / 16.0));\n"
+    "    float coverage = TEX(atlas, (glyph + fract(cellPos)) / 16.0).a;\n"
+    "    if (coverage <= 0.0) discard;\n"
+    "    vec4 color = TEX(palette, vec2((id + 0.5) / 256.0, 0.5));\n"
+    "    if (mod(floor(state / 4.0), 2.0) > 0.5) {\n"
+    "        if (mod(floor(state / 8.0), 2.0) > 0.5) color.rg = min(color.rg + 30.0 / 255.0, 1.0);\n"
+    "        else color.rgb = max(color.rgb - 20.0 / 255.0, 0.0);\n"
+    "    }\n"
+    "    if (mod(floor(state / 2.0), 2.0) < 0.5) color.a *= 0.4;\n"
+    "    OUT = vec4(color.rgb, color.a * coverage) * fragColor;\n"
+    "}\n";
+
+static const char* tilemapHeader330 =
+    "#version 330\n"
+    "in vec2 fragTexCoord;\n"
+    "in vec4 fragColor;\n"
+    "out vec4 finalColor;\n"
+    "#define TEX texture\n"
+    "#define OUT finalColor\n";
+
+static const char* tilemapHeader100 =
+    "#version 100\n"
+    "precision mediump float;\n"
+    "varying vec2 fragTexCoord;\n"
+    "varying vec4 fragColor;\n"
+    "#define TEX texture2D\n"
+    "#define OUT gl_FragColor\n";
+
+bool gpuTilemapEnabled = RENDER_GPU_TILEMAP;
+
+static bool tilemapTried = false;   // Shader setup ran (it only runs once)
+static bool tilemapReady = false;   // Shader compiled, textures loaded
+static Shader tilemapShader;
+static int atlasLoc, paletteLoc, mapSizeLoc;
+static Texture2D atlasTexture;
+static int atlasFontSize = 0;
+static Texture2D paletteTexture;
+static TileLayer worldLayer;
+static TileLayer localLayer;
+
+// Latest field of view rect, so a fresh upload knows what it covered
+static const void* fovOwner = NULL;
+static TileRect fovRect = { 0, 0, 0, 0 };
+
+// Upload staging, two bytes per tile, grown to the largest rect uploaded
+static uint8_t* uploadBuffer = NULL;
+static size_t uploadCapacity = 0;
+
+static bool rect_empty(TileRect r)
+{
+    return r.x0 >= r.x1 || r.y0 >= r.y1;
+}
+
+static TileRect rect_union(TileRect a, TileRect b)
+{
+    if (rect_empty(a)) return b;
+    if (rect_empty(b)) return a;
+    TileRect r = {
+        a.x0 < b.x0 ? a.x0 : b.x0, a.y0 < b.y0 ? a.y0 : b.y0,
+        a.x1 > b.x1 ? a.x1 : b.x1, a.y1 > b.y1 ? a.y1 : b.y1
+    };
+    return r;
+}
+
+static TileRect rect_clip(TileRect r, int width, int height)
+{
+    if (r.x0 < 0) r.x0 = 0;
+    if (r.y0 < 0) r.y0 = 0;
+    if (r.x1 > width) r.x1 = width;
+    if (r.y1 > height) r.y1 = height;
+    return r;
+}
+
+// Compile the shader for whichever GLSL the context accepts
+static bool tilemap_load_shader(const char* header)
+{
+    char source[2048];
+    snprintf(source, sizeof(source), "%s%s", header, tilemapShaderBody);
+    
+    tilemapShader = LoadShaderFromMemory(NULL, source);
+    
+    // raylib falls back to its default shader on errors, which lacks our uniforms
+    atlasLoc = GetShaderLocation(tilemapShader, "atlas");
+    paletteLoc = GetShaderLocation(tilemapShader, "palette");
+    mapSizeLoc = GetShaderLocation(tilemapShader, "mapSize");
+    if (atlasLoc >= 0 && paletteLoc >= 0 && mapSizeLoc >= 0) return true;
+    
+    UnloadShader(tilemapShader);
+    return false;
+}
+
+// One-time setup: shader and tile colour palette
+static bool tilemap_init()
+{
+    if (tilemapTried) return tilemapReady;
+    tilemapTried = true;
+    
+    if (!tilemap_load_shader(tilemapHeader330) && !tilemap_load_shader(tilemapHeader100)) {
+        TraceLog(LOG_WARNING, "TILEMAP: shader unavailable, drawing tiles on the CPU");
+        return false;
+    }
+    
+    // Tile byte -> colour, sampled by the shader
+    Image palette = GenImageColor(256, 1, BLANK);
+    for (int i = 0; i < 256; i++) {
+        ImageDrawPixel(&palette, i, 0, get_tile_color((char)i));
+    }
+    paletteTexture = LoadTextureFromImage(palette);
+    UnloadImage(palette);
+    
+    tilemapReady = true;
+    return true;
+}
+
+// Glyphs laid out by tile byte, drawn where the CPU path draws them
+static void tilemap_build_atlas(int fontSize)
+{
+    if (atlasFontSize == fontSize) return;
+    if (atlasFontSize != 0) UnloadTexture(atlasTexture);
+    
+    Image atlas = GenImageColor(ATLAS_COLUMNS * TILE_SIZE, ATLAS_COLUMNS * TILE_SIZE, BLANK);
+    char text[2] = { 0, 0 };
+    for (int c = 33; c < 127; c++)
+    {
+        text[0] = (char)c;
+        Vector2 pos = {
+            (float)((c % ATLAS_COLUMNS) * TILE_SIZE + 8),
+            (float)((c / ATLAS_COLUMNS) * TILE_SIZE + 6)
+        };
+        ImageDrawTextEx(&atlas, GetFontDefault(), text, pos, (float)fontSize, 1, WHITE);
+    }
+    atlasTexture = LoadTextureFromImage(atlas);
+    UnloadImage(atlas);
+    atlasFontSize = fontSize;
+}
+
+// Pack one tile and its state bits ((x, y) in view coordinates)
+static void tilemap_pack_world(int x, int y, uint8_t* out, bool haveFov)
+{
+    int worldX = worldMap->view.x0 + x, worldY = worldMap->view.y0 + y;
+    WorldTile cell = world_cell(worldX, worldY);
+    uint8_t state = 0;
+    if (world_explored(worldX, worldY)) state |= CELL_EXPLORED;
+    if (haveFov && bitgrid_get(&fovVisible, x, y)) state |= CELL_VISIBLE;
+    if (cell.hasLocalMap) state |= CELL_HAS_LOCAL;
+    if (cell.localMap != NULL) state |= CELL_VISITED;
+    out[0] = (uint8_t)cell.worldTile;
+    out[1] = state;
+}
+
+static void tilemap_pack_local(const LocalMap* local, int x, int y, uint8_t* out, bool haveFov)
+{
+    uint8_t state = 0;
+    if (bitgrid_get(&local->explored, x, y)) state |= CELL_EXPLORED;
+    if (haveFov && bitgrid_get(&fovVisible, x, y)) state |= CELL_VISIBLE;
+    out[0] = (uint8_t)local->tiles[y][x];
+    out[1] = state;
+}
+
+// Edited chunk since the last upload: re-upload it
+static void tilemap_chunk_edited(TileRect rect, const uint64_t*, void* user)
+{
+    TileLayer* layer = (TileLayer*)user;
+    layer->dirty = rect_union(layer->dirty, rect);
+}
+
+// Bring a layer up to date with its map (false if staging memory was refused).
+// Headless, the tiles are packed all the same but there is no texture.
+static bool tilemap_sync(TileLayer* layer, const void* owner, int width, int height)
+{
+    // New map: fresh texture, everything dirty
+    if (layer->owner != owner || layer->width != width || layer->height != height)
+    {
+        if (layer->texture.id != 0 &&
+            (layer->texture.width != width || layer->texture.height != height)) {
+            UnloadTexture(layer->texture);
+            layer->texture.id = 0;
+        }
+        if (layer->texture.id == 0 && !headlessMode)
+        {
+            Image blank = GenImageColor(width, height, BLANK);
+            ImageFormat(&blank, PIXELFORMAT_UNCOMPRESSED_GRAY_ALPHA);
+            layer->texture = LoadTextureFromImage(blank);
+            UnloadImage(blank);
+        }
+        layer->owner = owner;
+        layer->width = width;
+        layer->height = height;
+        layer->dirty = (TileRect){ 0, 0, width, height };
+        layer->fov = fovOwner == owner ? fovRect : (TileRect){ 0, 0, 0, 0 };
+        layer->version = tile_journal(owner)->version;
+    }
+    
+    // Tiles edited since the last upload
+    layer->version = tile_changes_since(tile_journal(owner), layer->version, tilemap_chunk_edited, layer);
+    
+    TileRect r = rect_clip(layer->dirty, width, height);
+    if (rect_empty(r)) return true;
+    
+    size_t bytes = (size_t)(r.x1 - r.x0) * (r.y1 - r.y0) * 2;
+    if (bytes > uploadCapacity)
+    {
+        uint8_t* grown = (uint8_t*)mem_realloc(MEM_RENDER, uploadBuffer, bytes);
+        if (grown == NULL) return false;
+        uploadBuffer = grown;
+        uploadCapacity = bytes;
+    }
+    
+    bool haveFov = fovVisible.width == width && fovVisible.height == height;
+    uint8_t* out = uploadBuffer;
+    for (int y = r.y0; y < r.y1; y++)
+    {
+        for (int x = r.x0; x < r.x1; x++, out += 2)
+        {
+            if (owner == (const void*)worldMap) tilemap_pack_world(x, y, out, haveFov);
+            else tilemap_pack_local((const LocalMap*)owner, x, y, out, haveFov);
+        }
+    }
+    
+    Rectangle rec = { (float)r.x0, (float)r.y0, (float)(r.x1 - r.x0), (float)(r.y1 - r.y0) };
+    if (layer->texture.id != 0) UpdateTextureRec(layer->texture, rec, uploadBuffer);
+    layer->dirty = (TileRect){ 0, 0, 0, 0 };
+    return true;
+}
+
+// Draw the visible tiles of a layer as one quad, the layer's tile (0, 0)
+// at map tile (originX, originY)
+static bool tilemap_draw(TileLayer* layer, const void* owner, int width, int height,
+                         int originX, int originY, TileRect visible, int fontSize)
+{
+    if (!gpuTilemapEnabled || !tilemap_init()) return false;
+    if (!tilemap_sync(layer, owner, width, height)) return false;
+    tilemap_build_atlas(fontSize);
+    
+    if (rect_empty(visible)) return true;
+    
+    float mapSize[2] = { (float)width, (float)height };
+    Rectangle source = {
+        (float)visible.x0, (float)visible.y0,
+        (float)(visible.x1 - visible.x0), (float)(visible.y1 - visible.y0)
+    };
+    Rectangle dest = {
+        (source.x + originX) * TILE_SIZE, (source.y + originY) * TILE_SIZE,
+        source.width * TILE_SIZE, source.height * TILE_SIZE
+    };
+    
+    BeginShaderMode(tilemapShader);
+    SetShaderValueTexture(tilemapShader, atlasLoc, atlasTexture);
+    SetShaderValueTexture(tilemapShader, paletteLoc, paletteTexture);
+    SetShaderValue(tilemapShader, mapSizeLoc, mapSize, SHADER_UNIFORM_VEC2);
+    DrawTexturePro(layer->texture, source, dest, (Vector2){ 0, 0 }, 0.0f, WHITE);
+    EndShaderMode();
+    return true;
+}
+
+// GPU draw of the world map's view; visible is in view coordinates
+// (false: caller draws on the CPU)
+bool tilemap_draw_world(TileRect visible, int fontSize)
+{
+    const TileRect* view = &worldMap->view;
+    return tilemap_draw(&worldLayer, worldMap, view->x1 - view->x0, view->y1 - view->y0,
+                        view->x0, view->y0, visible, fontSize);
+}
+
+// GPU draw of a local map (false: caller draws on the CPU)
+bool tilemap_draw_local(const LocalMap* local, TileRect visible)
+{
+    return tilemap_draw(&localLayer, local, local->width, local->height, 0, 0, visible, 24);
+}
+
+// Pack the current map's changed tiles as a draw would, without drawing:
+// a headless frame's stand-in for tilemap_draw_world and tilemap_draw_local
+void tilemap_stage()
+{
+    if (!gpuTilemapEnabled || worldMap == NULL) return;
+    
+    if (isInLocalMap)
+    {
+        const LocalMap* local = current_local_map();
+        if (local != NULL) tilemap_sync(&localLayer, local, local->width, local->height);
+    }
+    else
+    {
+        const TileRect* view = &worldMap->view;
+        tilemap_sync(&worldLayer, worldMap, view->x1 - view->x0, view->y1 - view->y0);
+    }
+}
+
+// State bits of a map's tiles changed and need re-uploading (tile edits
+// are picked up from the map's journal)
+void tilemap_mark_dirty(const void* owner, TileRect rect)
+{
+    if (worldLayer.owner == owner) worldLayer.dirty = rect_union(worldLayer.dirty, rect);
+    if (localLayer.owner == owner) localLayer.dirty = rect_union(localLayer.dirty, rect);
+    minimap_mark_dirty(owner, rect);
+}
+
+// Field of view moved: refresh both the old and the new sight rect
+void tilemap_mark_fov(const void* owner, TileRect rect)
+{
+    fovOwner = owner;
+    fovRect = rect;
+    
+    TileLayer* layers[2] = { &worldLayer, &localLayer };
+    for (int i = 0; i < 2; i++)
+    {
+        if (layers[i]->owner != owner) continue;
+        layers[i]->dirty = rect_union(layers[i]->dirty, rect_union(layers[i]->fov, rect));
+        layers[i]->fov = rect;
+    }
+    
+    // Exploration only grows inside the new sight rect
+    minimap_mark_dirty(owner, rect);
+}
+
+// A map is going away; its pointer may be reused by the next one
+void tilemap_forget(const void* owner)
+{
+    if (fovOwner == owner) fovOwner = NULL;
+    if (worldLayer.owner == owner) worldLayer.owner = NULL;
+    if (localLayer.owner == owner) localLayer.owner = NULL;
+    minimap_forget(owner);
+}
+
+// Release GPU resources (before the window closes)
+void tilemap_shutdown()
+{
+    TileLayer* layers[2] = { &worldLayer, &localLayer };
+    for (int i = 0; i < 2; i++)
+    {
+        if (layers[i]->texture.id != 0) UnloadTexture(layers[i]->texture);
+        layers[i]->texture.id = 0;
+        layers[i]->owner = NULL;
+    }
+    
+    if (tilemapReady)
+    {
+        UnloadShader(tilemapShader);
+        UnloadTexture(paletteTexture);
+        if (atlasFontSize != 0) UnloadTexture(atlasTexture);
+    }
+    tilemapReady = false;
+    tilemapTried = false;
+    atlasFontSize = 0;
+    
+    mem_free(uploadBuffer);
+    uploadBuffer = NULL;
+    uploadCapacity = 0;
+}
+
+// Memory evictor for the render caches: the staging buffers only matter
+// during an upload and grow back on the next one
+void tilemap_evict(size_t bytesNeeded)
+{
+    (void)bytesNeeded;
+    mem_free(uploadBuffer);
+    uploadBuffer = NULL;
+    uploadCapacity = 0;
+    minimap_evict();
+}
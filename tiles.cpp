@@ -0,0 +1,201 @@
+#include "project.h"
+
+// Tile mutation. Every edit after generation goes through here, so the
+// passability and sight bits stay in sync and the map's journal records it.
+// Each TILE_CHUNK x TILE_CHUNK chunk keeps a bitset of the tiles edited
+// since generation and the map version of its latest edit. Edited chunks
+// form a list ordered newest first, so "what changed since version N"
+// walks only the chunks that did.
+
+// Edit history of the world map
+TileJournal worldChanges;
+
+// Journal of a map (worldMap or a LocalMap)
+TileJournal* tile_journal(const void* owner)
+{
+    if (owner == (const void*)worldMap) return &worldChanges;
+    return &((LocalMap*)owner)->changes;
+}
+
+void tile_journal_free(TileJournal* journal)
+{
+    mem_free(journal->chunks);
+    memset(journal, 0, sizeof(TileJournal));
+}
+
+// Chunk table on the first edit (false if the memory budget refused it)
+static bool tile_journal_reserve(TileJournal* journal, MemTag tag, int width, int height)
+{
+    if (journal->chunks != NULL) return true;
+    
+    int chunksX = (width + TILE_CHUNK - 1) / TILE_CHUNK;
+    int chunksY = (height + TILE_CHUNK - 1) / TILE_CHUNK;
+    journal->chunks = (TileChunk*)mem_calloc(tag, (size_t)chunksX * chunksY, sizeof(TileChunk));
+    if (journal->chunks == NULL) return false;
+    
+    journal->width = width;
+    journal->height = height;
+    journal->chunksX = chunksX;
+    journal->chunksY = chunksY;
+    journal->newest = 0;
+    return true;
+}
+
+// Empty a journal for a freshly generated map, keeping its chunk table if
+// the size matches (false if a new one couldn't be made)
+bool tile_journal_reset(TileJournal* journal, MemTag tag, int width, int height)
+{
+    if (journal->chunks != NULL && journal->width == width && journal->height == height)
+    {
+        memset(journal->chunks, 0, (size_t)journal->chunksX * journal->chunksY * sizeof(TileChunk));
+        journal->version = 0;
+        journal->newest = 0;
+        return true;
+    }
+    tile_journal_free(journal);
+    return tile_journal_reserve(journal, tag, width, height);
+}
+
+// Note an edit of one tile at the journal's current version
+static void tile_journal_record(TileJournal* journal, int x, int y)
+{
+    int index = (y / TILE_CHUNK) * journal->chunksX + x / TILE_CHUNK;
+    TileChunk* chunk = &journal->chunks[index];
+    int bit = (y % TILE_CHUNK) * TILE_CHUNK + x % TILE_CHUNK;
+    chunk->dirty[bit >> 6] |= (uint64_t)1 << (bit & 63);
+    
+    if (chunk->version == journal->version) return;
+    
+    // Move the chunk to the front of the recency list
+    if (journal->newest != index + 1)
+    {
+        if (chunk->version != 0)
+        {
+            if (chunk->newer) journal->chunks[chunk->newer - 1].older = chunk->older;
+            if (chunk->older) journal->chunks[chunk->older - 1].newer = chunk->newer;
+        }
+        chunk->newer = 0;
+        chunk->older = journal->newest;
+        if (journal->newest) journal->chunks[journal->newest - 1].newer = index + 1;
+        journal->newest = index + 1;
+    }
+    chunk->version = journal->version;
+}
+
+// Visit every chunk edited after a version, newest first; returns the
+// version to pass next time
+uint64_t tile_changes_since(const TileJournal* journal, uint64_t version, TileChunkFn visit, void* user)
+{
+    for (int i = journal->newest; i != 0; i = journal->chunks[i - 1].older)
+    {
+        const TileChunk* chunk = &journal->chunks[i - 1];
+        if (chunk->version <= version) break;
+        
+        int x0 = ((i - 1) % journal->chunksX) * TILE_CHUNK;
+        int y0 = ((i - 1) / journal->chunksX) * TILE_CHUNK;
+        TileRect rect = {
+            x0, y0,
+            x0 + TILE_CHUNK < journal->width ? x0 + TILE_CHUNK : journal->width,
+            y0 + TILE_CHUNK < journal->height ? y0 + TILE_CHUNK : journal->height
+        };
+        visit(rect, chunk->dirty, user);
+    }
+    return journal->version;
+}
+
+// Apply edits to a local map as one version. Out-of-bounds and no-op edits
+// are skipped; false (and nothing changed) if the journal can't be made.
+bool set_local_tiles(LocalMap* local, const TileEdit* edits, int count)
+{
+    TileJournal* journal = &local->changes;
+    if (!tile_journal_reserve(journal, MEM_LOCAL, local->width, local->height)) return false;
+    
+    // Only the map on screen keeps its distance fields repaired edit by
+    // edit; the others are rebuilt once when the player comes back
+    bool onScreen = local == current_local_map();
+    bool changed = false;
+    for (int i = 0; i < count; i++)
+    {
+        int x = edits[i].x, y = edits[i].y;
+        char tile = edits[i].tile;
+        if (x < 0 || y < 0 || x >= local->width || y >= local->height) continue;
+        if (local->tiles[y][x] == tile) continue;
+        
+        if (!changed) {
+            journal->version++;
+            changed = true;
+        }
+        if (onScreen) feature_fields_edit(&local->fields, x, y, local->tiles[y][x], tile);
+        else local->fields.stale = true;
+        local->tiles[y][x] = tile;
+        tile_journal_record(journal, x, y);
+        if (local->passable.words != NULL) bitgrid_put(&local->passable, x, y, tile_is_passable(tile));
+        if (local->opaque.words != NULL) bitgrid_put(&local->opaque, x, y, tile_is_opaque(tile));
+    }
+    
+    // Sight is recomputed once per batch, not per tile, and only maps on
+    // screen need it (or a redraw)
+    if (changed && onScreen)
+    {
+        if (local->opaque.words != NULL) fov_invalidate();
+        mark_frame_dirty();
+    }
+    return true;
+}
+
+// Apply edits to the world map as one version (see set_local_tiles). The
+// chunks take every edit; the view's grids and journal, in view
+// coordinates, only those inside it.
+bool set_world_tiles(const TileEdit* edits, int count)
+{
+    TileJournal* journal = &worldChanges;
+    const TileRect view = worldMap->view;
+    int viewWidth = view.x1 - view.x0;
+    if (!tile_journal_reserve(journal, MEM_WORLD, viewWidth, view.y1 - view.y0)) return false;
+    
+    bool changed = false;
+    for (int i = 0; i < count; i++)
+    {
+        int x = edits[i].x, y = edits[i].y;
+        char tile = edits[i].tile;
+        if (x < 0 || y < 0 || x >= currentMapWidth || y >= currentMapHeight) continue;
+        if (world_tile(x, y) == tile) continue;
+        
+        WorldChunk* chunk = world_chunk_store(x, y);
+        if (chunk == NULL) continue;
+        chunk->cells[world_chunk_cell(x, y)].worldTile = tile;
+        chunk->edited = true;
+        
+        if (!changed) {
+            journal->version++;
+            changed = true;
+        }
+        if (!world_view_contains(x, y)) continue;
+        
+        int vx = x - view.x0, vy = y - view.y0;
+        char* viewTile = &worldMap->tiles[(size_t)vy * viewWidth + vx];
+        feature_fields_edit(&worldFields, vx, vy, *viewTile, tile);
+        *viewTile = tile;
+        tile_journal_record(journal, vx, vy);
+        if (worldPassable.words != NULL) bitgrid_put(&worldPassable, vx, vy, tile_is_passable(tile));
+        if (worldOpaque.words != NULL) bitgrid_put(&worldOpaque, vx, vy, tile_is_opaque(tile));
+    }
+    
+    if (changed && worldOpaque.words != NULL) fov_invalidate();
+    if (changed) mark_frame_dirty();
+    return true;
+}
+
+// Change a local map tile and keep its derived bits in sync
+void set_local_tile(LocalMap* local, int x, int y, char tile)
+{
+    TileEdit edit = { x, y, tile };
+    set_local_tiles(local, &edit, 1);
+}
+
+// Change a world map tile and keep its derived bits in sync
+void set_world_tile(int x, int y, char tile)
+{
+    TileEdit edit = { x, y, tile };
+    set_world_tiles(&edit, 1);
+}
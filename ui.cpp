@@ -0,0 +1,259 @@
+#include "project.h"
+
+// Retained menu layer: a menu's text is measured, positioned and (where it
+// never changes) rendered into a texture once. Later frames only blit that
+// texture and draw the option labels at their cached positions. Without a
+// window (the terminal front end) the same text is laid out in rows.
+
+#define MENU_MAX_OPTIONS 12
+#define MENU_MAX_INSTRUCTIONS 4
+#define MENU_TEXT_CHARS 64
+
+// Cached layout of the menu on screen
+typedef struct {
+    GameState menu;             // Which menu was built
+    uint32_t contentKey;        // Caller's summary of what the text depends on
+    int screenWidth;
+    int screenHeight;
+    bool valid;
+    bool building;              // Between menu_begin and menu_end
+    
+    char title[MENU_TEXT_CHARS];
+    float titleY;               // Fraction of the screen height
+    
+    int optionCount;
+    int optionSize;             // Font size of option labels
+    float optionGap;            // Pixels between option rows
+    char options[MENU_MAX_OPTIONS][MENU_TEXT_CHARS];
+    Vector2 optionPos[MENU_MAX_OPTIONS];
+    float optionWidth[MENU_MAX_OPTIONS];
+    
+    char notes[MENU_MAX_OPTIONS][MENU_TEXT_CHARS];      // Static line under an option
+    Color noteColors[MENU_MAX_OPTIONS];
+    
+    char details[MENU_MAX_OPTIONS][MENU_TEXT_CHARS];    // Line shown for the selected option
+    float detailY;
+    Vector2 detailPos[MENU_MAX_OPTIONS];
+    
+    int instructionCount;
+    char instructions[MENU_MAX_INSTRUCTIONS][MENU_TEXT_CHARS];
+    
+    RenderTexture2D staticText; // Title, notes and instructions
+} MenuCache;
+
+static MenuCache menuCache;
+
+// Horizontally centered position of a line of text
+static Vector2 menu_center(const char* text, float size, float spacing, float y, float* width)
+{
+    Vector2 measured = MeasureTextEx(GetFontDefault(), text, size, spacing);
+    if (width) *width = measured.x;
+    return (Vector2){ (float)menuCache.screenWidth / 2.0f - measured.x / 2.0f, y };
+}
+
+// Start describing a menu; false when the cached layout is still good
+bool menu_begin(GameState menu, uint32_t contentKey)
+{
+    int screenWidth = GetScreenWidth();
+    int screenHeight = GetScreenHeight();
+    
+    if (menuCache.valid && menuCache.menu == menu && menuCache.contentKey == contentKey &&
+        menuCache.screenWidth == screenWidth && menuCache.screenHeight == screenHeight) return false;
+    
+    RenderTexture2D staticText = menuCache.staticText;
+    memset(&menuCache, 0, sizeof(menuCache));
+    menuCache.staticText = staticText;
+    menuCache.menu = menu;
+    menuCache.contentKey = contentKey;
+    menuCache.screenWidth = screenWidth;
+    menuCache.screenHeight = screenHeight;
+    menuCache.building = true;
+    return true;
+}
+
+// Menu heading, placed at a fraction of the screen height
+void menu_title(const char* title, float y)
+{
+    snprintf(menuCache.title, MENU_TEXT_CHARS, "%s", title);
+    menuCache.titleY = y;
+}
+
+// Option rows start at mid-screen
+void menu_option_style(int size, float gap)
+{
+    menuCache.optionSize = size;
+    menuCache.optionGap = gap;
+}
+
+// Add a selectable row, returning its index
+int menu_option(const char* label)
+{
+    if (menuCache.optionCount == MENU_MAX_OPTIONS) return -1;
+    int i = menuCache.optionCount++;
+    snprintf(menuCache.options[i], MENU_TEXT_CHARS, "%s", label);
+    return i;
+}
+
+// Small static line under an option (e.g. "(Empty)")
+void menu_note(int option, const char* text, Color color)
+{
+    if (option < 0 || option >= MENU_MAX_OPTIONS) return;
+    snprintf(menuCache.notes[option], MENU_TEXT_CHARS, "%s", text);
+    menuCache.noteColors[option] = color;
+}
+
+// Line shown while an option is selected, at a fraction of the screen height
+void menu_detail(int option, const char* text, float y)
+{
+    if (option < 0 || option >= MENU_MAX_OPTIONS) return;
+    snprintf(menuCache.details[option], MENU_TEXT_CHARS, "%s", text);
+    menuCache.detailY = y;
+}
+
+// Help line at the bottom of the screen
+void menu_instruction(const char* text)
+{
+    if (menuCache.instructionCount == MENU_MAX_INSTRUCTIONS) return;
+    snprintf(menuCache.instructions[menuCache.instructionCount++], MENU_TEXT_CHARS, "%s", text);
+}
+
+// Lay the menu out and render its static text
+void menu_end()
+{
+    if (!menuCache.building) return;
+    menuCache.building = false;
+    
+    // Rows are placed as they are drawn, there is nothing to render
+    if (headlessMode) {
+        menuCache.valid = true;
+        return;
+    }
+    
+    float height = (float)menuCache.screenHeight;
+    
+    for (int i = 0; i < menuCache.optionCount; i++)
+    {
+        menuCache.optionPos[i] = menu_center(menuCache.options[i], (float)menuCache.optionSize, 1,
+                                             height / 2.0f + i * menuCache.optionGap,
+                                             &menuCache.optionWidth[i]);
+        if (menuCache.details[i][0]) {
+            menuCache.detailPos[i] = menu_center(menuCache.details[i], 22, 1,
+                                                 height * menuCache.detailY, NULL);
+        }
+    }
+    
+    // Render target follows the window size
+    if (menuCache.staticText.id == 0 ||
+        menuCache.staticText.texture.width != menuCache.screenWidth ||
+        menuCache.staticText.texture.height != menuCache.screenHeight)
+    {
+        if (menuCache.staticText.id != 0) UnloadRenderTexture(menuCache.staticText);
+        menuCache.staticText = LoadRenderTexture(menuCache.screenWidth, menuCache.screenHeight);
+    }
+    
+    BeginTextureMode(menuCache.staticText);
+    ClearBackground(BLANK);
+    
+    Vector2 titlePos = menu_center(menuCache.title, 48, 2, height * menuCache.titleY, NULL);
+    DrawTextEx(GetFontDefault(), menuCache.title, titlePos, 48, 2, YELLOW);
+    
+    for (int i = 0; i < menuCache.optionCount; i++)
+    {
+        if (!menuCache.notes[i][0]) continue;
+        Vector2 notePos = menu_center(menuCache.notes[i], 20, 1, menuCache.optionPos[i].y + 35.0f, NULL);
+        DrawTextEx(GetFontDefault(), menuCache.notes[i], notePos, 20, 1, menuCache.noteColors[i]);
+    }
+    
+    // One line lands at 50 px from the bottom, three lines start at 100
+    float instructionTop = height - 25.0f - 25.0f * menuCache.instructionCount;
+    for (int i = 0; i < menuCache.instructionCount; i++)
+    {
+        Vector2 pos = menu_center(menuCache.instructions[i], 20, 1, instructionTop + i * 25.0f, NULL);
+        DrawTextEx(GetFontDefault(), menuCache.instructions[i], pos, 20, 1, LIGHTGRAY);
+    }
+    
+    EndTextureMode();
+    menuCache.valid = true;
+}
+
+// Centered line of terminal text
+static void menu_text_row(int row, const char* text, Color color)
+{
+    term_text((term_columns() - (int)strlen(text)) / 2, row, text, color);
+}
+
+// The cached menu as terminal rows: options from the middle down, a row
+// apart when any has a note to fit under it, instructions at the bottom
+static void menu_draw_text(int selected, unsigned int disabledMask)
+{
+    int rows = term_rows();
+    menu_text_row((int)(rows * menuCache.titleY), menuCache.title, YELLOW);
+    
+    int gap = 1;
+    for (int i = 0; i < menuCache.optionCount; i++)
+    {
+        if (menuCache.notes[i][0]) gap = 2;
+    }
+    
+    for (int i = 0; i < menuCache.optionCount; i++)
+    {
+        bool disabled = disabledMask & (1u << i);
+        Color color = disabled ? GRAY : (i == selected) ? YELLOW : WHITE;
+        int row = rows / 2 + i * gap;
+        menu_text_row(row, (i == selected && !disabled) ? TextFormat("> %s <", menuCache.options[i]) : menuCache.options[i], color);
+        if (menuCache.notes[i][0]) menu_text_row(row + 1, menuCache.notes[i], menuCache.noteColors[i]);
+    }
+    
+    if (selected >= 0 && selected < menuCache.optionCount && menuCache.details[selected][0]) {
+        menu_text_row((int)(rows * menuCache.detailY), menuCache.details[selected], LIGHTGRAY);
+    }
+    
+    for (int i = 0; i < menuCache.instructionCount; i++)
+    {
+        menu_text_row(rows - 1 - menuCache.instructionCount + i, menuCache.instructions[i], LIGHTGRAY);
+    }
+}
+
+// Draw the cached menu; disabledMask has a bit per grayed-out option
+void menu_draw(int selected, unsigned int disabledMask)
+{
+    if (!menuCache.valid) return;
+    if (headlessMode) {
+        menu_draw_text(selected, disabledMask);
+        return;
+    }
+    
+    // Render textures are stored upside down
+    Rectangle source = {
+        0, 0, (float)menuCache.staticText.texture.width, -(float)menuCache.staticText.texture.height
+    };
+    DrawTextureRec(menuCache.staticText.texture, source, (Vector2){ 0, 0 }, WHITE);
+    
+    int size = menuCache.optionSize;
+    for (int i = 0; i < menuCache.optionCount; i++)
+    {
+        bool disabled = disabledMask & (1u << i);
+        Color color = disabled ? GRAY : (i == selected) ? YELLOW : WHITE;
+        Vector2 pos = menuCache.optionPos[i];
+        
+        // Selection arrows, only on options that can be chosen
+        if (i == selected && !disabled) {
+            DrawText(">", (int)pos.x - 21, (int)pos.y, size, YELLOW);
+            DrawText("<", (int)(pos.x + menuCache.optionWidth[i] + 10), (int)pos.y, size, YELLOW);
+        }
+        
+        DrawTextEx(GetFontDefault(), menuCache.options[i], pos, (float)size, 1, color);
+    }
+    
+    if (selected >= 0 && selected < menuCache.optionCount && menuCache.details[selected][0]) {
+        DrawTextEx(GetFontDefault(), menuCache.details[selected], menuCache.detailPos[selected],
+                   22, 1, LIGHTGRAY);
+    }
+}
+
+// Release the cached render texture (before the window closes)
+void menu_shutdown()
+{
+    if (menuCache.staticText.id != 0) UnloadRenderTexture(menuCache.staticText);
+    memset(&menuCache, 0, sizeof(menuCache));
+}
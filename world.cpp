@@ -0,0 +1,241 @@
+#include "project.h"
+
+// Sparse chunked world. Tiles live in WORLD_CHUNK x WORLD_CHUNK chunks found
+// through an open-addressed table, so a world's memory follows what was
+// stored in it rather than its nominal size. Worlds up to WORLD_VIEW_SIDE
+// are generated whole from rand() (the replays rely on those draws); larger
+// ones hash each tile from the seed and its position, so any tile can be
+// generated alone, and a chunk is only stored once the player explores it,
+// edits it or generates a local map in it. The dense grids everything else
+// works on (passability, sight, distance fields, paths, field of view,
+// render caches) cover the view: a chunk-aligned window around the player,
+// rebuilt from the chunks when the player nears its edge.
+
+// Chunk table slots: chunk pointers keyed by position, NULL when empty
+struct ChunkKeys {
+    static uint64_t position(int cx, int cy) { return (uint64_t)cy * 65537u + (uint64_t)cx + 1; }
+    static bool empty(const WorldChunk* chunk) { return chunk == NULL; }
+    static uint64_t key(const WorldChunk* chunk) { return position(chunk->cx, chunk->cy); }
+    static int home(uint64_t key, int capacity) { return (int)(((uint32_t)key * 2654435761u) >> 8) & (capacity - 1); }
+};
+
+// Stored chunk holding tile (x, y), NULL if there is none (any thread)
+WorldChunk* world_chunk(int x, int y)
+{
+    const WorldMap* world = worldMap;
+    uint64_t key = ChunkKeys::position(x / WORLD_CHUNK, y / WORLD_CHUNK);
+    WorldChunk** slot = hash_find<ChunkKeys>(world->slots, world->count, world->capacity, key);
+    return slot ? *slot : NULL;
+}
+
+// Terrain of a sparse world's tile from the seed and its position alone:
+// the same odds as the rand() worlds, a wall border, a clear start
+static WorldTile world_terrain(int x, int y)
+{
+    WorldTile cell = { NULL, '#', false };
+    if (x <= 0 || y <= 0 || x >= currentMapWidth - 1 || y >= currentMapHeight - 1) return cell;
+    
+    cell.hasLocalMap = true;
+    cell.worldTile = '.';
+    if (x <= 3 && y <= 3) return cell;
+    
+    uint32_t h = worldSeed ^ ((uint32_t)y * 0x85ebca6bu + (uint32_t)x * 0xc2b2ae35u);
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    float randVal = (float)(h >> 8) / 16777216.0f;
+    
+    if (randVal < 0.05f) cell.worldTile = '~';
+    else if (randVal < 0.15f) cell.worldTile = '^';
+    else if (randVal < 0.20f) cell.worldTile = 'T';
+    return cell;
+}
+
+// Chunk holding tile (x, y), created on first use: generated from the seed
+// on a sparse world, blank for rand() to fill on a small one (NULL if the
+// memory budget refused it)
+WorldChunk* world_chunk_store(int x, int y)
+{
+    WorldChunk* chunk = world_chunk(x, y);
+    if (chunk != NULL) return chunk;
+    
+    WorldMap* world = worldMap;
+    if (!hash_reserve<ChunkKeys>(&world->slots, world->count, &world->capacity, 16, MEM_WORLD)) return NULL;
+    
+    chunk = (WorldChunk*)mem_calloc(MEM_WORLD, 1, sizeof(WorldChunk));
+    if (chunk == NULL) return NULL;
+    chunk->cx = x / WORLD_CHUNK;
+    chunk->cy = y / WORLD_CHUNK;
+    
+    if (world->sparse)
+    {
+        int x0 = chunk->cx * WORLD_CHUNK, y0 = chunk->cy * WORLD_CHUNK;
+        for (int i = 0; i < WORLD_CHUNK * WORLD_CHUNK; i++)
+        {
+            chunk->cells[i] = world_terrain(x0 + i % WORLD_CHUNK, y0 + i / WORLD_CHUNK);
+        }
+    }
+    
+    hash_insert<ChunkKeys>(world->slots, world->capacity, chunk);
+    world->count++;
+    world->layout++;
+    return chunk;
+}
+
+// Free a world's chunks and table; touches no other globals, so a detached
+// world can be freed on any thread
+void world_chunks_free(WorldMap* world)
+{
+    for (int i = 0; i < world->capacity; i++) mem_free(world->slots[i]);
+    mem_free(world->slots);
+    world->slots = NULL;
+    world->count = 0;
+    world->capacity = 0;
+}
+
+// Tile (x, y) as stored, or as the seed generates it (any thread)
+WorldTile world_cell(int x, int y)
+{
+    const WorldChunk* chunk = world_chunk(x, y);
+    if (chunk != NULL) return chunk->cells[world_chunk_cell(x, y)];
+    return world_terrain(x, y);
+}
+
+// Is (x, y) inside the view?
+bool world_view_contains(int x, int y)
+{
+    const TileRect* view = &worldMap->view;
+    return x >= view->x0 && y >= view->y0 && x < view->x1 && y < view->y1;
+}
+
+// Tile char at (x, y), from the view's copy when it covers the tile
+char world_tile(int x, int y)
+{
+    const WorldMap* world = worldMap;
+    if (!world_view_contains(x, y)) return world_cell(x, y).worldTile;
+    return world->tiles[(size_t)(y - world->view.y0) * (world->view.x1 - world->view.x0) + (x - world->view.x0)];
+}
+
+// Can the player walk onto (x, y)?
+bool world_passable(int x, int y)
+{
+    return tile_is_passable(world_tile(x, y));
+}
+
+// Has the player seen (x, y)? Tiles of chunks never stored were never seen.
+bool world_explored(int x, int y)
+{
+    const WorldChunk* chunk = world_chunk(x, y);
+    return chunk != NULL && (chunk->explored[y & (WORLD_CHUNK - 1)] >> (x & (WORLD_CHUNK - 1)) & 1);
+}
+
+// Fold view rows [y0, y1) of a visible set into the chunks' explored bits.
+// The view is chunk-aligned, so each word of a row is one chunk's row.
+void world_explore(const BitGrid* visible, int y0, int y1)
+{
+    const TileRect* view = &worldMap->view;
+    if (y0 < 0) y0 = 0;
+    if (y1 > visible->height) y1 = visible->height;
+    
+    for (int y = y0; y < y1; y++)
+    {
+        int worldY = view->y0 + y;
+        if (worldY >= currentMapHeight) break;
+        for (int w = 0; w < visible->stride; w++)
+        {
+            uint64_t bits = visible->words[y * visible->stride + w];
+            int worldX = view->x0 + w * WORLD_CHUNK;
+            if (worldX >= currentMapWidth) break;
+            
+            // Sight past the far edge of the world is not kept
+            if (worldX + WORLD_CHUNK > currentMapWidth) bits &= ((uint64_t)1 << (currentMapWidth - worldX)) - 1;
+            if (bits == 0) continue;
+            
+            WorldChunk* chunk = world_chunk_store(worldX, worldY);
+            if (chunk != NULL) chunk->explored[worldY & (WORLD_CHUNK - 1)] |= bits;
+        }
+    }
+}
+
+// A world tile's drawn state changed (visited, explored): refresh the
+// render caches if the view covers it
+void world_tile_changed(int x, int y)
+{
+    if (!world_view_contains(x, y)) return;
+    x -= worldMap->view.x0;
+    y -= worldMap->view.y0;
+    tilemap_mark_dirty(worldMap, (TileRect){ x, y, x + 1, y + 1 });
+}
+
+// Copy the view's tile chars out of the chunks, a chunk row at a time
+static void world_view_fill()
+{
+    WorldMap* world = worldMap;
+    TileRect view = world->view;
+    char* out = world->tiles;
+    for (int y = view.y0; y < view.y1; y++)
+    {
+        for (int x = view.x0; x < view.x1; x += WORLD_CHUNK)
+        {
+            int count = view.x1 - x < WORLD_CHUNK ? view.x1 - x : WORLD_CHUNK;
+            const WorldChunk* chunk = world_chunk(x, y);
+            for (int i = 0; i < count; i++)
+            {
+                *out++ = chunk ? chunk->cells[world_chunk_cell(x + i, y)].worldTile : world_terrain(x + i, y).worldTile;
+            }
+        }
+    }
+}
+
+// Place the view around (x, y) (a small world's view is the whole of it)
+// and rebuild everything derived from its tiles
+void world_view_center(int x, int y)
+{
+    WorldMap* world = worldMap;
+    int width = world->view.x1 - world->view.x0;
+    int height = world->view.y1 - world->view.y0;
+    
+    if (world->sparse)
+    {
+        // Chunk-aligned, hanging over the far edge rather than leaving
+        // the last tiles out (those are walls)
+        int lastX = (currentMapWidth - width + WORLD_CHUNK - 1) / WORLD_CHUNK;
+        int lastY = (currentMapHeight - height + WORLD_CHUNK - 1) / WORLD_CHUNK;
+        int cx = (x - width / 2 + WORLD_CHUNK / 2) / WORLD_CHUNK;
+        int cy = (y - height / 2 + WORLD_CHUNK / 2) / WORLD_CHUNK;
+        cx = cx < 0 ? 0 : cx > lastX ? lastX : cx;
+        cy = cy < 0 ? 0 : cy > lastY ? lastY : cy;
+        world->view = (TileRect){ cx * WORLD_CHUNK, cy * WORLD_CHUNK, cx * WORLD_CHUNK + width, cy * WORLD_CHUNK + height };
+    }
+    
+    world_view_fill();
+    world_build_passable();
+    world_build_opaque();
+    world_build_fields();
+    
+    // Everything cached in view coordinates starts over
+    tilemap_forget(world);
+    tile_journal_free(&worldChanges);
+    fov_invalidate();
+    world->layout++;
+}
+
+// Move a sparse world's view once (x, y) comes within WORLD_VIEW_MARGIN of
+// an edge it can still move past; true if it moved
+bool world_view_follow(int x, int y)
+{
+    const WorldMap* world = worldMap;
+    if (!world->sparse) return false;
+    
+    const TileRect* view = &world->view;
+    bool moveX = (x - view->x0 < WORLD_VIEW_MARGIN && view->x0 > 0) ||
+                 (view->x1 - x <= WORLD_VIEW_MARGIN && view->x1 < currentMapWidth);
+    bool moveY = (y - view->y0 < WORLD_VIEW_MARGIN && view->y0 > 0) ||
+                 (view->y1 - y <= WORLD_VIEW_MARGIN && view->y1 < currentMapHeight);
+    if (!moveX && !moveY) return false;
+    
+    world_view_center(x, y);
+    return true;
+}